@@ -1,6 +1,17 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <sstream>
 #include <string>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <dds/core/corefwd.hpp>
 
 #include <dds/core/Optional.hpp>
@@ -12,13 +23,16 @@
 #include <rti/routing/processor/Processor.hpp>
 #include <rti/routing/processor/ProcessorPlugin.hpp>
 
+#include <prometheus/columnar_gauge.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/gauge_block.h>
 #include <prometheus/histogram.h>
 #include <prometheus/summary.h>
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
 #include <prometheus/metric_type.h>
+#include <prometheus/series_budget.h>
 
 #include <prometheus/detail/builder.h>
 
@@ -74,7 +88,8 @@ MetricConfig::MetricConfig(
     data_type (i_data_type),
     key_map (i_key_map),
     collection_map (i_collection_map),
-    data_path (i_data_path)
+    data_path (i_data_path),
+    max_series (0)
 {
 
 }
@@ -86,7 +101,10 @@ MetricConfig::MetricConfig(const MetricConfig& fam_config) :
     data_type (fam_config.data_type),
     key_map (fam_config.key_map),
     collection_map (fam_config.collection_map),
-    data_path (fam_config.data_path)
+    plan (fam_config.plan),
+    data_path (fam_config.data_path),
+    max_series (fam_config.max_series),
+    unit (fam_config.unit)
 {
 
 }
@@ -97,84 +115,282 @@ MetricConfig::~MetricConfig() {}
 //---------Mapper---------------------------------------------------------------
 //------------------------------------------------------------------------------
 // Deal with Configuration file
-Mapper::Mapper(Filename config_file) {
-    string config_filename = "../";
-    config_filename.append(config_file);
-    YAML::Node config = YAML::LoadFile(config_filename);
+Mapper::Mapper(Filename config_file) : Mapper() {
+    string config_filename = config_path(config_file);
+    YAML::Node config = read_config(config_file);
     // YAML::Node config = topic["Topic"];
     if (config.IsNull()) {
         throw YAML::BadFile(config_filename);
     }
+    try {
+        parse(config);
+    } catch (YAML::BadConversion& e) {
+        std::cout << "One or more key-value pairs in " << config_filename;
+        std::cout << " is missing or in the wrong format." << endl;
+        std::cout << e.what() << endl;
+        exit(1);
+    }
+}
+
+Mapper::Mapper() : 
+    is_auto_map(true), 
+    use_key_hash(false), 
+    use_plan_cache(true),
+    config_hash(0),
+    series_max_age(std::chrono::steady_clock::duration::zero()),
+    use_source_timestamps(false),
+    max_series_per_metric(0),
+    limiting_series(false),
+    use_self_metrics(false),
+    metric_timing_every(0),
+    samples_since_timing(0),
+    batch_duration(NULL),
+    batch_samples(NULL),
+    sample_duration(NULL),
+    update_duration_family(NULL),
+    family_series(NULL),
+    cached_plans(NULL) {
     metric_map = {};
     config_map = {};
+}
+
+std::shared_ptr<Mapper> Mapper::load(Filename config_file) {
+    string config_filename = config_path(config_file);
+    std::shared_ptr<Mapper> mapper(new Mapper());
     try {
-        if (config["instance_info"]) {
-            instance_identifiers = config["instance_info"].as<vector<string>>();
-        } else {
-            instance_identifiers = {};
+        YAML::Node config = mapper->read_config(config_file);
+        if (config.IsNull()) {
+            throw YAML::BadFile(config_filename);
         }
+        mapper->parse(config);
+    } catch (YAML::Exception& e) {
+        std::cout << "Cannot load " << config_filename << ": ";
+        std::cout << e.what() << endl;
+        return NULL;
+    }
+    return mapper;
+}
+
+Filename Mapper::config_path(Filename config_file) {
+    string config_filename = "../";
+    config_filename.append(config_file);
+    return config_filename;
+}
+
+time_t Mapper::modification_time(Filename config_file) {
+    struct stat info;
+    if (stat(config_path(config_file).c_str(), &info) != 0) {
+        return 0;
+    }
+    return info.st_mtime;
+}
+
+/*
+*  FNV-1a, stable across processes unlike std::hash
+*/
+static uint64_t stable_hash(
+        const char* data, 
+        size_t size, 
+        uint64_t seed = 14695981039346656037ULL) {
+    for (size_t i = 0; i < size; ++i) {
+        seed ^= static_cast<unsigned char>(data[i]);
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+
+/*
+*  Number of Mappers using each family and series of the registry shared
+*  by all processors. Families are registered with InsertBehavior::Merge,
+*  so routes defining a metric of the same name get the same Family, and
+*  the same labels the same series of it.
+*  KEY: address of the Family or of the series
+*/
+static std::mutex shared_metrics_mutex;
+static map<const void*, size_t> shared_metrics;
+
+static void hold_shared(const void* metric) {
+    if (metric == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(shared_metrics_mutex);
+    ++shared_metrics[metric];
+}
+
+/*
+*  true if no other Mapper uses METRIC, it may be removed then
+*/
+static bool release_shared(const void* metric) {
+    std::lock_guard<std::mutex> lock(shared_metrics_mutex);
+    map<const void*, size_t>::iterator it = shared_metrics.find(metric);
+    if (it == shared_metrics.end()) {
+        return true;
+    }
+    if (--(it->second) > 0) {
+        return false;
+    }
+    shared_metrics.erase(it);
+    return true;
+}
+
+YAML::Node Mapper::read_config(Filename file) {
+    string config_filename = config_path(file);
+    std::ifstream in(config_filename.c_str(), std::ios::binary);
+    if (!in) {
+        throw YAML::BadFile(config_filename);
+    }
+    std::stringstream content;
+    content << in.rdbuf();
+    string text = content.str();
+    config_file = file;
+    config_hash = stable_hash(text.data(), text.size());
+    return YAML::Load(text);
+}
+
+void Mapper::parse(const YAML::Node& config) {
+    if (config["instance_info"]) {
+        instance_identifiers = config["instance_info"].as<vector<string>>();
+    } else {
+        instance_identifiers = {};
+    }
+
+    if (config["ignore"].IsSequence()) {
+        // DEBUG
+        std::cout << "ignore found" << endl;
+        ignore_list = config["ignore"].as<vector<string>>();
+    } else {
+        ignore_list = {};
+    }
+    if (config["include"].IsSequence()) {
+        include_list = config["include"].as<vector<string>>();
+    } else {
+        include_list = {};
+    }
+
+    if (config["enable_auto_map"]) {
+        is_auto_map = config["enable_auto_map"].as<bool>();
+    } else {
+        is_auto_map = true;
+    }
+    if (config["use_key_hash_label"]) {
+        use_key_hash = config["use_key_hash_label"].as<bool>();
+    } else {
+        use_key_hash = false;
+    }
+    if (config["series_max_age"]) {
+        series_max_age = std::chrono::seconds(
+                config["series_max_age"].as<int64_t>());
+    } else {
+        series_max_age = std::chrono::steady_clock::duration::zero();
+    }
+    if (config["source_timestamps"]) {
+        use_source_timestamps = config["source_timestamps"].as<bool>();
+    } else {
+        use_source_timestamps = false;
+    }
+    if (config["max_series_per_metric"]) {
+        max_series_per_metric = 
+                config["max_series_per_metric"].as<size_t>();
+    } else {
+        max_series_per_metric = 0;
+    }
+    if (config["max_series_total"]) {
+        series_budget = std::make_shared<SeriesBudget>(
+                config["max_series_total"].as<size_t>());
+    }
+    if (config["plan_cache"]) {
+        use_plan_cache = config["plan_cache"].as<bool>();
+    } else {
+        use_plan_cache = true;
+    }
+    if (config["self_metrics"]) {
+        use_self_metrics = config["self_metrics"].as<bool>();
+    } else {
+        // timing every sample costs clock reads on the hot path
+        use_self_metrics = false;
+    }
+    if (config["self_metrics_sample_every"]) {
+        metric_timing_every = 
+                config["self_metrics_sample_every"].as<size_t>();
+    } else {
+        metric_timing_every = 0;
+    }
+    if (config["consistent_snapshots"] 
+            && config["consistent_snapshots"].as<bool>()) {
+        gauge_blocks = std::make_shared<GaugeBlockGroup>();
+    }
 
-        if (config["ignore"].IsSequence()) {
-            // DEBUG
-            std::cout << "ignore found" << endl;
-            ignore_list = config["ignore"].as<vector<string>>();
+    // TODO mapping with list and key
+    for (YAML::const_iterator it = config["metrics"].begin();
+            it != config["metrics"].end(); ++it) {
+        
+        string data_path = it->second["data_path"].as<string>();
+        // since auto map don't need to map specific metric again
+        ignore_list.push_back(data_path);
+        string name;
+        if (it->second["name"]) {
+            name = it->second["name"].as<string>();
         } else {
-            ignore_list = {};
+            name = boost::replace_all_copy(data_path, ".", "_");
+            name = "&" + name;
         }
 
-        if (config["enable_auto_map"]) {
-            is_auto_map = config["enable_auto_map"].as<bool>();
+        MetricType type;
+        if (it->second["type"]) {
+            type = what_type(it->second["type"].as<string>());
         } else {
-            is_auto_map = true;
+            type = MetricType::Gauge;
         }
-        if (config["use_key_hash_label"]) {
-            use_key_hash = config["use_key_hash_label"].as<bool>();
-        } else {
-            use_key_hash = false;
-        }
-
-        // TODO mapping with list and key
-        for (YAML::const_iterator it = config["metrics"].begin();
-                it != config["metrics"].end(); ++it) {
-            
-            string data_path = it->second["data_path"].as<string>();
-            // since auto map don't need to map specific metric again
-            ignore_list.push_back(data_path);
-            string name;
-            if (it->second["name"]) {
-                name = it->second["name"].as<string>();
-            } else {
-                name = boost::replace_all_copy(data_path, ".", "_");
-                name = "&" + name;
-            }
 
-            MetricType type;
-            if (it->second["type"]) {
-                type = what_type(it->second["type"].as<string>());
-            } else {
-                type = MetricType::Gauge;
-            }
+        string help = it->second["description"].as<string>();
+        // TODO-- get key member before getting sample!?
+        map<string, string> labels_map = {}; 
+
+        MetricConfig* metric_config = 
+                new MetricConfig(
+                        name,
+                        help,
+                        type,
+                        data_path, 
+                        TypeKind::INT_64_TYPE,
+                        labels_map, 
+                        {});
+        if (it->second["max_series"]) {
+            metric_config->max_series = it->second["max_series"].as<size_t>();
+        }
+        if (it->second["unit"]) {
+            metric_config->unit = it->second["unit"].as<string>();
+        }
+        config_map[name] = metric_config;
+    }
 
-            string help = it->second["description"].as<string>();
-            // TODO-- get key member before getting sample!?
-            map<string, string> labels_map = {}; 
+    for (int i = 0; i < ignore_list.size(); ++i) {
+        ignore_rules.add(ignore_list[i]);
+    }
+    for (int i = 0; i < include_list.size(); ++i) {
+        include_rules.add(include_list[i]);
+    }
 
-            MetricConfig* metric_config = 
-                    new MetricConfig(
-                            name,
-                            help,
-                            type,
-                            data_path, 
-                            TypeKind::INT_64_TYPE,
-                            labels_map, 
-                            {});
-            config_map[name] = metric_config;
+    if (config["aggregate"].IsSequence()) {
+        for (YAML::const_iterator it = config["aggregate"].begin();
+                it != config["aggregate"].end(); ++it) {
+            AggregateRule rule;
+            rule.pattern.add((*it)["data_path"].as<string>());
+            rule.by = (*it)["by"].as<vector<string>>();
+            vector<string> functions = {"sum"};
+            if ((*it)["functions"]) {
+                functions = (*it)["functions"].as<vector<string>>();
+            }
+            for (int i = 0; i < functions.size(); ++i) {
+                if (Aggregation::is_function(functions[i])) {
+                    rule.functions.push_back(functions[i]);
+                } else {
+                    std::cout << functions[i];
+                    std::cout << " is not an aggregate function." << endl;
+                }
+            }
+            aggregate_rules.push_back(rule);
         }
-    } catch (YAML::BadConversion& e) {
-        std::cout << "One or more key-value pairs in " << config_filename;
-        std::cout << " is missing or in the wrong format." << endl;
-        std::cout << e.what() << endl;
-        exit(1);
     }
 }
 
@@ -188,6 +404,20 @@ Mapper::~Mapper() {
          delete it->second;
      }
      config_map.clear();
+     // whatever is left stays registered, e.g. for the Mapper replacing this
+     address_metric address;
+     for (map<string, Family_variant>::iterator it = metric_map.begin();
+            it != metric_map.end(); ++it) {
+         release_shared(boost::apply_visitor(address, it->second));
+     }
+     for (map<string, Counter*>::iterator it = skipped_counters.begin();
+            it != skipped_counters.end(); ++it) {
+         release_shared(it->second);
+     }
+     for (map<string, Histogram*>::iterator it = update_durations.begin();
+            it != update_durations.end(); ++it) {
+         release_shared(it->second);
+     }
 }
 
 void Mapper::find_key_n_collection(const dds::core::xtypes::DynamicType& type,
@@ -252,6 +482,7 @@ void Mapper::find_key_n_collection(const dds::core::xtypes::DynamicType& type,
 
 void Mapper::config_user_specify_metrics(const DynamicType& type) {
     topic_name = type.name();
+    topic_type = std::make_shared<DynamicType>(type);
     string name = topic_name;
     name = boost::replace_all_copy(name, "::", "_");
     map<string, MetricConfig*> new_config_map = {};
@@ -279,267 +510,1075 @@ void Mapper::config_user_specify_metrics(const DynamicType& type) {
     config_map = new_config_map;
 }
 
-void Mapper::auto_map(const DynamicType& topic_type, MetricConfig config) {
-    //DEBUG
-    std::cout << endl << "auto mapp is called" << endl;
-    std::cout << "ignore_list size: " << ignore_list.size() << endl;
-    std::cout << "Config: " << config.data_path << endl;
-    for (int i = 0; i < ignore_list.size(); ++i) {
-        // check for existance
-        if (config.data_path.find(ignore_list[i]) != string::npos) {
-            //DEBUG
-            std::cout << "ignore_list " << config.data_path << endl;
-            return;
-        }
+// defined with the plan compiler below
+static vector<PathStep> compile_steps(
+        const DataPath& data_path,
+        const DynamicType*& type);
+
+void Mapper::configure(const DynamicType& type) {
+    config_user_specify_metrics(type);
+    instance_steps.clear();
+    for (int i = 0; i < instance_identifiers.size(); ++i) {
+        const DynamicType* key_type = topic_type.get();
+        instance_steps.push_back(
+                compile_steps(instance_identifiers[i], key_type));
     }
-    //DEBUG
-    std::cout << "ignore_list: not in the list." << endl;
-
-    string statistic_variable = "StatisticVariable";
-    if (is_primitive_type(topic_type)) {
-        TypeKind kind = topic_type.kind();
-        if (kind.underlying() == TypeKind::BOOLEAN_TYPE 
-                || kind.underlying() == TypeKind::CHAR_8_TYPE
-                || kind.underlying() == TypeKind::UINT_8_TYPE) {
-            // Not mappable
-            return;
+    if (is_auto_mapping()) {
+        string name = type.name();
+        name = boost::replace_all_copy(name, "::", "_");
+        name.append("_");
+        MetricConfig metric_config(name, "");
+        auto_map(type, metric_config);
+    }
+    for (map<string, MetricConfig*>::iterator it = config_map.begin();
+            it != config_map.end(); ++it) {
+        if (!it->second->plan) {
+            it->second->plan = compile_plan(*(it->second), topic_type.get());
+        }
+        if (it->second->type != MetricType::Gauge) {
+            continue;
+        }
+        for (int i = 0; i < aggregate_rules.size(); ++i) {
+            if (!aggregate_rules[i].pattern.matches(it->second->data_path)) {
+                continue;
+            }
+            std::shared_ptr<Aggregation> aggregation = 
+                    std::make_shared<Aggregation>(
+                            aggregate_rules[i].by, 
+                            aggregate_rules[i].functions);
+            LabelKey unknown;
+            if (aggregation->resolve_by(
+                    series_label_names(*(it->second)),
+                    topic_type.get(),
+                    unknown)) {
+                aggregations[it->first] = aggregation;
+            } else {
+                std::cout << unknown << " is neither a label nor a member of "
+                        << topic_name << ", " << it->first 
+                        << " is not aggregated." << endl;
+            }
+            break;
         }
-        config.data_type = kind;
-        MetricConfig* save_config = new MetricConfig(config);
-        save_config->data_path.erase(save_config->data_path.length()-1, 1);
-        save_config->name.erase(save_config->name.length()-1, 1);
-        config_map[save_config->name] = save_config;
-        return;
-    // statisticVaraible direct alias to mean of StatisticMetric
-    } else if (topic_type.name().find(statistic_variable) != std::string::npos) {
-        config.data_path.append("publication_period_metrics.mean");
-        config.name.append("publication_period_metrics_mean");
-        MetricConfig* save_config = new MetricConfig(config);
-        config_map[config.name] = save_config;
-        //DEBUG
-        std::cout << "StatisticVariable is found." << endl;
-        return;
     }
-    //DEBUG
-    std::cout << "check for StatisticVariable is done" << endl;
+}
 
-    TypeKind kind = topic_type.kind();
-    switch (kind.underlying()) {
-    case TypeKind::UNION_TYPE: {
-        const UnionType& union_type =
-                static_cast<const UnionType&> (topic_type);
-        for (int i = 0; i < union_type.member_count(); ++i) {
-            const UnionMember& member = union_type.member(i); 
-            MetricConfig new_config(config);
-            //DEBUG
-            std::cout << "new_config: " << new_config.data_path << endl;
-            new_config.name.append(member.name());
-            new_config.name.append("_");
-            new_config.data_path.append(member.name());
-            new_config.data_path.append(".");
-            auto_map(member.type(), new_config);
-        }
+/*
+*  Fold VALUE into SEED with stable_hash, byte by byte from the lowest,
+*  so that the key of the plan cache file is the same for every build
+*/
+static void hash_combine(uint64_t& seed, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        char byte = static_cast<char>((value >> (8 * i)) & 0xff);
+        seed = stable_hash(&byte, 1, seed);
     }
-        break;
+}
+
+static void hash_combine(uint64_t& seed, const string& text) {
+    hash_combine(seed, static_cast<uint64_t>(text.size()));
+    seed = stable_hash(text.data(), text.size(), seed);
+}
+
+/*
+*  Hash of everything in TYPE that auto_map depends on
+*/
+static uint64_t structural_hash(const DynamicType& type) {
+    uint64_t seed = stable_hash(NULL, 0);
+    hash_combine(seed, type.name());
+    hash_combine(seed, static_cast<uint64_t>(type.kind().underlying()));
+    switch (type.kind().underlying()) {
     case TypeKind::STRUCTURE_TYPE: {
-        const StructType& struct_type =
-                static_cast<const StructType&> (topic_type);
-        //DEBUG
-        std::cout << "In Structure type: " << endl;
+        const StructType& struct_type = static_cast<const StructType&>(type);
         for (int i = 0; i < struct_type.member_count(); ++i) {
             const Member& member = struct_type.member(i);
-            //DEBUG
-            std::cout << "member name " << member.name() << endl;
-            if (!is_primitive_type(member.type())) {
-                std::cout << "member type " << member.type().name() << endl;
-            } else {
-                std::cout << "member type primitive." << endl; 
-            }
-            if (member.is_key()) {
-                // data path to this member 
-                // TODO-- check 
-                // assuming key members always at the top
-                std::cout << "is_key" << endl;
-                string data_path = config.data_path;
-                data_path.append(member.name());
-                if (!use_key_hash_label()) {
-                    config.key_map[member.name()] = data_path;
-                }
-            } else {
-                MetricConfig new_config(config);
-                //DEBUG
-                std::cout << "new_config: " << new_config.data_path << endl;
-                new_config.name.append(member.name());
-                new_config.name.append("_");
-                new_config.data_path.append(member.name());
-                new_config.data_path.append(".");
-                auto_map(member.type(), new_config);
-            }
+            hash_combine(seed, member.name());
+            hash_combine(seed, static_cast<uint64_t>(member.is_key()));
+            hash_combine(seed, static_cast<uint64_t>(member.is_optional()));
+            hash_combine(seed, structural_hash(member.type()));
         }
     }
         break;
-    case TypeKind::ARRAY_TYPE: {
-        const ArrayType& array_type =
-                static_cast<const ArrayType &>(topic_type);
-
-        MetricConfig new_config(config);
-        //DEBUG
-        std::cout << "new_config: " << new_config.data_path << endl;
-        // how to access array element from DynamicData
-        // LoanedDynamicData or vector<>
-        std::vector<string> results;
-        boost::split(
-                results,
-                new_config.data_path, 
-                [](char c){return c == '.';});
-        new_config.collection_map[results.back()] = new_config.data_path;
-        auto_map(array_type.content_type(), new_config);
+    case TypeKind::UNION_TYPE: {
+        const UnionType& union_type = static_cast<const UnionType&>(type);
+        for (int i = 0; i < union_type.member_count(); ++i) {
+            const UnionMember& member = union_type.member(i);
+            hash_combine(seed, member.name());
+            for (int j = 0; j < member.labels().size(); ++j) {
+                hash_combine(seed, static_cast<uint64_t>(member.labels()[j]));
+            }
+            hash_combine(seed, structural_hash(member.type()));
+        }
     }
         break;
-    case TypeKind::SEQUENCE_TYPE: {
-        const SequenceType& seq_type = 
-                static_cast<const SequenceType &>(topic_type);
-                
-        MetricConfig new_config(config);
-        //DEBUG
-        std::cout << "new_config: " << new_config.data_path << endl;
-        std::vector<string> results;
-        boost::split(
-                results,
-                new_config.data_path,
-                [](char c){return c == '.';});
-        new_config.collection_map[results.back()] = new_config.data_path;
-        auto_map(seq_type.content_type(), new_config);
-    }
+    case TypeKind::ARRAY_TYPE:
+        hash_combine(seed, structural_hash(
+                static_cast<const ArrayType&>(type).content_type()));
         break;
-    case TypeKind::ALIAS_TYPE: {
-        const AliasType& alias_type =
-                static_cast<const AliasType &>(topic_type);
-        MetricConfig new_config(config);
-        auto_map(resolve_alias(alias_type), new_config);
-    }
+    case TypeKind::SEQUENCE_TYPE:
+        hash_combine(seed, structural_hash(
+                static_cast<const SequenceType&>(type).content_type()));
+        break;
+    case TypeKind::ALIAS_TYPE:
+        hash_combine(seed, structural_hash(
+                resolve_alias(static_cast<const AliasType&>(type))));
         break;
     default:
         break;
     }
-    
+    return seed;
 }
 
 /*
-* Limitation of current implementation:
-*   - Seqence
-*   - Evolving Extendable type
+*  auto_map results shared by all processors of the process
+*  KEY: type name, structural hash and the mapping options used
 */
-void Mapper::register_metrics(std::shared_ptr<Registry> registry) {
+static std::mutex auto_map_cache_mutex;
+static map<string, std::shared_ptr<const vector<MetricConfig>>> auto_map_cache;
 
-    // call_on_data_avaialable_total is default metric
-    Family_variant temp =
-            create_metric(
-                    MetricType::Counter, 
-                    "call_on_data_available_total", 
-                    "How many times this processor call on_data_available()",
-                    {{"Test", "on_data_available"}},
-                    registry);
-    add_metric adder;
-    adder.labels = {{"topic", topic_name}};
-    boost::apply_visitor(adder, temp);
-    metric_map["call_on_data_available_total"] = temp;
+/*
+*  auto_map results kept in a file, so a restarted process skips auto_map.
+*  Layout, integers in host byte order:
+*    "PMPLAN01", cache key, number of leaves, leaves, checksum (FNV-1a)
+*  A leaf is a MetricConfig with its compiled plan. Strings are stored 
+*  as length and bytes, vectors and maps as count and elements.
+*/
+static const char PLAN_CACHE_MAGIC[8] = {'P','M','P','L','A','N','0','1'};
 
-    // create and register instance_info (pseudo-metric) 
-    Family_variant instance_info =
-            create_metric(
-                    MetricType::Gauge,
-                    "instance_info",
-                    "Contain human-readable about data instances",
-                    {},
-                    registry);
-    adder.labels = {};
-    boost::apply_visitor(adder, instance_info);
-    metric_map["instance_info"] = instance_info;
+struct PlanCacheWriter {
+    void u32(uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void str(const string& value) {
+        u32(value.size());
+        out.append(value);
+    }
+    string out;
+};
 
-    //DEBUG 
-    std::cout << "config size: " << config_map.size() << endl;
+struct PlanCacheReader {
+    PlanCacheReader(const char* i_pos, const char* i_end) : 
+        pos(i_pos), end(i_end), ok(true) {}
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (end - pos < sizeof(value)) {
+            ok = false;
+            return 0;
+        }
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    string str() {
+        uint32_t size = u32();
+        if (!ok || end - pos < size) {
+            ok = false;
+            return "";
+        }
+        string value(pos, size);
+        pos += size;
+        return value;
+    }
+    const char* pos;
+    const char* end;
+    bool ok;
+};
 
-    for (map<string, MetricConfig*>::const_iterator cit = config_map.begin();
-        cit != config_map.end(); ++cit) {
-        
-        MetricConfig* fam = cit->second;
-        // DEBUG
-        std::cout << "fam->name: " << fam->name << endl;
-        std::cout << "fam->data_path: " << fam->data_path << endl << endl;
-        temp = create_metric(fam, registry);
-        metric_map[fam->name] = temp;
+static void write_steps(PlanCacheWriter& out, const vector<PathStep>& steps) {
+    out.u32(steps.size());
+    for (int i = 0; i < steps.size(); ++i) {
+        out.str(steps[i].name);
+        out.u32(steps[i].presence);
+        out.u32(steps[i].labels.size());
+        for (int j = 0; j < steps[i].labels.size(); ++j) {
+            out.u32(static_cast<uint32_t>(steps[i].labels[j]));
+        }
     }
 }
 
-/*
-* Create Family (container of metrics) 
-* and register it to REGISTRY
-* Return: Family<T>* for T = Counter, Gauge, Histogram, or Summary
-* and return boost::blank if fail
-*/
-Family_variant Mapper::create_metric(
-        MetricType type,
-        MetricName name,
-        string detail, 
-        const Label& labels,
-        std::shared_ptr<Registry> registry) {
-    switch(type){
-        case MetricType::Counter:
-            return &(BuildCounter().Name(name).Help(detail).Labels(labels).Register(*registry));
-        case MetricType::Gauge:
-            return &(BuildGauge().Name(name).Help(detail).Labels(labels).Register(*registry));
-        case MetricType::Histogram:
-            return &(BuildHistogram().Name(name).Help(detail).Labels(labels).Register(*registry));
-        case MetricType::Summary:
-            return &(BuildSummary().Name(name).Help(detail).Labels(labels).Register(*registry));
-        default:
-            return boost::blank();
+static vector<PathStep> read_steps(PlanCacheReader& in) {
+    vector<PathStep> steps;
+    uint32_t count = in.u32();
+    for (uint32_t i = 0; in.ok && i < count; ++i) {
+        PathStep step;
+        step.name = in.str();
+        uint32_t presence = in.u32();
+        if (presence > PathStep::UNCHECKED) {
+            in.ok = false;
+        }
+        step.presence = static_cast<PathStep::Presence>(presence);
+        uint32_t labels = in.u32();
+        for (uint32_t j = 0; in.ok && j < labels; ++j) {
+            step.labels.push_back(static_cast<int32_t>(in.u32()));
+        }
+        steps.push_back(step);
     }
+    return steps;
 }
 
-Family_variant Mapper::create_metric(
-        MetricConfig* famConfig,
-        std::shared_ptr<Registry> registry) {
-    return create_metric(
-            famConfig->type,
-            famConfig->name,
-            famConfig->help,
-            {},
-            registry);
+static void write_plan(PlanCacheWriter& out, const PlanNode& node) {
+    out.u32(node.key_paths.size());
+    for (int i = 0; i < node.key_paths.size(); ++i) {
+        out.str(node.key_paths[i]);
+        write_steps(out, node.key_steps[i]);
+    }
+    write_steps(out, node.steps);
+    out.str(node.collection);
+    out.str(node.index_label);
+    out.u32(node.bulk);
+    out.u32(node.data_type.underlying());
+    out.u32(node.element ? 1 : 0);
+    if (node.element) {
+        write_plan(out, *(node.element));
+    }
 }
 
-bool Mapper::is_auto_mapping() {
-    return is_auto_map;
+static PlanPtr read_plan(PlanCacheReader& in) {
+    std::shared_ptr<PlanNode> node = std::make_shared<PlanNode>();
+    uint32_t keys = in.u32();
+    for (uint32_t i = 0; in.ok && i < keys; ++i) {
+        node->key_paths.push_back(in.str());
+        node->key_steps.push_back(read_steps(in));
+    }
+    node->steps = read_steps(in);
+    node->collection = in.str();
+    node->index_label = in.str();
+    node->bulk = in.u32() != 0;
+    node->data_type = static_cast<TypeKind_def::type>(in.u32());
+    if (in.ok && in.u32() != 0) {
+        node->element = read_plan(in);
+    }
+    return node;
 }
 
-bool Mapper::use_key_hash_label() {
-    return use_key_hash;
+static void write_members(
+        PlanCacheWriter& out, 
+        const map<MemberName, DataPath>& members) {
+    out.u32(members.size());
+    for (map<MemberName, DataPath>::const_iterator it = members.begin();
+            it != members.end(); ++it) {
+        out.str(it->first);
+        out.str(it->second);
+    }
 }
 
-string Mapper::data_path_to_label_name(DataPath data_path) {
-    string updated_name = boost::replace_all_copy(data_path, ".", "_");
-    boost::replace_all(updated_name, "[", "_");
-    boost::replace_all(updated_name, "]", "_");
-    return updated_name;
+static map<MemberName, DataPath> read_members(PlanCacheReader& in) {
+    map<MemberName, DataPath> members;
+    uint32_t count = in.u32();
+    for (uint32_t i = 0; in.ok && i < count; ++i) {
+        MemberName name = in.str();
+        members[name] = in.str();
+    }
+    return members;
 }
 
-void Mapper::format_key_label(Label& key_label) {
-    Label updated_label;
-    for(map<string, string>::const_iterator cit = key_label.begin();
-            cit != key_label.end(); cit++) {
-        string updated_name = data_path_to_label_name(cit->first);
-        updated_label[updated_name] = cit->second;
+/*
+*  Write LEAVES with their plans to PATH. The file is replaced atomically,
+*  a concurrent reader sees either the old or the new file
+*/
+static bool write_plan_cache(
+        const string& path, 
+        const string& key, 
+        const vector<MetricConfig>& leaves) {
+    PlanCacheWriter out;
+    out.out.append(PLAN_CACHE_MAGIC, sizeof(PLAN_CACHE_MAGIC));
+    out.str(key);
+    out.u32(leaves.size());
+    for (int i = 0; i < leaves.size(); ++i) {
+        const MetricConfig& leaf = leaves[i];
+        out.u32(static_cast<uint32_t>(leaf.type));
+        out.str(leaf.name);
+        out.str(leaf.help);
+        out.str(leaf.data_path);
+        out.u32(leaf.data_type.underlying());
+        write_members(out, leaf.key_map);
+        write_members(out, leaf.collection_map);
+        write_plan(out, *(leaf.plan));
     }
-    key_label.clear();
-    key_label = updated_label;
+    uint64_t checksum = stable_hash(out.out.data(), out.out.size());
+    out.out.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+    std::stringstream temp_path_stream;
+    temp_path_stream << path << "." << getpid() << ".tmp";
+    string temp_path = temp_path_stream.str();
+    std::ofstream file(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(out.out.data(), out.out.size());
+    file.close();
+    if (!file || rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cout << "Cannot write plan cache " << path << endl;
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
 }
-/* 
-*  Utility function to determine type of metric 
-*  based on sting TYPE given
-*  Return: MetricType 
+
+/*
+*  Map the file at PATH and decode its leaves into LEAVES if it is
+*  complete and was written for KEY. LEAVES is left empty otherwise
 */
-MetricType Mapper::what_type(std::string type) {
+static bool read_plan_cache(
+        const string& path, 
+        const string& key, 
+        vector<MetricConfig>& leaves) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 
+            || info.st_size < sizeof(PLAN_CACHE_MAGIC) + sizeof(uint64_t)) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    const char* begin = static_cast<const char*>(mapped);
+    const char* end = begin + info.st_size - sizeof(uint64_t);
+    uint64_t checksum;
+    memcpy(&checksum, end, sizeof(checksum));
+    bool valid = memcmp(begin, PLAN_CACHE_MAGIC, sizeof(PLAN_CACHE_MAGIC)) == 0
+            && stable_hash(begin, end - begin) == checksum;
+    PlanCacheReader in(begin + sizeof(PLAN_CACHE_MAGIC), end);
+    if (valid && in.str() == key) {
+        uint32_t count = in.u32();
+        for (uint32_t i = 0; in.ok && i < count; ++i) {
+            MetricConfig leaf("", "");
+            leaf.type = static_cast<MetricType>(in.u32());
+            leaf.name = in.str();
+            leaf.help = in.str();
+            leaf.data_path = in.str();
+            leaf.data_type = static_cast<TypeKind_def::type>(in.u32());
+            leaf.key_map = read_members(in);
+            leaf.collection_map = read_members(in);
+            leaf.plan = read_plan(in);
+            leaves.push_back(leaf);
+        }
+        valid = in.ok && in.pos == end;
+    } else {
+        valid = false;
+    }
+    munmap(mapped, info.st_size);
+    if (!valid) {
+        leaves.clear();
+    }
+    return valid;
+}
+
+void Mapper::auto_map(const DynamicType& topic_type, MetricConfig config) {
+    std::stringstream ss;
+    ss << topic_type.name() << "#" << structural_hash(topic_type) 
+            << "#" << config.name << "#" << config.data_path 
+            << "#" << use_key_hash_label();
+    for (int i = 0; i < ignore_list.size(); ++i) {
+        ss << "#" << ignore_list[i];
+    }
+    ss << "#include";
+    for (int i = 0; i < include_list.size(); ++i) {
+        ss << "#" << include_list[i];
+    }
+    string cache_key = ss.str();
+
+    std::shared_ptr<const vector<MetricConfig>> leaves;
+    {
+        std::lock_guard<std::mutex> lock(auto_map_cache_mutex);
+        map<string, std::shared_ptr<const vector<MetricConfig>>>::iterator 
+                it = auto_map_cache.find(cache_key);
+        if (it != auto_map_cache.end()) {
+            leaves = it->second;
+        }
+    }
+
+    if (!leaves) {
+        std::shared_ptr<vector<MetricConfig>> new_leaves = 
+                std::make_shared<vector<MetricConfig>>();
+        // the file is only valid for this exact yaml content
+        bool with_file = use_plan_cache && !config_file.empty();
+        string file_path = config_path(config_file) + "." 
+                + trim_right_copy_if(config.name, is_any_of("_")) + ".plan";
+        std::stringstream file_key;
+        file_key << cache_key << "#" << config_hash;
+        if (!with_file 
+                || !read_plan_cache(file_path, file_key.str(), *new_leaves)) {
+            auto_map_leaves(topic_type, config, *new_leaves);
+            for (int i = 0; i < new_leaves->size(); ++i) {
+                MetricConfig& leaf = (*new_leaves)[i];
+                leaf.plan = compile_plan(leaf, &topic_type);
+            }
+            if (with_file) {
+                write_plan_cache(file_path, file_key.str(), *new_leaves);
+            }
+        }
+        std::lock_guard<std::mutex> lock(auto_map_cache_mutex);
+        auto_map_cache[cache_key] = new_leaves;
+        leaves = new_leaves;
+    }
+
+    for (int i = 0; i < leaves->size(); ++i) {
+        const MetricConfig& leaf = (*leaves)[i];
+        map<string, MetricConfig*>::iterator it = config_map.find(leaf.name);
+        if (it != config_map.end()) {
+            delete it->second;
+        }
+        config_map[leaf.name] = new MetricConfig(leaf);
+    }
+}
+
+/*
+*  One node of the type walked by auto_map_leaves. Maps only change at
+*  keyed members and collections, nodes share them otherwise.
+*/
+struct AutoMapNode {
+    const DynamicType* type;
+    MetricName name;
+    DataPath data_path;
+    std::shared_ptr<const map<MemberName, DataPath>> key_map;
+    std::shared_ptr<const map<MemberName, DataPath>> collection_map;
+    PathTrie::States ignore_states;
+    PathTrie::States include_states;
+    /** an include rule matches this node, the whole subtree is mapped */
+    bool included;
+};
+
+/*
+*  Walk from NODE into MEMBER_NAME. Return false if the member and 
+*  its subtree are pruned by the ignore or include rules.
+*/
+static bool enter_member(
+        AutoMapNode& child,
+        const AutoMapNode& node,
+        const MemberName& member_name,
+        const PathTrie& ignore_rules,
+        const PathTrie& include_rules) {
+    child.ignore_states = ignore_rules.advance(node.ignore_states, member_name);
+    if (ignore_rules.matches(child.ignore_states)) {
+        return false;
+    }
+    if (!include_rules.empty() && !node.included) {
+        child.include_states = 
+                include_rules.advance(node.include_states, member_name);
+        child.included = include_rules.matches(child.include_states);
+        if (!child.included && child.include_states.empty()) {
+            // no include rule can match below
+            return false;
+        }
+    }
+    return true;
+}
+
+void Mapper::auto_map_leaves(
+        const DynamicType& topic_type,
+        const MetricConfig& config,
+        vector<MetricConfig>& leaves) {
+    string statistic_variable = "StatisticVariable";
+    vector<AutoMapNode> stack = {};
+    AutoMapNode root;
+    root.type = &topic_type;
+    root.name = config.name;
+    root.data_path = config.data_path;
+    root.key_map = std::make_shared<map<MemberName, DataPath>>(config.key_map);
+    root.collection_map = 
+            std::make_shared<map<MemberName, DataPath>>(config.collection_map);
+    root.ignore_states = ignore_rules.start();
+    root.include_states = include_rules.start();
+    root.included = include_rules.empty();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        AutoMapNode node = stack.back();
+        stack.pop_back();
+
+        const DynamicType& type = *node.type;
+        if (is_primitive_type(type)) {
+            if (!node.included) {
+                continue;
+            }
+            TypeKind kind = type.kind();
+            if (kind.underlying() == TypeKind::BOOLEAN_TYPE 
+                    || kind.underlying() == TypeKind::CHAR_8_TYPE
+                    || kind.underlying() == TypeKind::UINT_8_TYPE) {
+                // Not mappable
+                continue;
+            }
+            leaves.push_back(MetricConfig(
+                    node.name.substr(0, node.name.length() - 1),
+                    config.help,
+                    config.type,
+                    node.data_path.substr(0, node.data_path.length() - 1),
+                    kind,
+                    *node.key_map,
+                    *node.collection_map));
+            continue;
+        // statisticVaraible direct alias to mean of StatisticMetric
+        } else if (type.name().find(statistic_variable) != std::string::npos) {
+            AutoMapNode mean = node;
+            if (!enter_member(mean, node, "publication_period_metrics",
+                            ignore_rules, include_rules)
+                    || !enter_member(mean, AutoMapNode(mean), "mean",
+                            ignore_rules, include_rules)
+                    || !mean.included) {
+                continue;
+            }
+            leaves.push_back(MetricConfig(
+                    node.name + "publication_period_metrics_mean",
+                    config.help,
+                    config.type,
+                    node.data_path + "publication_period_metrics.mean",
+                    config.data_type,
+                    *node.key_map,
+                    *node.collection_map));
+            continue;
+        }
+
+        // children are pushed in reverse so they are visited in member order
+        vector<AutoMapNode> children = {};
+        switch (type.kind().underlying()) {
+        case TypeKind::UNION_TYPE: {
+            const UnionType& union_type = static_cast<const UnionType&>(type);
+            for (int i = 0; i < union_type.member_count(); ++i) {
+                const UnionMember& member = union_type.member(i); 
+                AutoMapNode child = node;
+                if (!enter_member(child, node, member.name(),
+                        ignore_rules, include_rules)) {
+                    continue;
+                }
+                child.type = &member.type();
+                child.name.append(member.name()).append("_");
+                child.data_path.append(member.name()).append(".");
+                children.push_back(child);
+            }
+        }
+            break;
+        case TypeKind::STRUCTURE_TYPE: {
+            const StructType& struct_type = 
+                    static_cast<const StructType&>(type);
+            for (int i = 0; i < struct_type.member_count(); ++i) {
+                const Member& member = struct_type.member(i);
+                if (member.is_key()) {
+                    // assuming key members always at the top
+                    if (!use_key_hash_label()) {
+                        std::shared_ptr<map<MemberName, DataPath>> key_map = 
+                                std::make_shared<map<MemberName, DataPath>>(
+                                        *node.key_map);
+                        (*key_map)[member.name()] = 
+                                node.data_path + member.name();
+                        node.key_map = key_map;
+                    }
+                } else {
+                    AutoMapNode child = node;
+                    if (!enter_member(child, node, member.name(),
+                            ignore_rules, include_rules)) {
+                        continue;
+                    }
+                    child.type = &member.type();
+                    child.name.append(member.name()).append("_");
+                    child.data_path.append(member.name()).append(".");
+                    children.push_back(child);
+                }
+            }
+        }
+            break;
+        case TypeKind::ARRAY_TYPE:
+        case TypeKind::SEQUENCE_TYPE: {
+            AutoMapNode child = node;
+            if (type.kind().underlying() == TypeKind::ARRAY_TYPE) {
+                child.type = 
+                        &static_cast<const ArrayType&>(type).content_type();
+            } else {
+                child.type = 
+                        &static_cast<const SequenceType&>(type).content_type();
+            }
+            // collection path without the trailing "."
+            string collection_path = 
+                    node.data_path.substr(0, node.data_path.size() - 1);
+            std::vector<string> results;
+            boost::split(
+                    results,
+                    collection_path, 
+                    [](char c){return c == '.';});
+            std::shared_ptr<map<MemberName, DataPath>> collection_map = 
+                    std::make_shared<map<MemberName, DataPath>>(
+                            *node.collection_map);
+            (*collection_map)[results.back()] = collection_path;
+            child.collection_map = collection_map;
+            children.push_back(child);
+        }
+            break;
+        case TypeKind::ALIAS_TYPE: {
+            AutoMapNode child = node;
+            child.type = &resolve_alias(static_cast<const AliasType&>(type));
+            children.push_back(child);
+        }
+            break;
+        default:
+            break;
+        }
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+}
+
+/*
+*  Bucket bounds START, START * FACTOR, ... COUNT of them
+*/
+static Histogram::BucketBoundaries exponential_buckets(
+        double start, 
+        double factor, 
+        int count) {
+    Histogram::BucketBoundaries bounds = {};
+    for (int i = 0; i < count; ++i) {
+        bounds.push_back(start);
+        start *= factor;
+    }
+    return bounds;
+}
+
+/*
+*  Observes the time from its construction to its destruction 
+*  in HISTOGRAM, in seconds. Does not read the clock if HISTOGRAM is NULL
+*/
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram* histogram) : histogram(histogram) {
+        if (histogram) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~ScopedTimer() {
+        if (histogram) {
+            histogram->Observe(std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+    }
+private:
+    Histogram* histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+/*
+* Limitation of current implementation:
+*   - Seqence
+*   - Evolving Extendable type
+*/
+void Mapper::register_metrics(std::shared_ptr<Registry> registry) {
+
+    // call_on_data_avaialable_total is default metric
+    Family_variant temp =
+            create_metric(
+                    MetricType::Counter, 
+                    "call_on_data_available_total", 
+                    "How many times this processor call on_data_available()",
+                    {{"Test", "on_data_available"}},
+                    registry);
+    add_metric adder;
+    adder.labels = {{"topic", topic_name}};
+    boost::apply_visitor(adder, temp);
+    metric_map["call_on_data_available_total"] = temp;
+
+    // create and register instance_info (pseudo-metric) 
+    Family_variant instance_info =
+            create_metric(
+                    MetricType::Gauge,
+                    "instance_info",
+                    "Contain human-readable about data instances",
+                    {},
+                    registry);
+    adder.labels = {};
+    boost::apply_visitor(adder, instance_info);
+    metric_map["instance_info"] = instance_info;
+
+    // values of a metric not found in a sample, e.g. unset optional members
+    Family_variant skipped =
+            create_metric(
+                    MetricType::Counter,
+                    "skipped_leaves_total",
+                    "How many values were not mapped because their member "
+                    "was absent in the sample",
+                    {},
+                    registry);
+    metric_map["skipped_leaves_total"] = skipped;
+    Family<Counter>* skipped_family = boost::get<Family<Counter>*>(skipped);
+
+    // label sets folded into overflow series by the limits below
+    metric_map["series_rejected_total"] =
+            create_metric(
+                    MetricType::Counter,
+                    "series_rejected_total",
+                    "How many distinct label sets of a metric were folded "
+                    "into its overflow series because of the series limits",
+                    {},
+                    registry);
+
+    register_self_metrics(registry);
+
+    // entities that vanish without dispose would otherwise be kept forever
+    expire_metric expirer;
+    expirer.max_age = series_max_age;
+    batch_expiry.SetMaxAge(series_max_age);
+    boost::apply_visitor(expirer, instance_info);
+
+    // a label with unbounded values must not exhaust the memory
+    limit_metric limiter;
+    limiter.max_series = max_series_per_metric;
+    limiter.budget = series_budget;
+    boost::apply_visitor(limiter, instance_info);
+    limiting_series = max_series_per_metric != 0 || series_budget;
+
+    //DEBUG 
+    std::cout << "config size: " << config_map.size() << endl;
+
+    for (map<string, MetricConfig*>::const_iterator cit = config_map.begin();
+        cit != config_map.end(); ++cit) {
+        
+        MetricConfig* fam = cit->second;
+        // DEBUG
+        std::cout << "fam->name: " << fam->name << endl;
+        std::cout << "fam->data_path: " << fam->data_path << endl << endl;
+        if (!fam->plan) {
+            fam->plan = compile_plan(*fam, topic_type.get());
+        }
+        skipped_counters[fam->name] = 
+                &(skipped_family->Add({{"metric", fam->name}}));
+        hold_shared(skipped_counters[fam->name]);
+        if (update_duration_family && metric_timing_every != 0) {
+            update_durations[fam->name] = 
+                    &(update_duration_family->Add(
+                            {{"metric", fam->name}}, 
+                            exponential_buckets(1e-6, 4, 10)));
+            hold_shared(update_durations[fam->name]);
+        }
+        limiter.max_series = fam->max_series != 0 ? 
+                fam->max_series : max_series_per_metric;
+        limiting_series = limiting_series || limiter.max_series != 0;
+        map<string, std::shared_ptr<Aggregation>>::iterator agg = 
+                aggregations.find(fam->name);
+        if (agg != aggregations.end()) {
+            agg->second->register_families(*fam, registry, series_max_age);
+            agg->second->limit_families(limiter.max_series, limiter.budget);
+            continue;
+        }
+        if (gauge_blocks && fam->type == MetricType::Gauge) {
+            // families of the group are kept across reloads
+            if (block_families.count(fam->name) == 0) {
+                block_families[fam->name] = 
+                        gauge_blocks->AddFamily(
+                                fam->name, fam->help, {}, fam->unit);
+            }
+            continue;
+        }
+        temp = create_metric(fam, registry);
+        boost::apply_visitor(expirer, temp);
+        boost::apply_visitor(limiter, temp);
+        metric_map[fam->name] = temp;
+    }
+}
+
+void Mapper::register_self_metrics(std::shared_ptr<Registry> registry) {
+    if (!use_self_metrics) {
+        return;
+    }
+    // 1us to 0.26s
+    Histogram::BucketBoundaries durations = exponential_buckets(1e-6, 4, 10);
+    Label topic = {{"topic", topic_name}};
+    batch_duration = 
+            &(BuildHistogram()
+                    .Name("on_data_available_duration_seconds")
+                    .Help("Time on_data_available took to take and map "
+                          "the available samples")
+                    .Unit("seconds")
+                    .Register(*registry)
+                    .Add(topic, durations));
+    batch_samples = 
+            &(BuildHistogram()
+                    .Name("on_data_available_samples")
+                    .Help("Number of samples taken by one call of "
+                          "on_data_available")
+                    .Register(*registry)
+                    .Add(topic, exponential_buckets(1, 2, 12)));
+    sample_duration = 
+            &(BuildHistogram()
+                    .Name("sample_mapping_duration_seconds")
+                    .Help("Time it took to update all metrics of one sample")
+                    .Unit("seconds")
+                    .Register(*registry)
+                    .Add(topic, durations));
+    if (metric_timing_every != 0) {
+        update_duration_family = 
+                &(BuildHistogram()
+                        .Name("metric_update_duration_seconds")
+                        .Help("Time it took to extract and update the values "
+                              "of one metric of a sample, for some samples "
+                              "only")
+                        .Unit("seconds")
+                        .Register(*registry));
+    }
+    family_series = 
+            &(BuildColumnarGauge()
+                    .Name("family_series")
+                    .Help("Number of time series of a family")
+                    .Register(*registry));
+    cached_plans = 
+            &(BuildColumnarGauge()
+                    .Name("cached_plans")
+                    .Help("Number of auto mapped metrics whose extraction "
+                          "plans are cached in this process")
+                    .Register(*registry));
+}
+
+void Mapper::report_batch(
+        std::chrono::steady_clock::duration duration, 
+        size_t samples) {
+    if (!batch_duration) {
+        return;
+    }
+    batch_duration->Observe(std::chrono::duration<double>(duration).count());
+    batch_samples->Observe(samples);
+}
+
+void Mapper::report_self_metrics() {
+    if (!family_series) {
+        return;
+    }
+    size_metric sizer;
+    for (map<string, Family_variant>::iterator it = metric_map.begin();
+            it != metric_map.end(); ++it) {
+        map<string, Family<ColumnarGauge>::Handle>::iterator handle = 
+                family_series_handles.find(it->first);
+        if (handle == family_series_handles.end()) {
+            handle = family_series_handles.insert(make_pair(
+                    it->first, 
+                    family_series->Add(
+                            {{"topic", topic_name}, 
+                             {"metric", it->first}}))).first;
+        }
+        size_t size = boost::apply_visitor(sizer, it->second);
+        // another route removed the series on reload
+        if (!family_series->Set(handle->second, size)) {
+            handle->second = family_series->Add(
+                    {{"topic", topic_name}, {"metric", it->first}});
+            family_series->Set(handle->second, size);
+        }
+    }
+
+    size_t leaves = 0;
+    {
+        std::lock_guard<std::mutex> lock(auto_map_cache_mutex);
+        for (map<string, std::shared_ptr<const vector<MetricConfig>>>::
+                    const_iterator it = auto_map_cache.begin();
+                it != auto_map_cache.end(); ++it) {
+            leaves += it->second->size();
+        }
+    }
+    cached_plans->Set(cached_plans->Add({}), leaves);
+}
+
+void Mapper::report_rejected_series() {
+    if (!limiting_series) {
+        return;
+    }
+    Family<Counter>* rejected_family = 
+            boost::get<Family<Counter>*>(metric_map["series_rejected_total"]);
+    vector<pair<string, uint64_t>> counts = {};
+    rejected_metric rejected;
+    for (map<string, Family_variant>::iterator it = metric_map.begin();
+            it != metric_map.end(); ++it) {
+        counts.push_back(
+                make_pair(it->first, boost::apply_visitor(rejected, it->second)));
+    }
+    for (map<string, std::shared_ptr<Aggregation>>::iterator it = 
+                aggregations.begin();
+            it != aggregations.end(); ++it) {
+        counts.push_back(make_pair(it->first, it->second->rejected_count()));
+    }
+
+    for (int i = 0; i < counts.size(); ++i) {
+        uint64_t& seen = rejected_seen[counts[i].first];
+        // a family registered again after a reload starts from zero
+        if (counts[i].second > seen) {
+            rejected_family->Add({{"metric", counts[i].first}})
+                    .Increment(counts[i].second - seen);
+        }
+        seen = counts[i].second;
+    }
+}
+
+/*
+* Families are registered with InsertBehavior::Merge, so register_metrics
+* returns the family of PREVIOUS for every metric that did not change.
+* Only the others have to be removed first.
+*/
+bool Mapper::replace(Mapper& previous, std::shared_ptr<Registry> registry) {
+    if (!gauge_blocks != !previous.gauge_blocks) {
+        std::cout << "consistent_snapshots cannot be changed ";
+        std::cout << "without restarting the route" << endl;
+        return false;
+    }
+
+    remove_metric remover;
+    remover.registry = registry.get();
+    Family<Counter>* skipped_family = 
+            boost::get<Family<Counter>*>(
+                    previous.metric_map["skipped_leaves_total"]);
+    for (map<string, MetricConfig*>::const_iterator cit = 
+                previous.config_map.begin();
+            cit != previous.config_map.end(); ++cit) {
+        map<string, MetricConfig*>::const_iterator now = 
+                config_map.find(cit->first);
+        bool kept = now != config_map.end() 
+                && now->second->type == cit->second->type
+                && now->second->help == cit->second->help
+                && aggregations.count(cit->first) 
+                        == previous.aggregations.count(cit->first);
+        map<string, std::shared_ptr<Aggregation>>::iterator previous_agg = 
+                previous.aggregations.find(cit->first);
+        if (previous_agg != previous.aggregations.end()) {
+            std::shared_ptr<Aggregation>& agg = aggregations[cit->first];
+            if (kept && agg->same_rule(*(previous_agg->second))) {
+                // keeps the last values of all instances
+                agg = previous_agg->second;
+            } else {
+                previous_agg->second->remove_families(*registry);
+                if (!agg) {
+                    aggregations.erase(cit->first);
+                }
+            }
+        }
+        if (kept) {
+            continue;
+        }
+        map<string, Family_variant>::iterator fam = 
+                previous.metric_map.find(cit->first);
+        if (fam != previous.metric_map.end()) {
+            boost::apply_visitor(remover, fam->second);
+            previous.metric_map.erase(fam);
+        }
+        // series of shared families may still be used by other routes
+        map<string, Counter*>::iterator skipped = 
+                previous.skipped_counters.find(cit->first);
+        if (skipped_family && skipped != previous.skipped_counters.end()) {
+            if (release_shared(skipped->second)) {
+                skipped_family->Remove(skipped->second);
+            }
+            previous.skipped_counters.erase(skipped);
+        }
+        map<string, Histogram*>::iterator timed = 
+                previous.update_durations.find(cit->first);
+        if (timed != previous.update_durations.end()) {
+            if (release_shared(timed->second)) {
+                previous.update_duration_family->Remove(timed->second);
+            }
+            previous.update_durations.erase(timed);
+        }
+        map<string, Family<ColumnarGauge>::Handle>::iterator counted = 
+                previous.family_series_handles.find(cit->first);
+        if (counted != previous.family_series_handles.end()) {
+            previous.family_series->Remove(counted->second);
+            previous.family_series_handles.erase(counted);
+        }
+    }
+
+    if (gauge_blocks) {
+        // blocks are resolved again against the new layout
+        for (map<string, InstanceBatch>::iterator it = 
+                    previous.instance_batches.begin();
+                it != previous.instance_batches.end(); ++it) {
+            if (it->second.block != NULL) {
+                previous.gauge_blocks->RemoveBlock(*(it->second.block));
+            }
+        }
+        previous.instance_batches.clear();
+        gauge_blocks = previous.gauge_blocks;
+        block_families = previous.block_families;
+    }
+
+    rejected_seen = previous.rejected_seen;
+    register_metrics(registry);
+    return true;
+}
+
+/*
+* Create Family (container of metrics) 
+* and register it to REGISTRY
+* Return: Family<T>* for T = Counter, Gauge, Histogram, or Summary
+* and return boost::blank if fail
+*/
+Family_variant Mapper::create_metric(
+        MetricType type,
+        MetricName name,
+        string detail, 
+        const Label& labels,
+        std::shared_ptr<Registry> registry,
+        const string& unit) {
+    Family_variant family = boost::blank();
+    switch(type){
+        case MetricType::Counter:
+            family = &(BuildCounter().Name(name).Help(detail).Unit(unit).Labels(labels).Register(*registry));
+            break;
+        case MetricType::Gauge:
+            family = &(BuildColumnarGauge().Name(name).Help(detail).Unit(unit).Labels(labels).Register(*registry));
+            break;
+        case MetricType::Histogram:
+            family = &(BuildHistogram().Name(name).Help(detail).Unit(unit).Labels(labels).Register(*registry));
+            break;
+        case MetricType::Summary:
+            family = &(BuildSummary().Name(name).Help(detail).Unit(unit).Labels(labels).Register(*registry));
+            break;
+        default:
+            break;
+    }
+    // released by remove_metric or the destructor of the Mapper
+    address_metric address;
+    hold_shared(boost::apply_visitor(address, family));
+    return family;
+}
+
+Family_variant Mapper::create_metric(
+        MetricConfig* famConfig,
+        std::shared_ptr<Registry> registry) {
+    return create_metric(
+            famConfig->type,
+            famConfig->name,
+            famConfig->help,
+            {},
+            registry,
+            famConfig->unit);
+}
+
+bool Mapper::is_auto_mapping() {
+    return is_auto_map;
+}
+
+bool Mapper::use_key_hash_label() {
+    return use_key_hash;
+}
+
+std::shared_ptr<GaugeBlockGroup> Mapper::consistent_gauges() {
+    return gauge_blocks;
+}
+
+string Mapper::data_path_to_label_name(DataPath data_path) {
+    string updated_name = boost::replace_all_copy(data_path, ".", "_");
+    boost::replace_all(updated_name, "[", "_");
+    boost::replace_all(updated_name, "]", "_");
+    return updated_name;
+}
+
+void Mapper::format_key_label(Label& key_label) {
+    Label updated_label;
+    for(map<string, string>::const_iterator cit = key_label.begin();
+            cit != key_label.end(); cit++) {
+        string updated_name = data_path_to_label_name(cit->first);
+        updated_label[updated_name] = cit->second;
+    }
+    key_label.clear();
+    key_label = updated_label;
+}
+/* 
+*  Utility function to determine type of metric 
+*  based on sting TYPE given
+*  Return: MetricType 
+*/
+MetricType Mapper::what_type(std::string type) {
     if (boost::iequals(type, "counter")) {
         return MetricType::Counter;
     } else if (boost::iequals(type, "gauge")) {
@@ -565,32 +1604,72 @@ double Mapper::get_value(
         const DynamicData& data,
         DataPath data_path,
         TypeKind kind) {
-    DynamicData temp = data;
     if (kind.underlying() == TypeKind::INT_16_TYPE ) {
-        return (double) temp.value<int16_t>(data_path);
+        return (double) data.value<int16_t>(data_path);
     } else if (kind.underlying() == TypeKind::UINT_16_TYPE) {
-        return (double) temp.value<uint16_t>(data_path);
+        return (double) data.value<uint16_t>(data_path);
     } else if (kind.underlying() == TypeKind::INT_32_TYPE) {
-        return (double) temp.value<int32_t>(data_path);
+        return (double) data.value<int32_t>(data_path);
     } else if (kind.underlying() == TypeKind::UINT_32_TYPE) {
-        return (double) temp.value<uint32_t>(data_path);
+        return (double) data.value<uint32_t>(data_path);
     } else if (kind.underlying() == TypeKind::INT_64_TYPE) {
-        return (double) temp.value<int64_t>(data_path);
+        return (double) data.value<int64_t>(data_path);
     } else if (kind.underlying() == TypeKind::UINT_64_TYPE) {
-        return (double) temp.value<uint64_t>(data_path);
+        return (double) data.value<uint64_t>(data_path);
     } else if (kind.underlying() == TypeKind::FLOAT_32_TYPE) {
-        return (double) temp.value<float>(data_path);
+        return (double) data.value<float>(data_path);
     } else if (kind.underlying() == TypeKind::FLOAT_64_TYPE) {
-        return temp.value<double>(data_path);
+        return data.value<double>(data_path);
     // } else if (kind == TypeKind::FLOAT_128_TYPE) {
-    //     return (double) temp.value<rti::core::LongDouble>(path[i]);
+    //     return (double) data.value<rti::core::LongDouble>(path[i]);
     } else {
-        return (double) temp.value<int>(data_path);
+        return (double) data.value<int>(data_path);
     }
     throw new std::runtime_error("get_value: can't find value");
     return 0;
 }
 
+/*
+*  Append all elements of a primitive collection to VARS. The typed buffer
+*  is kept per thread so large collections are not reallocated per sample.
+*/
+template<typename T>
+static size_t append_values(
+        vector<double>& vars,
+        const DynamicData& data,
+        const MemberName& member_name) {
+    static thread_local vector<T> buffer;
+    data.get_values(member_name, buffer);
+    vars.insert(vars.end(), buffer.begin(), buffer.end());
+    return buffer.size();
+}
+
+size_t Mapper::get_collection_values(
+        vector<double>& vars,
+        const DynamicData& data,
+        MemberName member_name,
+        TypeKind kind) {
+    if (kind.underlying() == TypeKind::INT_16_TYPE ) {
+        return append_values<int16_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::UINT_16_TYPE) {
+        return append_values<uint16_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::INT_32_TYPE) {
+        return append_values<int32_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::UINT_32_TYPE) {
+        return append_values<uint32_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::INT_64_TYPE) {
+        return append_values<int64_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::UINT_64_TYPE) {
+        return append_values<uint64_t>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::FLOAT_32_TYPE) {
+        return append_values<float>(vars, data, member_name);
+    } else if (kind.underlying() == TypeKind::FLOAT_64_TYPE) {
+        return append_values<double>(vars, data, member_name);
+    } else {
+        return append_values<int>(vars, data, member_name);
+    }
+}
+
 bool Mapper::is_primitive_kind(TypeKind kind) {
     if (kind.underlying() == TypeKind::INT_16_TYPE ) {
         return true;
@@ -611,207 +1690,367 @@ bool Mapper::is_primitive_kind(TypeKind kind) {
     } else if (kind.underlying() == TypeKind::FLOAT_128_TYPE) {
         return true;
     } else {
-        return false;
+        return false;
+    }
+}
+
+/*
+*  Add the labels of all members inside of DATA, a struct or union,
+*  named after LABEL_NAME. Only members present in DATA are read.
+*/
+static void get_member_labels(
+        Label& key_labels,
+        const DynamicData& data,
+        const DataPath& label_name) {
+    for (uint32_t i = 1; i <= data.member_count(); ++i) {
+        if (!data.member_exists(i)) { // union and optional
+            continue;
+        }
+        rti::core::xtypes::DynamicDataMemberInfo info = data.member_info(i);
+        Mapper::get_key_labels(
+                key_labels, 
+                data, 
+                info.member_name(), 
+                label_name + "." + info.member_name());
+    }
+}
+
+void Mapper::get_key_labels(
+        Label& key_labels,
+        const DynamicData& data,
+        const MemberName& member_name,
+        const DataPath& label_name) {
+    rti::core::xtypes::DynamicDataMemberInfo info = 
+            data.member_info(member_name);
+    TypeKind kind = info.member_kind();
+    if (is_primitive_kind(kind)) {
+        double value = get_value(data, member_name, kind);
+        key_labels[label_name] = to_string(value);
+        return;
+    }
+
+    switch (kind.underlying()) {
+    case TypeKind::STRING_TYPE:
+    case TypeKind::WSTRING_TYPE:
+        key_labels[label_name] = data.value<string>(member_name);
+        break;
+    case TypeKind::ARRAY_TYPE:
+    case TypeKind::SEQUENCE_TYPE: {
+        TypeKind element_kind = info.element_kind();
+        if (is_primitive_kind(element_kind)) {
+            vector<double> values = {};
+            get_collection_values(values, data, member_name, element_kind);
+            for (int i = 0; i < values.size(); ++i) {
+                key_labels[label_name + "[" + to_string(i) + "]"] = 
+                        to_string(values[i]);
+            }
+            break;
+        }
+        // borrow the collection to read its elements by index
+        rti::core::xtypes::LoanedDynamicData collection =
+                const_cast<DynamicData&>(data).loan_value(member_name);
+        for (uint32_t i = 1; i <= collection.get().member_count(); ++i) {
+            string element_label = label_name + "[" + to_string(i - 1) + "]";
+            if (element_kind.underlying() == TypeKind::STRING_TYPE
+                    || element_kind.underlying() == TypeKind::WSTRING_TYPE) {
+                key_labels[element_label] = 
+                        collection.get().value<string>(i);
+            } else if (element_kind.underlying() == TypeKind::STRUCTURE_TYPE
+                    || element_kind.underlying() == TypeKind::UNION_TYPE) {
+                rti::core::xtypes::LoanedDynamicData element = 
+                        collection.get().loan_value(i);
+                get_member_labels(key_labels, element.get(), element_label);
+            }
+        }
+    }
+        break;
+    case TypeKind::STRUCTURE_TYPE:
+    case TypeKind::UNION_TYPE: {
+        rti::core::xtypes::LoanedDynamicData member =
+                const_cast<DynamicData&>(data).loan_value(member_name);
+        get_member_labels(key_labels, member.get(), label_name);
+    }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+*  DATA_PATH relative to BASE, the data_path of a collection containing it
+*/
+static DataPath relative_path(const DataPath& data_path, const DataPath& base) {
+    if (base.empty()) {
+        return data_path;
+    }
+    if (data_path.compare(0, base.size() + 1, base + ".") == 0) {
+        return data_path.substr(base.size() + 1);
+    }
+    return data_path == base ? "" : data_path;
+}
+
+/*
+*  true if DATA_PATH is BASE or a member inside of it
+*/
+static bool is_within(const DataPath& data_path, const DataPath& base) {
+    return base.empty() 
+            || data_path == base 
+            || data_path.compare(0, base.size() + 1, base + ".") == 0;
+}
+
+/*
+*  Steps to the members of DATA_PATH from data of TYPE (NULL if unknown).
+*  TYPE is advanced to the type of the last member.
+*/
+static vector<PathStep> compile_steps(
+        const DataPath& data_path,
+        const DynamicType*& type) {
+    vector<PathStep> steps = {};
+    if (data_path.empty()) {
+        return steps;
+    }
+    vector<string> names = {};
+    boost::split(names, data_path, [](char c){return c == '.';});
+    for (int i = 0; i < names.size(); ++i) {
+        PathStep step;
+        step.name = names[i];
+        step.presence = PathStep::UNCHECKED;
+        while (type != NULL 
+                && type->kind().underlying() == TypeKind::ALIAS_TYPE) {
+            type = &resolve_alias(static_cast<const AliasType&>(*type));
+        }
+        if (type != NULL 
+                && type->kind().underlying() == TypeKind::STRUCTURE_TYPE) {
+            const StructType& struct_type = 
+                    static_cast<const StructType&>(*type);
+            uint32_t index = struct_type.find_member_by_name(names[i]);
+            if (index < struct_type.member_count()) {
+                const Member& member = struct_type.member(index);
+                step.presence = member.is_optional() 
+                        ? PathStep::OPTIONAL_MEMBER : PathStep::REQUIRED;
+                type = &member.type();
+            } else {
+                type = NULL;
+            }
+        } else if (type != NULL 
+                && type->kind().underlying() == TypeKind::UNION_TYPE) {
+            const UnionType& union_type = 
+                    static_cast<const UnionType&>(*type);
+            uint32_t index = union_type.find_member_by_name(names[i]);
+            if (index < union_type.member_count()) {
+                const UnionMember& member = union_type.member(index);
+                step.presence = PathStep::UNION_CASE;
+                step.labels = member.labels();
+                type = &member.type();
+            } else {
+                type = NULL;
+            }
+        } else {
+            type = NULL;
+        }
+        steps.push_back(step);
+    }
+    return steps;
+}
+
+/*
+*  true if the member of STEP is present in DATA
+*/
+static bool is_present(const DynamicData& data, const PathStep& step) {
+    switch (step.presence) {
+    case PathStep::REQUIRED:
+        return true;
+    case PathStep::UNION_CASE:
+        if (!step.labels.empty()) {
+            return std::find(
+                    step.labels.begin(),
+                    step.labels.end(),
+                    data.discriminator_value()) != step.labels.end();
+        }
+        // default case
+        return data.member_exists(step.name);
+    default:
+        return data.member_exists(step.name);
+    }
+}
+
+/*
+*  Descend DATA along all but the last of STEPS, loans are kept in LOANS.
+*  Return the data containing the last member, NULL if a member is absent.
+*/
+static DynamicData* descend(
+        const DynamicData& data,
+        const vector<PathStep>& steps,
+        vector<rti::core::xtypes::LoanedDynamicData>& loans) {
+    // loans borrow the members in place, the sample itself is not modified
+    DynamicData* current = &const_cast<DynamicData&>(data);
+    loans.reserve(steps.size());
+    for (int i = 0; i < steps.size(); ++i) {
+        if (!is_present(*current, steps[i])) {
+            return NULL;
+        }
+        if (i + 1 == steps.size()) {
+            break;
+        }
+        loans.push_back(current->loan_value(steps[i].name));
+        current = &(loans.back().get());
+    }
+    return current;
+}
+
+/*
+*  Compile the level of CONFIG inside the collection at BASE 
+*  (empty for the sample). COLLECTIONS ordered from outermost.
+*  TYPE is the type of the data of this level, NULL if unknown.
+*/
+static PlanPtr compile_level(
+        const MetricConfig& config,
+        const vector<DataPath>& collections,
+        size_t level,
+        const DataPath& base,
+        const DynamicType* type) {
+    std::shared_ptr<PlanNode> node = std::make_shared<PlanNode>();
+    node->bulk = false;
+    node->data_type = config.data_type;
+    bool is_leaf = level == collections.size();
+
+    // keys of this level, keys inside the next collection belong to elements
+    for (map<string, string>::const_iterator cit = config.key_map.begin();
+            cit != config.key_map.end(); ++cit) {
+        if (is_within(cit->second, base) 
+                && (is_leaf || !is_within(cit->second, collections[level]))) {
+            const DynamicType* key_type = type;
+            DataPath key_path = relative_path(cit->second, base);
+            node->key_paths.push_back(key_path);
+            node->key_steps.push_back(compile_steps(key_path, key_type));
+        }
+    }
+
+    if (is_leaf) {
+        node->steps = 
+                compile_steps(relative_path(config.data_path, base), type);
+        return node;
+    }
+
+    node->steps = 
+            compile_steps(relative_path(collections[level], base), type);
+    node->collection = node->steps.back().name;
+    node->index_label = node->collection + "_index";
+
+    if (level + 1 == collections.size() 
+            && config.data_path == collections[level]
+            && Mapper::is_primitive_kind(config.data_type)) {
+        node->bulk = true;
+        return node;
+    }
+
+    // type of the elements
+    while (type != NULL && type->kind().underlying() == TypeKind::ALIAS_TYPE) {
+        type = &resolve_alias(static_cast<const AliasType&>(*type));
+    }
+    if (type != NULL && type->kind().underlying() == TypeKind::ARRAY_TYPE) {
+        type = &static_cast<const ArrayType&>(*type).content_type();
+    } else if (type != NULL 
+            && type->kind().underlying() == TypeKind::SEQUENCE_TYPE) {
+        type = &static_cast<const SequenceType&>(*type).content_type();
+    } else {
+        type = NULL;
     }
+    node->element = compile_level(
+            config, collections, level + 1, collections[level], type);
+    return node;
 }
 
-void Mapper::get_key_labels(
-        Label& key_labels,
-        const DynamicData& data,
-        DataPath data_path) {
-    //DEBUG
-    std::cout << "In get_key_labels: " << data_path << endl;
-    
-    try 
-    {
-        TypeKind kind = data.member_info(data_path).member_kind();
-        std::cout << "get info ok" << endl;
-        if (is_primitive_kind(kind)) {
-            // DEBUG
-            std::cout << "get_key_labels: primitive" << endl;
-            double value = get_value(data, data_path, kind);
-            // DEBUG
-            std::cout << "get key " << value << endl;
-            string str_rep = to_string(value);
-            key_labels[data_path] = str_rep;
-            std::cout << "finish insert" << endl;
-            return;
-        }
-
-        DynamicData trav_data = data.value<DynamicData>(data_path);
-        std::cout << "DynamicData Bind sucessful" << endl;
-        if (trav_data.type_kind().underlying() == TypeKind::STRING_TYPE 
-                || trav_data.type_kind().underlying() == 
-                        TypeKind::WSTRING_TYPE) {
-            // DEBUG
-            std::cout << "get_key_labels: string" << endl;
-            string value = data.value<string>(data_path);
-            // DEBUG
-            std::cout << "get key " << value << endl;
-            key_labels[data_path] = value;
-        } else if (is_collection_type(trav_data.type())) {
-            int count = trav_data.member_count();
-            // DEBUG
-            std::cout << "get_key_labels: collection " << count << endl;
-            for (int i =0; i < count; ++i) {
-                string new_data_path = data_path + "[" + to_string(i) + "]";
-                get_key_labels(key_labels, data, new_data_path);
-            }
-        } else if (is_constructed_type(trav_data.type())) {
-            int member_count = trav_data.member_count();
-            // DEBUG
-            std::cout << "get_key_labels: struct " << member_count << endl;
-            for (int i = 1; i <= member_count; ++i) { 
-                if (trav_data.member_exists(i)) { // for union and optional
-                    string member_name = trav_data.member_info(i).member_name();
-                    string new_data_path = data_path + "." + member_name;
-                    get_key_labels(key_labels, data, new_data_path);
-                }
-            }
-        }
-    } catch (dds::core::InvalidArgumentError e) {
-        std::cout << e.what() << endl;
-        return; // member does not exist so leave it
-    } catch (dds::core::IllegalOperationError e) {
-        std::cout << "wrong type " << e.what() << endl;
-        return;
-    } catch (...) {
-        std:;cout << "unknown exception" << endl;
-        return;
+PlanPtr Mapper::compile_plan(
+        const MetricConfig& config,
+        const DynamicType* topic_type) {
+    vector<DataPath> collections = {};
+    for (map<string, string>::const_iterator cit = 
+                config.collection_map.begin();
+            cit != config.collection_map.end(); ++cit) {
+        collections.push_back(cit->second);
     }
-    
+    // outer collections are prefixes of inner ones
+    std::sort(collections.begin(), collections.end(),
+            [](const DataPath& a, const DataPath& b) {
+                return a.size() < b.size();
+            });
+    return compile_level(config, collections, 0, "", topic_type);
 }
 
-// deal with array or sequence
-// TODO
-void Mapper::get_data(
+size_t Mapper::get_data(
         vector<Label>& set_labels,
         vector<double>& vars, 
         const DynamicData& data,
-        MetricConfig config) {
-    
-    // no list in path (base case)
-    if (config.collection_map.empty()) {
-        // labels
-        map<string, string> key_labels;
-        for (map<string, string>::const_iterator cit = config.key_map.begin();
-                cit != config.key_map.end(); ++cit) {
-            
-            // DEBUG
-            std::cout << "get_data: before get_key_labels" << endl;
-            std::cout << "key: " << cit->second << endl;
-            get_key_labels(key_labels, data, cit->second);
-            std::cout << "get_key_labels success " << endl << endl;
-            
-        }
-        set_labels.push_back(key_labels);    
-        
-        // value
-        double var = get_value(data, config.data_path, config.data_type);
-        vars.push_back(var);
-
-    } else {
-        // collection in path
-        std::vector<string> path_list = {};
-        string str_path_list = config.collection_map.begin()->second;
-        boost::split(path_list, str_path_list, [](char c){return c == '.';});
-
-        // get key labels before list
-        map<string, string> key_labels = {};
-        // key_map for recursive 
-        map<string, string> new_key_map = config.key_map;
-        for (map<string, string>::const_iterator cit = config.key_map.begin();
-                cit != config.key_map.end(); ++cit) {
-            std::vector<string> path_key = {};
-            string str_path_key = cit->second;
-            boost::split(path_key, str_path_key, [](char c){return c == '.';});
-            // key before list 
-            // key after list depend on what element of list
-            if (path_key.size() < path_list.size()) {
-                map<string, string> key_labels;
-                get_key_labels(key_labels, data, cit->second);
-                new_key_map.erase(cit->first);
-            } else {
-                // stop when key is a member of element of list
-                break;
-            }
-        }    
-
-        // TODO modify config
-        MetricConfig new_config(config);
-        
-        // only the unseen keys
-        new_config.key_map = new_key_map;
-
-        // adjust MetricConfig for recursive
-        for (map<string, string>::iterator it = new_config.key_map.begin();
-                it != new_config.key_map.end(); ++it) {
-            it->second.erase(0, str_path_list.length() + 1);
-        }
+        const MetricConfig& config) {
+    if (config.plan) {
+        return extract(*(config.plan), data, Label(), set_labels, vars);
+    }
+    // not registered yet
+    return extract(*compile_plan(config), data, Label(), set_labels, vars);
+}
 
-        // recursively call on members of the first list
-        new_config.collection_map.erase(config.collection_map.begin()->first);
-        for (map<string, string>::iterator it =
-                new_config.collection_map.begin();
-                it != new_config.collection_map.end(); ++it) {
-            it->second.erase(0, str_path_list.length() + 1);
+size_t Mapper::extract(
+        const PlanNode& node,
+        const DynamicData& data,
+        const Label& labels,
+        vector<Label>& set_labels,
+        vector<double>& vars) {
+    Label level_labels = labels;
+    for (int i = 0; i < node.key_paths.size(); ++i) {
+        vector<rti::core::xtypes::LoanedDynamicData> key_loans;
+        DynamicData* parent = descend(data, node.key_steps[i], key_loans);
+        if (parent != NULL && !node.key_steps[i].empty()) {
+            get_key_labels(
+                    level_labels,
+                    *parent,
+                    node.key_steps[i].back().name,
+                    node.key_paths[i]);
         }
-        new_config.data_path.erase(0, str_path_list.length() + 1);
+    }
 
-        // Traverse to list
-        DynamicData temp = data;
-        try {
+    vector<rti::core::xtypes::LoanedDynamicData> loans;
+    DynamicData* parent = descend(data, node.steps, loans);
+    if (parent == NULL) {
+        return 1;
+    }
 
-            // traverse to the array or sequence parent
-            for (int i = 0; i < path_list.size() - 1; ++i) {
-                if (temp.member_exists(path_list[i])) {
-                    temp = temp.value<DynamicData>(path_list[i]);
-                } else {
-                    set_labels.clear();
-                    vars.clear();
-                }
-            }
-            string name_list = path_list[path_list.size()-1];
-            rti::core::xtypes::LoanedDynamicData vec =
-                    temp.loan_value(name_list);
-            name_list.append("_index");
-
-            // recursice on all element in the list
-            for (size_t i = 1; i <= vec.get().member_count(); ++i) {
-
-                // assume vector can contain multiple empty maps
-                vector<map<string, string>> recur_set_labels = {};
-                vector<double> recur_vars = {};
-                get_data(
-                        recur_set_labels,
-                        recur_vars,
-                        vec.get().loan_value(i).get(),
-                        new_config);
-
-                // append parent key labels to the each child labels
-                for (int j = 0; j < recur_set_labels.size(); ++j) {
-                    recur_set_labels[j].insert(
-                            key_labels.begin(),
-                            key_labels.end());
-                    recur_set_labels[j][name_list] = to_string(i);
-                }
-                // DEBUG
-                if (recur_set_labels.size() != recur_vars.size()) {
-                    cout << "labels not match values. ABORT!" << endl;
-                    throw new dds::core::Error("labels not match values");
-                }
-                set_labels.insert(
-                        set_labels.end(),
-                        recur_set_labels.begin(),
-                        recur_set_labels.end());
-                vars.insert(vars.end(), recur_vars.begin(), recur_vars.end());
-            }
+    // no list in path (base case)
+    if (node.collection.empty()) {
+        string name = node.steps.empty() ? "" : node.steps.back().name;
+        vars.push_back(get_value(*parent, name, node.data_type));
+        set_labels.push_back(level_labels);
+        return 0;
+    }
 
-        } catch (std::exception e) {
-            cout << "get_data: DynamicData traversal fail." << endl;
+    if (node.bulk) {
+        size_t count = get_collection_values(
+                vars, *parent, node.collection, node.data_type);
+        for (size_t i = 0; i < count; ++i) {
+            Label element_labels = level_labels;
+            element_labels[node.index_label] = to_string(i + 1);
+            set_labels.push_back(element_labels);
         }
-        
+        return 0;
+    }
+
+    loans.push_back(parent->loan_value(node.collection));
+    DynamicData& collection = loans.back().get();
+    Label element_labels = level_labels;
+    size_t skipped = 0;
+    // only one element can be loaned at a time
+    for (uint32_t i = 1; i <= collection.member_count(); ++i) {
+        element_labels[node.index_label] = to_string(i);
+        rti::core::xtypes::LoanedDynamicData element = 
+                collection.loan_value(i);
+        skipped += extract(
+                *(node.element),
+                element.get(),
+                element_labels,
+                set_labels,
+                vars);
     }
+    return skipped;
 }
 
 // labels we need:
@@ -819,6 +2058,14 @@ void Mapper::get_data(
 //  {index, ...} for members that is array or sequnce type
 int Mapper::update_metrics(const dds::core::xtypes::DynamicData& data, 
                            const dds::sub::SampleInfo& info) {
+    ScopedTimer sample_timer(sample_duration);
+    // the updates of single metrics are timed for some samples only
+    bool timing_updates = false;
+    if (!update_durations.empty() 
+            && ++samples_since_timing >= metric_timing_every) {
+        samples_since_timing = 0;
+        timing_updates = true;
+    }
     Family<Counter>* counter_fam = 
             boost::get<Family<Counter>*>(
                     metric_map["call_on_data_available_total"]);
@@ -834,8 +2081,17 @@ int Mapper::update_metrics(const dds::core::xtypes::DynamicData& data,
             updater.labels = {{"topic", topic_name}, {"key", "0"}};
         } else {
             map<string, string> key_labels = {};
-            for (string data_path: instance_identifiers) {
-                get_key_labels(key_labels, data, data_path);
+            for (int i = 0; i < instance_steps.size(); ++i) {
+                vector<rti::core::xtypes::LoanedDynamicData> key_loans;
+                DynamicData* parent = 
+                        descend(data, instance_steps[i], key_loans);
+                if (parent != NULL && !instance_steps[i].empty()) {
+                    get_key_labels(
+                            key_labels,
+                            *parent,
+                            instance_steps[i].back().name,
+                            instance_identifiers[i]);
+                }
             }
             std::stringstream ss;
             ss << info.instance_handle();
@@ -846,78 +2102,651 @@ int Mapper::update_metrics(const dds::core::xtypes::DynamicData& data,
         boost::apply_visitor(updater, metric_map["instance_info"]);
     }
 
+    std::stringstream ss;
+    ss << info.instance_handle();
+    string key_hash = ss.str();
+    // gauges carry the time the value was written at the source, 
+    // so prometheus can scrape less often without losing precision
+    int64_t timestamp_ms = 0;
+    if (use_source_timestamps 
+            && info.source_timestamp() != dds::core::Time::invalid()) {
+        timestamp_ms = info.source_timestamp().to_millisecs();
+    }
+
+    // values of all gauge metrics of this sample, published in one pass
+    vector<double> gauge_values = {};
+    vector<size_t> gauge_layout = {};
+    vector<pair<MetricName, vector<Label>>> gauge_labels = {};
+
     for (map<string, MetricConfig*>::const_iterator cit = config_map.begin();
             cit != config_map.end(); ++cit) {
-        //DEBUG 
-        std::cout << "metric to be updated: " << cit->first << endl;
+        ScopedTimer metric_timer(
+                timing_updates ? update_durations[cit->first] : NULL);
+        map<string, std::shared_ptr<Aggregation>>::iterator agg = 
+                aggregations.find(cit->first);
+        bool is_gauge = agg == aggregations.end() 
+                && (block_families.count(cit->first) != 0 
+                        || boost::get<Family<ColumnarGauge>*>(
+                                &metric_map[cit->first]));
         vector<map<string,string>> labels_list = {};
         vector<double> vars = {};
-        try{
-            Mapper::get_data(labels_list, vars, data, *(cit->second));
-            if (vars.empty() && labels_list.empty()) {
-                continue;
-            }
-            // DEBUG
-            std::cout << " return ";
-            for (int i=0;i<vars.size();++i) {cout<<vars[i];} 
-            cout << endl;
-        } catch(std::exception& e) {
-            std::cout << "get_data error: " << e.what() << endl;
-            continue; 
-            vars.push_back(0.0);
-        } catch(...) {
-            std::cout << "get_data throw unexpected exception" << endl;
-            vars.push_back(0.0);
+        // absent members are skipped by the plan, nothing is thrown
+        size_t skipped = 
+                Mapper::get_data(labels_list, vars, data, *(cit->second));
+        if (skipped > 0) {
+            skipped_counters[cit->first]->Increment(skipped);
+        }
+        if (vars.empty() && labels_list.empty()) {
+            continue;
         }
 
-        if (labels_list.size() != vars.size()) {
-            std::cout << "labels_list != vars" << endl;
-            std::cout << "labels_list: " << labels_list.size() << endl;
+        if (agg != aggregations.end()) {
+            Label sample_labels = agg->second->sample_labels(data);
+            for (int i = 0; i < vars.size() && i < labels_list.size(); ++i) {
+                agg->second->update(
+                        key_hash, 
+                        series_labels(labels_list[i], key_hash), 
+                        sample_labels,
+                        vars[i]);
+            }
+            continue;
+        }
+        if (is_gauge && labels_list.size() == vars.size()) {
+            // labels are only needed if the batch has to be resolved again
+            gauge_values.insert(gauge_values.end(), vars.begin(), vars.end());
+            gauge_layout.push_back(vars.size());
+            gauge_labels.push_back(make_pair(cit->first, labels_list));
+            continue;
         }
 
-        //DEBUG
-        std::cout << "labels_list == vars.size()" << endl;
         // update all time series associated with this metric
         update_metric updater;
+        updater.timestamp_ms = timestamp_ms;
         for (int i = 0; i < vars.size(); ++i) {
             updater.value = vars[i];
-            if (labels_list[i].empty() || use_key_hash_label()) {
-                // DEBUG
-                std::cout << "update_metric no key" << endl;
-                std::cout << "metric name " << cit->first << endl;
-                std::stringstream ss;
-                ss << info.instance_handle();
-                updater.labels = labels_list[i]; 
-                updater.labels["Key_hash"] = ss.str();
-                boost::apply_visitor(updater, metric_map[cit->first]);
-            } else {
-                // DEBUG
-                std::cout << "update_metric with key labels" << endl;
-                std::cout << "metric name " << cit->first << endl;
-                map<string, string> label_update;
-                for(map<string, string>::const_iterator cit = labels_list[i].begin();
-                        cit != labels_list[i].end(); cit++) {
-                    std::cout << cit->first <<", "<< cit->second << endl;
-                    string updated_name = 
-                            boost::replace_all_copy(cit->first, ".", "_");
-                    boost::replace_all(updated_name, "[", "_");
-                    boost::replace_all(updated_name, "]", "_");
-                    // DEBUG
-                    std::cout << "Update name: " << updated_name << endl;
-                    label_update[updated_name] = cit->second;
-                } 
-                updater.labels = label_update;
-                boost::apply_visitor(updater, metric_map[cit->first]);
-            }
-        }
-        std::cout << "Finish with: " << cit->first << endl << endl << endl;
+            updater.labels = series_labels(labels_list[i], key_hash);
+            boost::apply_visitor(updater, metric_map[cit->first]);
+        }
+    }
+
+    if (!gauge_values.empty()) {
+        publish_gauges(
+                key_hash, 
+                gauge_values, 
+                gauge_layout, 
+                gauge_labels, 
+                timestamp_ms);
+    }
+    if (info.state().instance_state() 
+            != dds::sub::status::InstanceState::alive()) {
+        // no more samples of this instance expected
+        map<string, InstanceBatch>::iterator it = 
+                instance_batches.find(key_hash);
+        if (it != instance_batches.end()) {
+            if (it->second.block != NULL) {
+                gauge_blocks->RemoveBlock(*(it->second.block));
+            }
+            instance_batches.erase(it);
+        }
+        for (map<string, std::shared_ptr<Aggregation>>::iterator agg = 
+                    aggregations.begin();
+                agg != aggregations.end(); ++agg) {
+            agg->second->remove_instance(key_hash);
+        }
     }
 
     return 1;
 }
+
+void Mapper::publish_gauges(
+        const string& key_hash,
+        const vector<double>& gauge_values,
+        const vector<size_t>& gauge_layout,
+        const vector<pair<MetricName, vector<Label>>>& gauge_labels,
+        int64_t timestamp_ms) {
+    InstanceBatch& entry = instance_batches[key_hash];
+    entry.epoch = batch_expiry.Epoch();
+    // many leaves hardly ever change, e.g. configuration values.
+    // Unchanged columnar gauges still have to be touched to not expire.
+    // Unchanged values still get the timestamp of the newer sample,
+    // prometheus would consider them stale otherwise
+    bool expiring = 
+            series_max_age != std::chrono::steady_clock::duration::zero();
+    if (entry.layout == gauge_layout && entry.values == gauge_values
+            && (gauge_blocks || !expiring) && timestamp_ms == 0) {
+        return;
+    }
+    if (gauge_blocks) {
+        entry.values = gauge_values;
+        if (entry.block == NULL || entry.layout != gauge_layout) {
+            vector<GaugeBlock::Series> series = {};
+            for (int i = 0; i < gauge_labels.size(); ++i) {
+                size_t family = block_families[gauge_labels[i].first];
+                const vector<Label>& labels = gauge_labels[i].second;
+                for (int j = 0; j < labels.size(); ++j) {
+                    GaugeBlock::Series one_series;
+                    one_series.family = family;
+                    one_series.labels = series_labels(labels[j], key_hash);
+                    series.push_back(one_series);
+                }
+            }
+            if (entry.block != NULL) {
+                gauge_blocks->RemoveBlock(*(entry.block));
+            }
+            entry.layout = gauge_layout;
+            entry.block = &(gauge_blocks->AddBlock(series));
+        }
+        // one epoch flip makes the whole sample visible
+        entry.block->Publish(gauge_values, timestamp_ms);
+        return;
+    }
+
+    bool resolved = entry.layout == gauge_layout && entry.batch.Size() != 0;
+    // only the leaves that changed, unless all have to be touched
+    bool changed_only = resolved && !expiring && timestamp_ms == 0
+            && entry.values.size() == gauge_values.size();
+    // second round only if some time series expired since the last sample
+    for (int round = 0; round < 2; ++round) {
+        if (!resolved) {
+            changed_only = false;
+            entry.layout = gauge_layout;
+            entry.batch.Clear();
+            for (int i = 0; i < gauge_labels.size(); ++i) {
+                Family<ColumnarGauge>* family = 
+                        boost::get<Family<ColumnarGauge>*>(
+                                metric_map[gauge_labels[i].first]);
+                const vector<Label>& labels = gauge_labels[i].second;
+                for (int j = 0; j < labels.size(); ++j) {
+                    entry.batch.Add(
+                            *family,
+                            family->Add(series_labels(labels[j], key_hash)));
+                }
+            }
+        }
+        size_t applied = changed_only 
+                ? entry.batch.SetChanged(
+                        gauge_values.data(), entry.values.data()) 
+                : entry.batch.Set(gauge_values, timestamp_ms);
+        if (applied == gauge_values.size()) {
+            break;
+        }
+        resolved = false;
+    }
+    entry.values = gauge_values;
+}
+
+void Mapper::expire_instances() {
+    for (map<string, std::shared_ptr<Aggregation>>::iterator agg = 
+                aggregations.begin();
+            agg != aggregations.end(); ++agg) {
+        agg->second->expire_instances();
+    }
+    if (!batch_expiry.BeginSweep()) {
+        return;
+    }
+    map<string, InstanceBatch>::iterator it = instance_batches.begin();
+    while (it != instance_batches.end()) {
+        if (!batch_expiry.IsStale(it->second.epoch)) {
+            ++it;
+            continue;
+        }
+        if (it->second.block != NULL) {
+            gauge_blocks->RemoveBlock(*(it->second.block));
+        }
+        instance_batches.erase(it++);
+    }
+    batch_expiry.EndSweep();
+}
+
+Label Mapper::series_labels(const Label& raw_labels, const string& key_hash) {
+    if (raw_labels.empty() || use_key_hash_label()) {
+        Label labels = raw_labels;
+        labels["Key_hash"] = key_hash;
+        return labels;
+    }
+    Label labels = raw_labels;
+    format_key_label(labels);
+    return labels;
+}
+
+/*
+*  Add the names of the labels of the values of NODE to NAMES
+*/
+static void collect_label_names(const PlanNode& node, set<LabelKey>& names) {
+    names.insert(node.key_paths.begin(), node.key_paths.end());
+    if (!node.index_label.empty()) {
+        names.insert(node.index_label);
+    }
+    if (node.element) {
+        collect_label_names(*(node.element), names);
+    }
+}
+
+set<LabelKey> Mapper::series_label_names(const MetricConfig& config) {
+    set<LabelKey> raw_names = {};
+    if (config.plan) {
+        collect_label_names(*(config.plan), raw_names);
+    }
+    if (raw_names.empty() || use_key_hash_label()) {
+        raw_names.insert("Key_hash");
+        return raw_names;
+    }
+    set<LabelKey> names = {};
+    for (set<LabelKey>::const_iterator it = raw_names.begin();
+            it != raw_names.end(); ++it) {
+        names.insert(data_path_to_label_name(*it));
+    }
+    return names;
+}
 //--- end Mapper ---------------------------------------------------------------
 //------------------------------------------------------------------------------
 
+//--- PathTrie -----------------------------------------------------------------
+PathTrie::PathTrie() : has_patterns (false) {
+    add_node(false);
+}
+
+int PathTrie::add_node(bool is_globstar) {
+    Node node;
+    node.star = -1;
+    node.globstar = -1;
+    node.is_globstar = is_globstar;
+    node.terminal = false;
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+void PathTrie::add(const DataPath& pattern) {
+    vector<string> members = {};
+    boost::split(members, pattern, [](char c){return c == '.';});
+    int current = 0;
+    for (int i = 0; i < members.size(); ++i) {
+        int next;
+        if (members[i] == "**") {
+            next = nodes[current].globstar;
+            if (next < 0) {
+                next = add_node(true);
+                nodes[current].globstar = next;
+            }
+        } else if (members[i] == "*") {
+            next = nodes[current].star;
+            if (next < 0) {
+                next = add_node(false);
+                nodes[current].star = next;
+            }
+        } else {
+            map<MemberName, int>::const_iterator it = 
+                    nodes[current].children.find(members[i]);
+            if (it == nodes[current].children.end()) {
+                next = add_node(false);
+                nodes[current].children[members[i]] = next;
+            } else {
+                next = it->second;
+            }
+        }
+        current = next;
+    }
+    nodes[current].terminal = true;
+    has_patterns = true;
+}
+
+bool PathTrie::empty() const {
+    return !has_patterns;
+}
+
+PathTrie::States PathTrie::start() const {
+    States states(1, 0);
+    close(states);
+    return states;
+}
+
+void PathTrie::close(States& states) const {
+    for (int i = 0; i < states.size(); ++i) {
+        int globstar = nodes[states[i]].globstar;
+        if (globstar >= 0 
+                && std::find(states.begin(), states.end(), globstar) 
+                        == states.end()) {
+            states.push_back(globstar);
+        }
+    }
+}
+
+PathTrie::States PathTrie::advance(
+        const States& states,
+        const MemberName& member) const {
+    States next = {};
+    for (int i = 0; i < states.size(); ++i) {
+        const Node& node = nodes[states[i]];
+        map<MemberName, int>::const_iterator it = node.children.find(member);
+        if (it != node.children.end()) {
+            next.push_back(it->second);
+        }
+        if (node.star >= 0) {
+            next.push_back(node.star);
+        }
+        if (node.is_globstar) {
+            // "**" also matches this member
+            next.push_back(states[i]);
+        }
+    }
+    std::sort(next.begin(), next.end());
+    next.erase(std::unique(next.begin(), next.end()), next.end());
+    close(next);
+    return next;
+}
+
+bool PathTrie::matches(const States& states) const {
+    for (int i = 0; i < states.size(); ++i) {
+        if (nodes[states[i]].terminal) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathTrie::matches(const DataPath& data_path) const {
+    vector<string> members;
+    boost::split(members, data_path, [](char c){return c == '.';});
+    States states = start();
+    for (int i = 0; i < members.size(); ++i) {
+        if (matches(states)) {
+            return true;
+        }
+        states = advance(states, members[i]);
+        if (states.empty()) {
+            return false;
+        }
+    }
+    return matches(states);
+}
+
+//------------------------------------------------------------------------------
+//---------Aggregation----------------------------------------------------------
+//------------------------------------------------------------------------------
+Aggregation::Aggregation(
+        const vector<LabelKey>& i_by, 
+        const vector<string>& i_functions) : 
+    by (i_by),
+    by_names (i_by),
+    by_steps (i_by.size()),
+    keep_values (false),
+    max_age (std::chrono::steady_clock::duration::zero()) {
+    for (int i = 0; i < i_functions.size(); ++i) {
+        if (!is_function(i_functions[i])) {
+            continue;
+        }
+        functions.push_back(i_functions[i]);
+        if (i_functions[i] == "min" || i_functions[i] == "max") {
+            keep_values = true;
+        }
+    }
+}
+
+bool Aggregation::is_function(const string& name) {
+    return name == "sum" || name == "avg" || name == "min" 
+            || name == "max" || name == "count";
+}
+
+bool Aggregation::resolve_by(
+        const set<LabelKey>& label_names,
+        const DynamicType* topic_type,
+        LabelKey& unknown) {
+    for (int i = 0; i < by.size(); ++i) {
+        if (label_names.count(by[i]) != 0) {
+            continue;
+        }
+        const DynamicType* member_type = topic_type;
+        vector<PathStep> steps = compile_steps(by[i], member_type);
+        while (member_type != NULL 
+                && member_type->kind().underlying() == TypeKind::ALIAS_TYPE) {
+            member_type = 
+                    &resolve_alias(static_cast<const AliasType&>(*member_type));
+        }
+        if (member_type == NULL 
+                || !(Mapper::is_primitive_kind(member_type->kind())
+                        || member_type->kind().underlying() 
+                                == TypeKind::STRING_TYPE
+                        || member_type->kind().underlying() 
+                                == TypeKind::WSTRING_TYPE)) {
+            unknown = by[i];
+            return false;
+        }
+        by_steps[i] = steps;
+        by_names[i] = Mapper::data_path_to_label_name(by[i]);
+    }
+    return true;
+}
+
+Label Aggregation::sample_labels(const DynamicData& data) const {
+    Label labels;
+    for (int i = 0; i < by_steps.size(); ++i) {
+        if (by_steps[i].empty()) {
+            continue;
+        }
+        vector<rti::core::xtypes::LoanedDynamicData> loans;
+        DynamicData* parent = descend(data, by_steps[i], loans);
+        if (parent != NULL) {
+            Mapper::get_key_labels(
+                    labels, *parent, by_steps[i].back().name, by_names[i]);
+        }
+    }
+    return labels;
+}
+
+bool Aggregation::same_rule(const Aggregation& other) const {
+    if (by != other.by || functions != other.functions) {
+        return false;
+    }
+    // an entry may have changed between label and member on reload
+    for (int i = 0; i < by.size(); ++i) {
+        if (by_steps[i].empty() != other.by_steps[i].empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Aggregation::register_families(
+        const MetricConfig& config, 
+        std::shared_ptr<Registry> registry,
+        std::chrono::steady_clock::duration max_age) {
+    if (!families.empty()) {
+        return;
+    }
+    this->max_age = max_age;
+    instance_expiry.SetMaxAge(max_age);
+    string by_labels = boost::algorithm::join(by, ", ");
+    for (int i = 0; i < functions.size(); ++i) {
+        Family<ColumnarGauge>* family = 
+                &(BuildColumnarGauge()
+                        .Name(config.name + "_" + functions[i])
+                        .Help(config.help + " (" + functions[i] 
+                                + " by " + by_labels + ")")
+                        .Register(*registry));
+        family->SetMaxAge(max_age);
+        hold_shared(family);
+        families.push_back(family);
+    }
+}
+
+Aggregation::~Aggregation() {
+    for (int i = 0; i < families.size(); ++i) {
+        release_shared(families[i]);
+    }
+}
+
+void Aggregation::remove_families(Registry& registry) {
+    for (int i = 0; i < families.size(); ++i) {
+        if (release_shared(families[i])) {
+            registry.Remove(*(families[i]));
+        }
+    }
+    families.clear();
+    groups.clear();
+    instances.clear();
+}
+
+void Aggregation::limit_families(
+        size_t max_series, 
+        std::shared_ptr<SeriesBudget> budget) {
+    for (int i = 0; i < families.size(); ++i) {
+        families[i]->SetMaxSeries(max_series);
+        families[i]->SetSeriesBudget(budget);
+    }
+}
+
+uint64_t Aggregation::rejected_count() const {
+    uint64_t count = 0;
+    for (int i = 0; i < families.size(); ++i) {
+        count += families[i]->RejectedCount();
+    }
+    return count;
+}
+
+void Aggregation::update(
+        const string& key_hash, 
+        const Label& labels, 
+        const Label& sample_labels,
+        double value) {
+    Label group_labels = group_of(labels, sample_labels);
+    Instance& instance = instances[key_hash];
+    instance.epoch = instance_expiry.Epoch();
+    map<Label, Contribution>& series = instance.series;
+    map<Label, Contribution>::iterator it = series.find(labels);
+    if (it != series.end() && it->second.group != group_labels) {
+        // a member grouped by changed, the series moves to its new group
+        leave(it->second.group, it->second.value);
+        series.erase(it);
+        it = series.end();
+    }
+
+    Group& group = groups[group_labels];
+    if (group.handles.empty()) {
+        group.sum = 0;
+        group.count = 0;
+        group.handles.resize(
+                functions.size(), Family<ColumnarGauge>::kInvalidHandle);
+    }
+    // unchanged groups still have to be touched to not expire
+    if (it != series.end() && it->second.value == value 
+            && max_age == std::chrono::steady_clock::duration::zero()) {
+        return;
+    }
+    if (it == series.end()) {
+        Contribution contribution;
+        contribution.value = value;
+        contribution.group = group_labels;
+        series[labels] = contribution;
+        ++group.count;
+    } else {
+        remove_value(group, it->second.value);
+        ++group.count;
+        it->second.value = value;
+    }
+    group.sum += value;
+    if (keep_values) {
+        group.values.insert(value);
+    }
+    publish(group_labels, group);
+}
+
+void Aggregation::remove_instance(const string& key_hash) {
+    map<string, Instance>::iterator instance = instances.find(key_hash);
+    if (instance == instances.end()) {
+        return;
+    }
+    for (map<Label, Contribution>::iterator it = 
+                instance->second.series.begin();
+            it != instance->second.series.end(); ++it) {
+        leave(it->second.group, it->second.value);
+    }
+    instances.erase(instance);
+}
+
+void Aggregation::leave(const Label& group_labels, double value) {
+    map<Label, Group>::iterator group = groups.find(group_labels);
+    if (group == groups.end()) {
+        return;
+    }
+    remove_value(group->second, value);
+    if (group->second.count > 0) {
+        publish(group_labels, group->second);
+        return;
+    }
+    // the last series of the group is gone
+    for (int i = 0; i < families.size(); ++i) {
+        families[i]->Remove(group->second.handles[i]);
+    }
+    groups.erase(group);
+}
+
+void Aggregation::expire_instances() {
+    if (!instance_expiry.BeginSweep()) {
+        return;
+    }
+    vector<string> stale = {};
+    for (map<string, Instance>::const_iterator it = instances.begin();
+            it != instances.end(); ++it) {
+        if (instance_expiry.IsStale(it->second.epoch)) {
+            stale.push_back(it->first);
+        }
+    }
+    // the groups of the stale instances are published without them
+    for (int i = 0; i < stale.size(); ++i) {
+        remove_instance(stale[i]);
+    }
+    instance_expiry.EndSweep();
+}
+
+Label Aggregation::group_of(
+        const Label& labels, 
+        const Label& sample_labels) const {
+    Label group_labels;
+    for (int i = 0; i < by.size(); ++i) {
+        const Label& source = by_steps[i].empty() ? labels : sample_labels;
+        Label::const_iterator it = source.find(by_names[i]);
+        if (it != source.end()) {
+            group_labels[by_names[i]] = it->second;
+        }
+    }
+    return group_labels;
+}
+
+void Aggregation::remove_value(Group& group, double value) {
+    --group.count;
+    // no rounding error left behind once the group is empty
+    group.sum = group.count == 0 ? 0 : group.sum - value;
+    if (keep_values) {
+        multiset<double>::iterator it = group.values.find(value);
+        if (it != group.values.end()) {
+            group.values.erase(it);
+        }
+    }
+}
+
+void Aggregation::publish(const Label& group_labels, Group& group) {
+    for (int i = 0; i < families.size(); ++i) {
+        double value;
+        if (functions[i] == "sum") {
+            value = group.sum;
+        } else if (functions[i] == "avg") {
+            value = group.sum / group.count;
+        } else if (functions[i] == "min") {
+            value = *(group.values.begin());
+        } else if (functions[i] == "max") {
+            value = *(group.values.rbegin());
+        } else {
+            value = group.count;
+        }
+        // the series expired or was never added
+        if (!families[i]->Set(group.handles[i], value)) {
+            group.handles[i] = families[i]->Add(group_labels);
+            families[i]->Set(group.handles[i], value);
+        }
+    }
+}
+//------------------------------------------------------------------------------
+
 //--- add_metric ---------------------------------------------------------------
 bool add_metric::operator()( Family<prometheus::Counter>* operand) const {
     try {
@@ -927,7 +2756,7 @@ bool add_metric::operator()( Family<prometheus::Counter>* operand) const {
         return false;
     }
 }
-bool add_metric::operator()( Family<prometheus::Gauge>* operand) const {
+bool add_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
     try {
         operand->Add(labels);
         return true;
@@ -965,10 +2794,9 @@ bool update_metric::operator()( Family<prometheus::Counter>* operand) const {
     }
 }
 
-bool update_metric::operator()( Family<prometheus::Gauge>* operand) const {
+bool update_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
     try {
-        prometheus::Gauge& gauge = operand->Add(labels);
-        gauge.Set(value);
+        operand->Set(operand->Add(labels), value, timestamp_ms);
         return true;
     } catch(const std::exception& e) {
         return false;
@@ -993,3 +2821,85 @@ bool update_metric::operator()( Family<prometheus::Histogram>* operand) const {
     }
 }
 
+//--- expire_metric ------------------------------------------------------------
+bool expire_metric::operator()( Family<prometheus::Counter>* operand) const {
+    operand->SetMaxAge(max_age);
+    return true;
+}
+bool expire_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
+    operand->SetMaxAge(max_age);
+    return true;
+}
+bool expire_metric::operator()( Family<prometheus::Summary>* operand) const {
+    operand->SetMaxAge(max_age);
+    return true;
+}
+bool expire_metric::operator()( Family<prometheus::Histogram>* operand) const {
+    operand->SetMaxAge(max_age);
+    return true;
+}
+
+//--- limit_metric -------------------------------------------------------------
+bool limit_metric::operator()( Family<prometheus::Counter>* operand) const {
+    operand->SetMaxSeries(max_series);
+    operand->SetSeriesBudget(budget);
+    return true;
+}
+bool limit_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
+    operand->SetMaxSeries(max_series);
+    operand->SetSeriesBudget(budget);
+    return true;
+}
+bool limit_metric::operator()( Family<prometheus::Summary>* operand) const {
+    operand->SetMaxSeries(max_series);
+    operand->SetSeriesBudget(budget);
+    return true;
+}
+bool limit_metric::operator()( Family<prometheus::Histogram>* operand) const {
+    operand->SetMaxSeries(max_series);
+    operand->SetSeriesBudget(budget);
+    return true;
+}
+
+//--- rejected_metric ----------------------------------------------------------
+uint64_t rejected_metric::operator()( Family<prometheus::Counter>* operand) const {
+    return operand->RejectedCount();
+}
+uint64_t rejected_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
+    return operand->RejectedCount();
+}
+uint64_t rejected_metric::operator()( Family<prometheus::Summary>* operand) const {
+    return operand->RejectedCount();
+}
+uint64_t rejected_metric::operator()( Family<prometheus::Histogram>* operand) const {
+    return operand->RejectedCount();
+}
+
+//--- size_metric --------------------------------------------------------------
+size_t size_metric::operator()( Family<prometheus::Counter>* operand) const {
+    return operand->Size();
+}
+size_t size_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
+    return operand->Size();
+}
+size_t size_metric::operator()( Family<prometheus::Summary>* operand) const {
+    return operand->Size();
+}
+size_t size_metric::operator()( Family<prometheus::Histogram>* operand) const {
+    return operand->Size();
+}
+
+//--- remove_metric ------------------------------------------------------------
+bool remove_metric::operator()( Family<prometheus::Counter>* operand) const {
+    return release_shared(operand) && registry->Remove(*operand);
+}
+bool remove_metric::operator()( Family<prometheus::ColumnarGauge>* operand) const {
+    return release_shared(operand) && registry->Remove(*operand);
+}
+bool remove_metric::operator()( Family<prometheus::Summary>* operand) const {
+    return release_shared(operand) && registry->Remove(*operand);
+}
+bool remove_metric::operator()( Family<prometheus::Histogram>* operand) const {
+    return release_shared(operand) && registry->Remove(*operand);
+}
+
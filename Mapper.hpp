@@ -8,8 +8,13 @@
 #ifndef MAPPER_HPP
 #define MAPPER_HPP
 
+#include <chrono>
+#include <ctime>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <dds/core/corefwd.hpp>
 
@@ -21,13 +26,17 @@
 #include <dds/sub/Sample.hpp>
 #include <dds/sub/SampleInfo.hpp>
 
+#include <prometheus/columnar_gauge.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/gauge_block.h>
 #include <prometheus/histogram.h>
 #include <prometheus/summary.h>
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
 #include <prometheus/metric_type.h>
+#include <prometheus/series_budget.h>
+#include <prometheus/detail/series_expiry.h>
 
 #include "yaml-cpp/yaml.h"
 
@@ -47,7 +56,7 @@ using namespace dds::core::xtypes;
 typedef boost::variant<
         boost::blank, 
         Family<Counter>*, 
-        Family<Gauge>*, 
+        Family<ColumnarGauge>*, 
         Family<Histogram>*, 
         Family<Summary>*> 
     Family_variant;
@@ -84,6 +93,118 @@ typedef string LabelKey;
 
 typedef map<LabelKey, DataPath> Label;
 
+/**
+ * Time series of all gauge metrics of one instance, resolved once and
+ * then published together for every following sample of that instance.
+ */
+struct InstanceBatch {
+    /**
+     * number of values each gauge metric of config_map produced 
+     * when the batch was resolved, in the order of config_map
+     */
+    vector<size_t> layout;
+
+    /**
+     * one entry per value, in the same order as the values
+     */
+    ColumnarGaugeBatch batch;
+
+    /**
+     * block of the instance if consistent_snapshots is enabled, 
+     * then used instead of batch
+     */
+    GaugeBlock* block = NULL;
+
+    /**
+     * values last published, a sample with the same values is skipped,
+     * of other samples only the changed values are set
+     */
+    vector<double> values;
+
+    /**
+     * epoch of Mapper::batch_expiry the instance last had a sample in
+     */
+    uint64_t epoch = 0;
+};
+
+/**
+ *   One member on the way from the data of a plan level to a value,
+ *   with how to tell whether it is present in a sample without throwing.
+ */
+struct PathStep {
+    enum Presence {
+        /** always present */
+        REQUIRED,
+        /** optional member, present if set */
+        OPTIONAL_MEMBER,
+        /** union member, present if the discriminator selects LABELS */
+        UNION_CASE,
+        /** type unknown at compile time, asked with member_exists */
+        UNCHECKED
+    };
+
+    MemberName name;
+    Presence presence;
+
+    /**
+     * discriminator values selecting this member if presence is UNION_CASE,
+     * empty for the default case
+     */
+    vector<int32_t> labels;
+};
+
+/**
+ *   Immutable step of extracting one metric from a sample, compiled once
+ *   from a MetricConfig. A node works on the data of one level: the whole
+ *   sample for the root, one element of a collection below that. It reads
+ *   the keys of its level, then either the value (leaf) or every element
+ *   of its collection with ELEMENT. Nodes are shared, never copied per sample.
+ */
+struct PlanNode {
+    /**
+     * data_path of keyed members from this level, also their label name
+     */
+    vector<DataPath> key_paths;
+
+    /**
+     * members on the way to each of KEY_PATHS
+     */
+    vector<vector<PathStep>> key_steps;
+
+    /**
+     * members from this level to COLLECTION, COLLECTION included, 
+     * or to the value of a leaf
+     */
+    vector<PathStep> steps;
+
+    /**
+     * name of the array or sequence member, empty for a leaf
+     */
+    MemberName collection;
+
+    /**
+     * label name of the element index of COLLECTION
+     */
+    LabelKey index_label;
+
+    /**
+     * elements of COLLECTION are primitives read with one get_values call
+     */
+    bool bulk;
+
+    /**
+     * type of the value
+     */
+    TypeKind data_type;
+
+    /**
+     * applied to every element of COLLECTION unless BULK
+     */
+    std::shared_ptr<const PlanNode> element;
+};
+
+typedef std::shared_ptr<const PlanNode> PlanPtr;
+
 /**
  *   Represent a YAML Node contains all nessesary information to 
  *   construct Family metrics with.
@@ -125,6 +246,22 @@ struct MetricConfig {
      */
     std::map<MemberName, DataPath> collection_map;
 
+    /**
+     * extraction plan compiled from the members above by configure
+     */
+    PlanPtr plan;
+
+    /**
+     * max number of time series, 0 to use yaml max_series_per_metric
+     */
+    size_t max_series;
+
+    /**
+     * unit of the metric, e.g. seconds, exposed in OpenMetrics only.
+     * The name has to end with it. Set by yaml unit, empty by default
+     */
+    std::string unit;
+
     /**
      * @param I_NAME name of this metric
      * @param I_HELP helpful description of this family
@@ -150,6 +287,293 @@ struct MetricConfig {
     ~MetricConfig();
 };      
 
+/**
+ * Data path globs compiled into a trie. Members are separated by ".",
+ * "*" matches one member name and "**" any number of them, 
+ * e.g. process.*.sec or **.guid. A pattern matches from the top of the type.
+ * The trie is walked one member at a time alongside the type, so the
+ * cost per member does not depend on the number of patterns.
+ */
+class PathTrie {
+public:
+    /**
+     * trie nodes reached by the members walked so far
+     */
+    typedef vector<int> States;
+
+    PathTrie();
+
+    /**
+     * @param DataPath glob to be added
+     */
+    void add(const DataPath& pattern);
+
+    /**
+     * @return true if no pattern was added
+     */
+    bool empty() const;
+
+    /**
+     * @return states before the first member
+     */
+    States start() const;
+
+    /**
+     * @param States states of the parent
+     * @param MemberName name of the member walked into
+     * @return states of the member, empty if no pattern can match 
+     *         the member or anything inside of it
+     */
+    States advance(const States& states, const MemberName& member) const;
+
+    /**
+     * @param States states of a member
+     * @return true if a pattern matches the member (and so its subtree)
+     */
+    bool matches(const States& states) const;
+
+    /**
+     * @param DataPath members separated by "."
+     * @return true if a pattern matches the member at DATA_PATH 
+     *         or one of the members on the way to it
+     */
+    bool matches(const DataPath& data_path) const;
+
+private:
+    struct Node {
+        map<MemberName, int> children;
+        int star;
+        int globstar;
+        bool is_globstar;
+        bool terminal;
+    };
+
+    int add_node(bool is_globstar);
+
+    /**
+     * add the nodes reachable by "**" matching no member
+     */
+    void close(States& states) const;
+
+    vector<Node> nodes;
+    bool has_patterns;
+};
+
+/**
+ * Entry of the yaml aggregate section: gauge metrics whose data_path 
+ * matches PATTERN are exported combined across instances.
+ */
+struct AggregateRule {
+    PathTrie pattern;
+
+    /**
+     * labels kept, series with the same values of these are combined.
+     * An entry that is not a label of the series is the data path of 
+     * a primitive or string member of the sample, e.g. a host name
+     */
+    vector<LabelKey> by;
+
+    /**
+     * any of sum, avg, min, max and count
+     */
+    vector<string> functions;
+};
+
+/**
+ * Series of one gauge metric combined into groups by an AggregateRule.
+ * Instead of a series per instance, only one series per group and 
+ * function is exported, e.g. <name>_sum{topic="A"}.
+ * The last value of every series is kept, so a new sample only applies
+ * the difference to its group. min and max keep the values of a group 
+ * sorted to support removal of an instance.
+ */
+class Aggregation {
+public:
+    /**
+     * @param vector<LabelKey> labels or data paths to group by
+     * @param vector<string> functions to export, unknown ones are ignored
+     */
+    Aggregation(const vector<LabelKey>& by, const vector<string>& functions);
+
+    /**
+     * The families stay registered, see remove_families
+     */
+    ~Aggregation();
+
+    /**
+     * Tell the entries of BY that are data paths of members from labels
+     * 
+     * @param set<LabelKey> names of the labels of the aggregated series
+     * @param DynamicType type of the samples
+     * @param LabelKey set to the first entry of BY that is neither
+     * @return false if an entry is neither a label nor a primitive or
+     *         string member, the aggregation must not be used then
+     */
+    bool resolve_by(
+            const set<LabelKey>& label_names,
+            const DynamicType* topic_type,
+            LabelKey& unknown);
+
+    /**
+     * @param DynamicData sample of an instance
+     * @return values of the members grouped by, see resolve_by
+     */
+    Label sample_labels(const DynamicData& data) const;
+
+    /**
+     * @return true if OTHER groups and exports the same way
+     */
+    bool same_rule(const Aggregation& other) const;
+
+    /**
+     * Register a family <name>_<function> for each function, 
+     * nothing if registered already
+     * 
+     * @param MetricConfig metric being aggregated
+     * @param shared_ptr<Registry> registry for the families
+     * @param duration series_max_age of the Mapper
+     */
+    void register_families(
+            const MetricConfig& config, 
+            std::shared_ptr<Registry> registry,
+            std::chrono::steady_clock::duration max_age);
+
+    /**
+     * Remove the families from REGISTRY, except those another Mapper
+     * sharing the registry still uses
+     */
+    void remove_families(Registry& registry);
+
+    /**
+     * Limit the number of groups of each family, see limit_metric
+     */
+    void limit_families(
+            size_t max_series, 
+            std::shared_ptr<SeriesBudget> budget);
+
+    /**
+     * @return number of groups folded into the overflow series
+     *         of all families
+     */
+    uint64_t rejected_count() const;
+
+    /**
+     * Set the value of one series of an instance and update its group
+     * 
+     * @param string instance handle of the sample
+     * @param Label labels of the series as exported without aggregation
+     * @param Label sample_labels of the sample
+     * @param double new value of the series
+     */
+    void update(
+            const string& key_hash, 
+            const Label& labels, 
+            const Label& sample_labels,
+            double value);
+
+    /**
+     * Remove all series of an instance from their groups
+     * 
+     * @param string instance handle of a disposed instance
+     */
+    void remove_instance(const string& key_hash);
+
+    /**
+     * Remove the series of instances without an update for the max age
+     * of register_families from their groups, like remove_instance.
+     * Does nothing without a max age
+     */
+    void expire_instances();
+
+    /**
+     * @param string name of a function
+     * @return true if it is one of sum, avg, min, max and count
+     */
+    static bool is_function(const string& name);
+
+private:
+    struct Group {
+        double sum;
+        size_t count;
+        /**
+         * values of all series, only if min or max are exported
+         */
+        multiset<double> values;
+        /**
+         * exported series, one per function
+         */
+        vector<Family<ColumnarGauge>::Handle> handles;
+    };
+
+    Label group_of(const Label& labels, const Label& sample_labels) const;
+
+    void publish(const Label& group_labels, Group& group);
+
+    void remove_value(Group& group, double value);
+
+    /**
+     * Remove VALUE from the group of GROUP_LABELS, the group is removed
+     * with its series once empty
+     */
+    void leave(const Label& group_labels, double value);
+
+    /**
+     * Last value of a series and the group it is counted in
+     */
+    struct Contribution {
+        double value;
+        Label group;
+    };
+
+    /**
+     * An instance with each of its series by their labels
+     */
+    struct Instance {
+        map<Label, Contribution> series;
+        uint64_t epoch;
+    };
+
+    vector<LabelKey> by;
+
+    /**
+     * label of each entry of BY in the groups, 
+     * BY converted to a label name for data paths
+     */
+    vector<LabelKey> by_names;
+
+    /**
+     * steps to the member of each entry of BY, empty for labels
+     */
+    vector<vector<PathStep>> by_steps;
+    vector<string> functions;
+    bool keep_values;
+
+    /**
+     * series_max_age of the families
+     */
+    std::chrono::steady_clock::duration max_age;
+
+    /**
+     * one family per function, empty until register_families
+     */
+    vector<Family<ColumnarGauge>*> families;
+
+    /**
+     * KEY: values of the labels in BY
+     */
+    map<Label, Group> groups;
+
+    /*
+    * KEY: instance handle
+    */
+    map<string, Instance> instances;
+
+    /**
+     * sweeps instances with max_age, see expire_instances
+     */
+    prometheus::detail::SeriesExpiry instance_expiry;
+};
+
 /**
  * This class handle all mapping behavior of DDS-to-prometheus
  */
@@ -167,6 +591,49 @@ public:
 
     ~Mapper();
 
+    /**
+     * Load a mapping without exiting on errors, e.g. to reload it 
+     * while the route is running
+     * 
+     * @param Filename as path to .yml file which specify how to make metrics
+     * @return the new Mapper, NULL if the file is missing or invalid
+     */
+    static std::shared_ptr<Mapper> load(Filename config_file);
+
+    /**
+     * @param Filename .yml file as given to the constructor
+     * @return path of the file relative to the build dir
+     */
+    static Filename config_path(Filename config_file);
+
+    /**
+     * @param Filename .yml file as given to the constructor
+     * @return last modification time of the file, 0 if it cannot be read
+     */
+    static time_t modification_time(Filename config_file);
+
+    /**
+     * Find the metrics of the topic TYPE: the user specified ones, 
+     * then auto_map if enabled. Their plans are compiled as well,
+     * so the Mapper is ready for register_metrics.
+     * 
+     * @param DynamicType type of topic input
+     */
+    void configure(const DynamicType& type);
+
+    /**
+     * Register the metrics of this Mapper in place of those of PREVIOUS, 
+     * which stops being used afterwards. Families of metrics no longer 
+     * mapped, or mapped with another type or description, are removed 
+     * from REGISTRY. Unchanged families are kept with their time series.
+     * 
+     * @param Mapper mapper currently in use, configured for the same topic
+     * @param shared_ptr<Registry> registry PREVIOUS registered to
+     * @return false if this Mapper cannot take over, e.g. because 
+     *         consistent_snapshots differs. Nothing is changed then
+     */
+    bool replace(Mapper& previous, std::shared_ptr<Registry> registry);
+
     /**
      * Find keyed members and collection type members in the TYPE
      * CONFIG must be that of user specified metrics
@@ -188,6 +655,8 @@ public:
 
     /**
      *  Auto map all primative members of TYPE
+     *  The result is computed once per process for the same type and
+     *  options, later calls reuse it including the compiled plans.
      * 
      *  @param DynamicType topic type that will metrics will be created from
      *  @param MetricConfig will contain results of auto mapping.
@@ -196,6 +665,19 @@ public:
      */
     void auto_map(const DynamicType& type, MetricConfig config);
 
+    /**
+     *  Walk TYPE iteratively and collect a MetricConfig for every 
+     *  mappable primitive member, as auto_map does without caching
+     * 
+     *  @param DynamicType topic type that will metrics will be created from
+     *  @param MetricConfig name and data_path prefix of the results 
+     *  @param vector<MetricConfig> results are appended to it
+     */
+    void auto_map_leaves(
+            const DynamicType& type,
+            const MetricConfig& config,
+            vector<MetricConfig>& leaves);
+
     /** 
      *  Mapper will create a /metric based on config FILENAME 
      *  Then register it to the one and only REGISTRY 
@@ -215,6 +697,39 @@ public:
      */
     int update_metrics(const DynamicData&, const dds::sub::SampleInfo&);
 
+    /**
+     *  Record one call of on_data_available if yaml self_metrics is on
+     * 
+     * @param duration time from take() until all samples were mapped
+     * @param size_t number of samples taken
+     */
+    void report_batch(
+            std::chrono::steady_clock::duration duration, 
+            size_t samples);
+
+    /**
+     *  Update the gauges of time series per family and of cached plans
+     *  if yaml self_metrics is on. They change slowly, so this is called 
+     *  from on_periodic_action instead of for every sample
+     */
+    void report_self_metrics();
+
+    /**
+     *  Add label sets newly folded into overflow series to 
+     *  series_rejected_total if any metric limits its series. This walks
+     *  all families, so it is called from on_periodic_action
+     */
+    void report_rejected_series();
+
+    /**
+     *  Drop the gauge batches, and blocks if consistent_snapshots is on,
+     *  and the aggregated values of instances without a sample for yaml
+     *  series_max_age. Instances that vanish without a dispose would
+     *  otherwise keep them forever.
+     *  Called from on_periodic_action, does nothing without a max age
+     */
+    void expire_instances();
+
     /**
      * @return true if yaml enable_auto_map is true, false otherwise
      */ 
@@ -225,6 +740,12 @@ public:
      */
     bool use_key_hash_label();
 
+    /**
+     * @return gauge metrics to be exposed next to the registry 
+     *         if yaml consistent_snapshots is true, NULL otherwise
+     */
+    std::shared_ptr<GaugeBlockGroup> consistent_gauges();
+
     /**
      * Untility function to convert DataPath to labelKey
      * 
@@ -265,6 +786,22 @@ public:
             DataPath data_path,
             TypeKind type_kind); 
     
+    /**
+     *  Utility function to retrive all elements of a collection of 
+     *  primitives with one contiguous read and append them to VARS.
+     * 
+     * @param vector<double> values of the elements are appended to it
+     * @param DynamicData data containing the collection member
+     * @param MemberName name of the array or sequence member in DATA
+     * @param TypeKind TypeKind of the elements
+     * @return number of values appended
+     */
+    static size_t get_collection_values(
+            vector<double>& vars,
+            const DynamicData& data,
+            MemberName member_name,
+            TypeKind element_kind);
+
     /**
      *  Utility function to determine if KIND is one of primitive kinds
      * 
@@ -274,19 +811,20 @@ public:
     static bool is_primitive_kind(TypeKind kind);
 
     /**
-     *  Utility function to retrive string representation of keyed
-     *  members point to bt path
+     *  Utility function to retrive string representation of a keyed
+     *  member, members of a struct, union or collection are added each.
+     *  The member must be present in DATA, see the key_steps of the plan.
      * 
      *  @param Label label that will contain the results key map
-     *  @param DynamicData data from topic sample
-     *  @param DataPath path lead to the keyed member
-     *  @return map with each keys equals data_path to a keyed member and
-     *          each values equals to value of a keyed member 
+     *  @param DynamicData data containing the keyed member
+     *  @param MemberName name of the keyed member in DATA
+     *  @param DataPath name of the label, members inside are appended
      */
     static void get_key_labels(
             Label& key_label,
             const DynamicData& data,
-            DataPath data_path);
+            const MemberName& member_name,
+            const DataPath& label_name);
 
     /**
      *  Utility function to get value(s) and label(s) to update a metric
@@ -296,14 +834,69 @@ public:
      *              if there is a list in path to the member, vars will contain 
      *  @param DynamicData data from topic sample
      *  @param MetricConfig contain all the information need about a metric
+     *  @return number of values skipped because their member was absent,
+     *          e.g. an optional member not set or a union case not selected
      */
-    static void get_data(
+    static size_t get_data(
             vector<Label> &set_labels,
             vector<double> &vars,
             const DynamicData& data,
-            MetricConfig config);
+            const MetricConfig& config);
+
+    /**
+     *  Utility function to compile the extraction plan of a metric
+     *  
+     *  @param MetricConfig metric with its key_map and collection_map found
+     *  @param DynamicType type of the topic, used to resolve up front 
+     *         how the presence of each member is checked. 
+     *         NULL to check all members with member_exists
+     *  @return root node of the plan
+     */
+    static PlanPtr compile_plan(
+            const MetricConfig& config, 
+            const DynamicType* topic_type = NULL);
+
+    /**
+     *  Utility function to walk DATA along a plan without copying DATA.
+     *  Collections are traversed with loaned members.
+     *  
+     *  @param PlanNode node of the level of DATA
+     *  @param DynamicData data of that level
+     *  @param Label labels from the levels above
+     *  @param vector<Label> a label for each value found is appended
+     *  @param vector<double> values found are appended
+     *  @return number of values skipped because their member was absent
+     */
+    static size_t extract(
+            const PlanNode& node,
+            const DynamicData& data,
+            const Label& labels,
+            vector<Label> &set_labels,
+            vector<double> &vars);
 private:
 
+    /*
+    * Mapper without any configuration, filled by parse
+    */
+    Mapper();
+
+    /**
+    * Read and parse the .yml file CONFIG_FILE, remembering its content hash
+    * 
+    * @param Filename as path to .yml file which specify how to make metrics
+    * @return root node of the file
+    * @throw YAML::Exception if the file is missing or not valid yaml
+    */
+    YAML::Node read_config(Filename config_file);
+
+    /**
+    * Read the mapping options and user specified metrics of CONFIG 
+    * 
+    * @param YAML::Node content of the .yml file
+    * @throw YAML::Exception if a key-value pair is in the wrong format
+    */
+    void parse(const YAML::Node& config);
+
     /*
     * Indicator to determine if auto map is to be done.
     */
@@ -314,6 +907,125 @@ private:
     */
     bool use_key_hash;
 
+    /*
+    * Indicator to determine if auto_map results are kept in a file 
+    * next to the yaml file. Set by yaml plan_cache, true by default
+    */
+    bool use_plan_cache;
+
+    /*
+    * yaml file as given to the constructor, empty if unknown
+    */
+    Filename config_file;
+
+    /*
+    * hash of the content of the yaml file, part of the plan cache key
+    */
+    size_t config_hash;
+
+    /*
+    * Time series not updated for this long are dropped at scrape time.
+    * Zero keeps them forever. Set by yaml series_max_age (seconds)
+    */
+    std::chrono::steady_clock::duration series_max_age;
+
+    /*
+    * Indicator to determine if gauge values are exposed with the 
+    * source_timestamp of their sample instead of the scrape time.
+    * Set by yaml source_timestamps, false by default
+    */
+    bool use_source_timestamps;
+
+    /*
+    * Time series of a metric beyond this number are folded into one
+    * {overflow="true"} series. Zero for no limit. 
+    * Set by yaml max_series_per_metric
+    */
+    size_t max_series_per_metric;
+
+    /*
+    * Shared by all metrics of the mapping, bounds the total number of 
+    * their time series. NULL for no limit. Set by yaml max_series_total
+    */
+    std::shared_ptr<SeriesBudget> series_budget;
+
+    /*
+    * true if a metric has a limit on time series, set by register_metrics
+    */
+    bool limiting_series;
+
+    /*
+    * KEY: name of a metric
+    * VALUE: label sets folded into its overflow series already 
+    *   counted in series_rejected_total
+    */
+    map<string, uint64_t> rejected_seen;
+
+    /*
+    * Indicator to determine if the processor exports metrics about 
+    * itself, see register_self_metrics. Set by yaml self_metrics, 
+    * false by default
+    */
+    bool use_self_metrics;
+
+    /*
+    * The update of every metric is timed for one sample out of this many,
+    * 0 never. Set by yaml self_metrics_sample_every, 0 by default
+    */
+    size_t metric_timing_every;
+
+    /*
+    * samples mapped since the updates of the metrics were timed last
+    */
+    size_t samples_since_timing;
+
+    /*
+    * self metrics registered by register_self_metrics, NULL if disabled
+    */
+    Histogram* batch_duration;
+    Histogram* batch_samples;
+    Histogram* sample_duration;
+    Family<Histogram>* update_duration_family;
+    Family<ColumnarGauge>* family_series;
+    Family<ColumnarGauge>* cached_plans;
+
+    /*
+    * KEY: name of a metric
+    * VALUE: its series of update_duration_family, 
+    *   empty if metric_timing_every is 0
+    */
+    map<string, Histogram*> update_durations;
+
+    /*
+    * KEY: name of a family of metric_map
+    * VALUE: its series of family_series
+    */
+    map<string, Family<ColumnarGauge>::Handle> family_series_handles;
+
+    /*
+    * Gauge metrics of config_map if yaml consistent_snapshots is true.
+    * All gauge values of one sample become visible to a scrape at once.
+    * NULL if disabled, gauges are then kept in the registry
+    */
+    std::shared_ptr<GaugeBlockGroup> gauge_blocks;
+
+    /*
+    * type of the input topic, set by config_user_specify_metrics
+    */
+    std::shared_ptr<DynamicType> topic_type;
+
+    /*
+    * KEY: name of a metric
+    * VALUE: counter of its values skipped because the member was absent
+    */
+    map<string, Counter*> skipped_counters;
+
+    /*
+    * KEY: name of a gauge metric in gauge_blocks
+    * VALUE: index of its family in gauge_blocks
+    */
+    map<string, size_t> block_families;
+
     /*
     * DDS topic hierarchy name with :: separated each level 
     */ 
@@ -336,10 +1048,33 @@ private:
     * from another. This list is user specify.
     */
     vector<DataPath> instance_identifiers;
+
+    // steps to each of instance_identifiers, compiled in configure()
+    vector<vector<PathStep>> instance_steps;
     
     // keep members that will be ignore from mapping process
     vector<DataPath> ignore_list; 
 
+    // if not empty only members matching one of these are auto mapped
+    vector<DataPath> include_list;
+
+    /*
+    * ignore_list and include_list compiled once for auto_map
+    */
+    PathTrie ignore_rules;
+    PathTrie include_rules;
+
+    /*
+    * yaml aggregate section, the first matching rule applies
+    */
+    vector<AggregateRule> aggregate_rules;
+
+    /*
+    * KEY: name of a metric of config_map exported aggregated
+    * VALUE: its groups, kept across reloads if the rule did not change
+    */
+    map<string, std::shared_ptr<Aggregation>> aggregations;
+
     /*
     * Map that keeps track of configuration 
     * for easy access and keep YAML file abstract 
@@ -348,6 +1083,62 @@ private:
     */
     map<string, MetricConfig*> config_map;
 
+    /*
+    * Pre-resolved gauge time series of each instance
+    * KEY: instance handle of the instance
+    * Rebuilt when the number of values of a sample changes or when
+    * one of its time series was removed (e.g. expired)
+    */
+    map<string, InstanceBatch> instance_batches;
+
+    /*
+    * sweeps instance_batches with series_max_age, see expire_instances
+    */
+    prometheus::detail::SeriesExpiry batch_expiry;
+
+    /**
+    * Label of the time series for value with RAW_LABELS 
+    * as returned by get_data
+    * 
+    * @param Label labels of one value returned by get_data
+    * @param string instance handle of the sample
+    * @return labels used for the time series in prometheus
+    */
+    Label series_labels(const Label& raw_labels, const string& key_hash);
+
+    /**
+    * @param MetricConfig a metric with its plan compiled
+    * @return names of all labels series_labels can return for the metric
+    */
+    set<LabelKey> series_label_names(const MetricConfig& config);
+
+    /**
+    * Set all gauge values of one sample through the instance's batch,
+    * resolving the batch again if it does not match the sample anymore
+    * 
+    * @param string instance handle of the sample
+    * @param vector<double> values of all gauge metrics, in config_map order
+    * @param vector<size_t> number of values of each gauge metric
+    * @param vector labels of each value as returned by get_data, 
+    *        used only to resolve the batch
+    * @param int64_t source timestamp of the sample in milliseconds,
+    *        0 to expose the values at scrape time
+    */
+    void publish_gauges(
+            const string& key_hash,
+            const vector<double>& gauge_values,
+            const vector<size_t>& gauge_layout,
+            const vector<pair<MetricName, vector<Label>>>& gauge_labels,
+            int64_t timestamp_ms);
+
+    /**
+    * Register the histograms and gauges about the processor itself 
+    * to REGISTRY if yaml self_metrics is on
+    * 
+    * @param shared_ptr<Registry> registry for the metrics
+    */
+    void register_self_metrics(std::shared_ptr<Registry> registry);
+
     /**
     * Create and register a family of METRIC_TYPE with name NAME,
     * helpful description of DETAIL, starter labels LABELS, and 
@@ -358,13 +1149,15 @@ private:
     * @param string helpful description of what this metric represents
     * @param Label starting label for this metric
     * @param shared_ptr<Registry> registry for this metric 
+    * @param string unit of this metric, empty if none
     */ 
     Family_variant create_metric(
             MetricType type,
             MetricName name, 
             string detail, 
             const Label& labels,
-            shared_ptr<Registry> registry);
+            shared_ptr<Registry> registry,
+            const string& unit = "");
     
     /**
      * @param MetricConfig contain metric info to created metric based on
@@ -381,7 +1174,7 @@ private:
 class add_metric: public boost::static_visitor<bool> {
 public:
     bool operator()( Family<prometheus::Counter>* operand) const;
-    bool operator()( Family<prometheus::Gauge>* operand) const;
+    bool operator()( Family<prometheus::ColumnarGauge>* operand) const;
     bool operator()( Family<prometheus::Summary>* operand) const;
     bool operator()( Family<prometheus::Histogram>* operand) const;
     bool operator()( boost::blank operand) const
@@ -396,14 +1189,104 @@ public:
 class update_metric: public boost::static_visitor<bool> {
 public:
     bool operator()( Family<prometheus::Counter>* operand) const;
-    bool operator()( Family<prometheus::Gauge>* operand) const;
+    bool operator()( Family<prometheus::ColumnarGauge>* operand) const;
     bool operator()( Family<prometheus::Summary>* operand) const;
     bool operator()( Family<prometheus::Histogram>* operand) const;
     bool operator()( boost::blank operand) const
     { return false;}
     Label labels;
     double value;
+    // source timestamp of VALUE in milliseconds, 0 for none
+    int64_t timestamp_ms = 0;
+};
+
+
+/**
+ * visitor to Family_variant that drops time series of a family
+ * which have not been updated within MAX_AGE
+ */
+class expire_metric: public boost::static_visitor<bool> {
+public:
+    bool operator()( Family<prometheus::Counter>* operand) const;
+    bool operator()( Family<prometheus::ColumnarGauge>* operand) const;
+    bool operator()( Family<prometheus::Summary>* operand) const;
+    bool operator()( Family<prometheus::Histogram>* operand) const;
+    bool operator()( boost::blank operand) const
+    { return false;}
+    std::chrono::steady_clock::duration max_age;
+};
+
+/**
+ * visitor to Family_variant that limits the number of time series 
+ * of a family to MAX_SERIES (0 for no limit) and to what is left
+ * of BUDGET (NULL for no budget)
+ */
+class limit_metric: public boost::static_visitor<bool> {
+public:
+    bool operator()( Family<prometheus::Counter>* operand) const;
+    bool operator()( Family<prometheus::ColumnarGauge>* operand) const;
+    bool operator()( Family<prometheus::Summary>* operand) const;
+    bool operator()( Family<prometheus::Histogram>* operand) const;
+    bool operator()( boost::blank operand) const
+    { return false;}
+    size_t max_series;
+    std::shared_ptr<SeriesBudget> budget;
 };
 
+/**
+ * visitor to Family_variant that returns the number of label sets
+ * folded into the overflow series of a family
+ */
+class rejected_metric: public boost::static_visitor<uint64_t> {
+public:
+    uint64_t operator()( Family<prometheus::Counter>* operand) const;
+    uint64_t operator()( Family<prometheus::ColumnarGauge>* operand) const;
+    uint64_t operator()( Family<prometheus::Summary>* operand) const;
+    uint64_t operator()( Family<prometheus::Histogram>* operand) const;
+    uint64_t operator()( boost::blank operand) const
+    { return 0;}
+};
+
+/**
+ * visitor to Family_variant that returns the number of time series
+ * of a family
+ */
+class size_metric: public boost::static_visitor<size_t> {
+public:
+    size_t operator()( Family<prometheus::Counter>* operand) const;
+    size_t operator()( Family<prometheus::ColumnarGauge>* operand) const;
+    size_t operator()( Family<prometheus::Summary>* operand) const;
+    size_t operator()( Family<prometheus::Histogram>* operand) const;
+    size_t operator()( boost::blank operand) const
+    { return 0;}
+};
+
+/**
+ * visitor to Family_variant that returns the address of the family,
+ * NULL for boost::blank
+ */
+class address_metric: public boost::static_visitor<const void*> {
+public:
+    template <typename T>
+    const void* operator()( T* operand) const
+    { return operand; }
+    const void* operator()( boost::blank operand) const
+    { return NULL; }
+};
+
+/**
+ * visitor to Family_variant that removes a family from REGISTRY once
+ * no other Mapper sharing the registry uses it
+ */
+class remove_metric: public boost::static_visitor<bool> {
+public:
+    bool operator()( Family<prometheus::Counter>* operand) const;
+    bool operator()( Family<prometheus::ColumnarGauge>* operand) const;
+    bool operator()( Family<prometheus::Summary>* operand) const;
+    bool operator()( Family<prometheus::Histogram>* operand) const;
+    bool operator()( boost::blank operand) const
+    { return false;}
+    Registry* registry;
+};
 
 #endif
\ No newline at end of file
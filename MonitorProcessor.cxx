@@ -14,6 +14,7 @@
 #include <stdlib.h>
 
 #include <chrono>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -28,6 +29,8 @@
 
 #include <prometheus/counter.h>
 #include <prometheus/exposer.h>
+#include <prometheus/gateway.h>
+#include <prometheus/periodic_pusher.h>
 #include <prometheus/registry.h>
 
 #include "yaml-cpp/yaml.h"
@@ -49,6 +52,7 @@ using namespace prometheus;
  * --- MonitorExposer ---------------------------------------------------------
  */
 const std::string DEFAULT_ADDRESS = "127.0.0.1:8080";
+const std::string MIN_UPDATE_INTERVAL_PROPERTY = "min_update_interval_ms";
 
 /* 
 *  initalize all the family and metrics 
@@ -56,14 +60,23 @@ const std::string DEFAULT_ADDRESS = "127.0.0.1:8080";
 */
 MonitorExposer::MonitorExposer(
         std::string input_filename, 
-        prometheus::Exposer& input_exposer,
-        std::shared_ptr<prometheus::Registry> input_registry) : 
-    mapper (Mapper(input_filename)),
+        prometheus::Exposer* input_exposer,
+        prometheus::Gateway* input_gateway,
+        std::shared_ptr<prometheus::Registry> input_registry,
+        std::chrono::milliseconds input_min_update_interval) : 
+    mapper (std::make_shared<Mapper>(input_filename)),
+    min_update_interval (input_min_update_interval),
     exposer (input_exposer),
+    gateway (input_gateway),
     registry (input_registry) {
         filename = input_filename;
+        config_mtime = Mapper::modification_time(filename);
         std::cout << "MonitorExposer(Processor) is created" << '\n';
         std::cout << "with mapping filename: " << filename << '\n'; 
+        if (min_update_interval.count() > 0) {
+            std::cout << "min update interval per instance: ";
+            std::cout << min_update_interval.count() << " ms" << '\n';
+        }
         std::cout << "____________________________________" << '\n';
 }
 
@@ -85,46 +98,139 @@ void MonitorExposer::on_input_enabled(
     std::cout << "topic_type of " << topic_type->name() << endl;
     std::cout << "____________________________________" << '\n';
 
-    mapper.config_user_specify_metrics(*topic_type);    
-    if (mapper.is_auto_mapping()) {
-        string name = topic_type->name();
-        name = boost::replace_all_copy(name, "::", "_");
-        name.append("_");
-        MetricConfig metric_config(name, "");
-        //DEBUG
-        std::cout << "Before auto_map" << endl;
-        mapper.auto_map(*topic_type, metric_config);
-        //DEBUG
-        std::cout << "Auto_map success" << endl << endl;
-    } 
+    this->topic_type = std::make_shared<DynamicType>(*topic_type);
+    mapper->configure(*topic_type);
     std::cout << "register metrics...." << endl;
-    mapper.register_metrics(registry);
+    mapper->register_metrics(registry);
     std::cout << "register completed!" << endl;
-    exposer.RegisterCollectable(registry);
+    if (exposer) {
+        exposer->RegisterCollectable(registry);
+        if (mapper->consistent_gauges()) {
+            exposer->RegisterCollectable(mapper->consistent_gauges());
+        }
+    }
+    // the registry is pushed by the plugin already
+    if (gateway && mapper->consistent_gauges()) {
+        gateway->RegisterCollectable(mapper->consistent_gauges());
+    }
     std::cout << "on_input_enable done" << endl << endl;;
 }
 
 void MonitorExposer::on_data_available(rti::routing::processor::Route &route) {
     std::cout << "MonitorExposer::on_data_available is called." << endl;
 
+    std::chrono::steady_clock::time_point start = 
+            std::chrono::steady_clock::now();
     // Split input shapes  into mono-dimensional output shapes
     auto input_samples = route.input<DynamicData>(0).take();
+    std::chrono::steady_clock::time_point now = 
+            std::chrono::steady_clock::now();
     for (auto sample : input_samples) {
-        if (sample.info().valid()) { 
-            // output_data_ = sample.data();
-            // mapper.updateMetrics((output_data_.get()));
-            mapper.update_metrics(sample.data(), sample.info());
-        } else {
-            // output_data_ = sample.data();
-            // mapper.updateMetrics((output_data_.get()));
-            mapper.update_metrics(sample.data(), sample.info());
+        if (min_update_interval.count() == 0) {
+            mapper->update_metrics(sample.data(), sample.info());
+            continue;
         }
+        dds::core::InstanceHandle handle = sample.info().instance_handle();
+        if (!sample.info().valid()) { 
+            // a dispose is never delayed, the pending sample is outdated
+            throttled.erase(handle);
+            mapper->update_metrics(sample.data(), sample.info());
+            continue;
+        }
+        std::map<dds::core::InstanceHandle, ThrottledInstance>::iterator it =
+                throttled.find(handle);
+        if (it != throttled.end() 
+                && now - it->second.last_update < min_update_interval) {
+            it->second.pending_data = sample.data();
+            it->second.pending_info = sample.info();
+            continue;
+        }
+        // the sample is newer than a pending one, which is dropped
+        ThrottledInstance& instance = throttled[handle];
+        instance.last_update = now;
+        instance.pending_data.reset();
+        instance.pending_info.reset();
+        mapper->update_metrics(sample.data(), sample.info());
     }
+    mapper->report_batch(
+            std::chrono::steady_clock::now() - start, 
+            input_samples.length());
     std::cout << "____________________________________" << '\n';
 }
 
+void MonitorExposer::flush_pending(std::chrono::steady_clock::time_point now) {
+    std::map<dds::core::InstanceHandle, ThrottledInstance>::iterator it = 
+            throttled.begin();
+    while (it != throttled.end()) {
+        ThrottledInstance& instance = it->second;
+        if (now - instance.last_update < min_update_interval) {
+            ++it;
+        } else if (instance.pending_data.is_set()) {
+            mapper->update_metrics(
+                    instance.pending_data.get(), 
+                    instance.pending_info.get());
+            instance.last_update = now;
+            instance.pending_data.reset();
+            instance.pending_info.reset();
+            ++it;
+        } else {
+            throttled.erase(it++);
+        }
+    }
+}
+
+/*
+*  Poll the yaml file and reload the mapping when it changed.
+*  The new Mapper is parsed and configured in the background, then 
+*  swapped in here. Callbacks of a route never run concurrently, so 
+*  on_data_available only ever sees a complete Mapper.
+*/
 void MonitorExposer::on_periodic_action(rti::routing::processor::Route &route) {
     std::cout << "on_periodic_action is called." << endl;
+    if (!topic_type) {
+        return;
+    }
+    flush_pending(std::chrono::steady_clock::now());
+    mapper->expire_instances();
+    mapper->report_rejected_series();
+    mapper->report_self_metrics();
+    if (pending_mapper.valid()) {
+        if (pending_mapper.wait_for(std::chrono::seconds(0)) 
+                != std::future_status::ready) {
+            return;
+        }
+        std::shared_ptr<Mapper> next = pending_mapper.get();
+        if (next && next->replace(*mapper, registry)) {
+            mapper = next;
+            std::cout << "reloaded mapping " << filename << endl;
+        }
+        return;
+    }
+
+    time_t mtime = Mapper::modification_time(filename);
+    if (mtime == config_mtime) {
+        return;
+    }
+    config_mtime = mtime;
+    std::cout << "mapping " << filename << " changed, reloading" << endl;
+    Filename file = filename;
+    std::shared_ptr<DynamicType> type = topic_type;
+    pending_mapper = std::async(
+            std::launch::async, 
+            [file, type]() -> std::shared_ptr<Mapper> {
+                std::shared_ptr<Mapper> next = Mapper::load(file);
+                if (!next) {
+                    return NULL;
+                }
+                try {
+                    next->configure(*type);
+                } catch (std::exception& e) {
+                    std::cout << "Cannot map " << file << ": ";
+                    std::cout << e.what() << endl;
+                    return NULL;
+                }
+                return next;
+            });
 }
 /*
  * --- MonitorProcessorPlugin --------------------------------------------------
@@ -132,13 +238,97 @@ void MonitorExposer::on_periodic_action(rti::routing::processor::Route &route) {
  * DEFAULT_ADDRESS of 127.0.0.1:8080
  * Note: user will need to tell prometheus 
  * about the custom address in prometheus.yml
+ *
+ * With property pushgateway (e.g. http://127.0.0.1:9091) metrics are pushed
+ * every push_interval_ms under the job push_job instead. A push not
+ * answered within push_timeout_ms fails and is retried later.
+ * The exposer is then only started if property exposer is given as well.
+ *
+ * Property exposer_threads sets how many scrapes are served in parallel,
+ * e.g. one per shard when Prometheus scrapes /metrics/shard/<i>?of=<n>
+ * with a job per shard.
+ * Property exposer_collect_threads adds threads collecting and serializing
+ * the families of a single scrape in parallel, none by default.
  */
+const std::string DEFAULT_PUSH_JOB = "rti_routing_service";
+const long long DEFAULT_PUSH_INTERVAL_MS = 15000;
+const long long DEFAULT_EXPOSER_THREADS = 1;
+const long long DEFAULT_EXPOSER_COLLECT_THREADS = 0;
+
+/*
+*  value of property name or default_value if it is not given
+*/
+static std::string find_property(
+        const rti::routing::PropertySet &properties,
+        const std::string& name,
+        const std::string& default_value) {
+    rti::routing::PropertySet::const_iterator it = properties.find(name);
+    return it != properties.end() ? it->second : default_value;
+}
+
+static long long find_number_property(
+        const rti::routing::PropertySet &properties,
+        const std::string& name,
+        long long default_value) {
+    std::string value = find_property(properties, name, "");
+    if (value.empty()) {
+        return default_value;
+    }
+    try {
+        return std::stoll(value);
+    } catch (std::exception& e) {
+        std::cout << "Invalid " << name << ": " << value << endl;
+        return default_value;
+    }
+}
 
 MonitorProcessorPlugin::MonitorProcessorPlugin(
         const rti::routing::PropertySet &properties) :
-                exposer {(properties.find("exposer") != properties.end() ?
-                    properties.find("exposer")->second: DEFAULT_ADDRESS), 1},
                 registry (std::make_shared<Registry>()) {       
+    std::string pushgateway = find_property(properties, "pushgateway", "");
+    if (!pushgateway.empty()) {
+        // host may contain the scheme, the port follows the last colon
+        // behind it
+        std::size_t scheme = pushgateway.find("://");
+        std::size_t host = scheme == std::string::npos ? 0 : scheme + 3;
+        std::size_t colon = pushgateway.rfind(':');
+        if (colon != std::string::npos && colon < host) {
+            colon = std::string::npos;
+        }
+        gateway.reset(new Gateway(
+                pushgateway.substr(0, colon),
+                colon == std::string::npos ? "9091" 
+                        : pushgateway.substr(colon + 1),
+                find_property(properties, "push_job", DEFAULT_PUSH_JOB)));
+        PeriodicPusher::Options options;
+        options.interval = std::chrono::milliseconds(find_number_property(
+                properties, "push_interval_ms", DEFAULT_PUSH_INTERVAL_MS));
+        options.max_buffered = find_number_property(
+                properties, "push_max_buffered", options.max_buffered);
+        options.timeout = std::chrono::milliseconds(find_number_property(
+                properties, "push_timeout_ms", options.timeout.count()));
+        gateway->RegisterCollectable(registry);
+        pusher.reset(new PeriodicPusher(*gateway, options, registry));
+        std::cout << "pushing metrics to " << pushgateway << endl;
+    }
+    if (!gateway || properties.find("exposer") != properties.end()) {
+        long long threads = find_number_property(
+                properties, "exposer_threads", DEFAULT_EXPOSER_THREADS);
+        if (threads < 1) {
+            threads = DEFAULT_EXPOSER_THREADS;
+        }
+        long long collect_threads = find_number_property(
+                properties, 
+                "exposer_collect_threads", 
+                DEFAULT_EXPOSER_COLLECT_THREADS);
+        if (collect_threads < 0) {
+            collect_threads = DEFAULT_EXPOSER_COLLECT_THREADS;
+        }
+        exposer.reset(new Exposer(
+                find_property(properties, "exposer", DEFAULT_ADDRESS),
+                static_cast<std::size_t>(threads),
+                static_cast<std::size_t>(collect_threads)));
+    }
 }
 
 
@@ -147,7 +337,17 @@ rti::routing::processor::Processor *MonitorProcessorPlugin::create_processor(
         const rti::routing::PropertySet &properties) {
     const std::string property_name = "mapping"; 
     std::string filename = properties.find(property_name)->second;
-    return new MonitorExposer(filename, exposer, registry);
+    std::chrono::milliseconds min_update_interval(find_number_property(
+            properties, MIN_UPDATE_INTERVAL_PROPERTY, 0));
+    if (min_update_interval.count() < 0) {
+        min_update_interval = std::chrono::milliseconds(0);
+    }
+    return new MonitorExposer(
+            filename, 
+            exposer.get(), 
+            gateway.get(), 
+            registry, 
+            min_update_interval);
 }
 
 void MonitorProcessorPlugin::delete_processor(
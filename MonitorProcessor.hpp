@@ -18,6 +18,8 @@
 #include <stdlib.h>
 
 #include <chrono>
+#include <ctime>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -28,6 +30,7 @@
 #include <dds/core/Optional.hpp>
 #include <dds/core/xtypes/DynamicData.hpp>
 #include <dds/core/xtypes/StructType.hpp>
+#include <dds/sub/SampleInfo.hpp>
 #include <rti/routing/processor/Processor.hpp>
 #include <rti/routing/processor/ProcessorPlugin.hpp>
 
@@ -36,6 +39,8 @@
 */
 #include <prometheus/counter.h>
 #include <prometheus/exposer.h>
+#include <prometheus/gateway.h>
+#include <prometheus/periodic_pusher.h>
 #include <prometheus/registry.h>
 
 using namespace prometheus;
@@ -55,12 +60,28 @@ public:
 
     MonitorExposer(
             std::string input_filename, 
-            prometheus::Exposer& input_exposer, 
-            std::shared_ptr<prometheus::Registry> input_registry);
+            prometheus::Exposer* input_exposer, 
+            prometheus::Gateway* input_gateway,
+            std::shared_ptr<prometheus::Registry> input_registry,
+            std::chrono::milliseconds input_min_update_interval = 
+                    std::chrono::milliseconds(0));
 
     ~MonitorExposer();
 
 private:
+    // Samples of an instance that arrive within min_update_interval of the
+    // last processed one only replace the pending sample, which is
+    // processed later on
+    struct ThrottledInstance {
+        std::chrono::steady_clock::time_point last_update;
+        dds::core::optional<dds::core::xtypes::DynamicData> pending_data;
+        dds::core::optional<dds::sub::SampleInfo> pending_info;
+    };
+
+    // map the pending samples whose interval has passed and forget 
+    // instances that have been quiet for a whole interval
+    void flush_pending(std::chrono::steady_clock::time_point now);
+
     // Optional member for deferred initialization: this object can be created
     // only when the output is enabled.
     // You can use std::optional if supported in your platform
@@ -70,10 +91,29 @@ private:
     std::string filename;
 
     // Mapper that handle mapping topic to matric and register it
-    Mapper mapper;
+    // replaced as a whole when the yaml file is reloaded
+    std::shared_ptr<Mapper> mapper;
+
+    // type of the input topic, known once the input is enabled
+    std::shared_ptr<dds::core::xtypes::DynamicType> topic_type;
+
+    // modification time of the yaml file the mapper was loaded from
+    time_t config_mtime;
+
+    // Mapper being loaded from a changed yaml file in the background
+    std::future<std::shared_ptr<Mapper>> pending_mapper;
+
+    // route property min_update_interval_ms, zero maps every sample
+    std::chrono::milliseconds min_update_interval;
+
+    // instances updated within the last min_update_interval
+    std::map<dds::core::InstanceHandle, ThrottledInstance> throttled;
 
     // Exposer own by ProcessorPlugin which passes on to processor
-    prometheus::Exposer& exposer;
+    // NULL if metrics are only pushed
+    prometheus::Exposer* exposer;
+    // Gateway own by ProcessorPlugin, NULL if metrics are not pushed
+    prometheus::Gateway* gateway;
     // Registry own by ProcessorPlugin 
     std::shared_ptr<prometheus::Registry> registry;
 
@@ -93,9 +133,14 @@ public:
     MonitorProcessorPlugin(const rti::routing::PropertySet &properties);
 
 private:
-    // Exposer for Prometheus 
-    prometheus::Exposer exposer;
     std::shared_ptr<prometheus::Registry> registry;
+    // Pushgateway and the thread pushing to it, 
+    // only if property pushgateway is given
+    std::unique_ptr<prometheus::Gateway> gateway;
+    std::unique_ptr<prometheus::PeriodicPusher> pusher;
+    // Exposer for Prometheus, 
+    // unless only property pushgateway but not exposer is given
+    std::unique_ptr<prometheus::Exposer> exposer;
 };
 
 
@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/columnar_gauge.h>
+#include <prometheus/gauge.h>
+#include <prometheus/registry.h>
+
+static void BM_Gauge_SetAllSeries(benchmark::State& state) {
+  using prometheus::BuildGauge;
+  using prometheus::Gauge;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildGauge().Name("benchmark_gauge").Help("").Register(registry);
+  std::vector<Gauge*> gauges;
+  for (auto i = 0; i < state.range(0); ++i) {
+    gauges.push_back(&gauge_family.Add({{"index", std::to_string(i)}}));
+  }
+
+  while (state.KeepRunning()) {
+    for (auto gauge : gauges) gauge->Set(1.0);
+  }
+}
+BENCHMARK(BM_Gauge_SetAllSeries)->Range(8, 4096);
+
+static void BM_ColumnarGauge_SetAllSeries(benchmark::State& state) {
+  using prometheus::BuildColumnarGauge;
+  using prometheus::ColumnarGauge;
+  using prometheus::Family;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildColumnarGauge().Name("benchmark_gauge").Help("").Register(registry);
+  std::vector<Family<ColumnarGauge>::Handle> handles;
+  for (auto i = 0; i < state.range(0); ++i) {
+    handles.push_back(gauge_family.Add({{"index", std::to_string(i)}}));
+  }
+
+  while (state.KeepRunning()) {
+    for (auto handle : handles) gauge_family.Set(handle, 1.0);
+  }
+}
+BENCHMARK(BM_ColumnarGauge_SetAllSeries)->Range(8, 4096);
+
+static void BM_Gauge_CollectFamily(benchmark::State& state) {
+  using prometheus::BuildGauge;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildGauge().Name("benchmark_gauge").Help("").Register(registry);
+  for (auto i = 0; i < state.range(0); ++i) {
+    gauge_family.Add({{"index", std::to_string(i)}});
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(gauge_family.Collect());
+  }
+}
+BENCHMARK(BM_Gauge_CollectFamily)->Range(8, 4096);
+
+static void BM_ColumnarGauge_CollectFamily(benchmark::State& state) {
+  using prometheus::BuildColumnarGauge;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildColumnarGauge().Name("benchmark_gauge").Help("").Register(registry);
+  for (auto i = 0; i < state.range(0); ++i) {
+    gauge_family.Add({{"index", std::to_string(i)}});
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(gauge_family.Collect());
+  }
+}
+BENCHMARK(BM_ColumnarGauge_CollectFamily)->Range(8, 4096);
+
+static void BM_ColumnarGauge_SetBatch(benchmark::State& state) {
+  using prometheus::BuildColumnarGauge;
+  using prometheus::ColumnarGaugeBatch;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildColumnarGauge().Name("benchmark_gauge").Help("").Register(registry);
+  ColumnarGaugeBatch batch;
+  for (auto i = 0; i < state.range(0); ++i) {
+    batch.Add(gauge_family, gauge_family.Add({{"index", std::to_string(i)}}));
+  }
+  std::vector<double> values(batch.Size(), 1.0);
+
+  while (state.KeepRunning()) {
+    batch.Set(values);
+  }
+}
+BENCHMARK(BM_ColumnarGauge_SetBatch)->Range(8, 4096);
+
+static void BM_ColumnarGauge_CollectChangedSince(benchmark::State& state) {
+  using prometheus::BuildColumnarGauge;
+  using prometheus::ColumnarGauge;
+  using prometheus::Family;
+  using prometheus::Registry;
+  Registry registry;
+  auto& gauge_family =
+      BuildColumnarGauge().Name("benchmark_gauge").Help("").Register(registry);
+  std::vector<Family<ColumnarGauge>::Handle> handles;
+  for (auto i = 0; i < 4096; ++i) {
+    handles.push_back(gauge_family.Add({{"index", std::to_string(i)}}));
+  }
+  const auto changed = handles.size() * state.range(0) / 100;
+
+  std::uint64_t sequence = gauge_family.ChangeSequence();
+  double value = 0.0;
+  while (state.KeepRunning()) {
+    value += 1.0;
+    for (std::size_t i = 0; i < changed; ++i) {
+      gauge_family.Set(handles[i], value);
+    }
+    benchmark::DoNotOptimize(
+        gauge_family.CollectChangedSince(sequence, &sequence));
+  }
+}
+BENCHMARK(BM_ColumnarGauge_CollectChangedSince)->Arg(0)->Arg(30)->Arg(100);
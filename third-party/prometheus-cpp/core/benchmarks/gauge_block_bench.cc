@@ -0,0 +1,40 @@
+#include <benchmark/benchmark.h>
+#include <prometheus/gauge_block.h>
+
+#include <string>
+#include <vector>
+
+static void BM_GaugeBlock_Publish(benchmark::State& state) {
+  using prometheus::GaugeBlock;
+  using prometheus::GaugeBlockGroup;
+  GaugeBlockGroup group;
+  auto family = group.AddFamily("benchmark_gauge", "");
+  std::vector<GaugeBlock::Series> series;
+  for (auto i = 0; i < state.range(0); ++i) {
+    series.push_back({family, {{"index", std::to_string(i)}}});
+  }
+  auto& block = group.AddBlock(series);
+  std::vector<double> values(block.Size(), 1.0);
+
+  while (state.KeepRunning()) {
+    block.Publish(values);
+  }
+}
+BENCHMARK(BM_GaugeBlock_Publish)->Range(8, 4096);
+
+static void BM_GaugeBlock_Collect(benchmark::State& state) {
+  using prometheus::GaugeBlock;
+  using prometheus::GaugeBlockGroup;
+  GaugeBlockGroup group;
+  auto family = group.AddFamily("benchmark_gauge", "");
+  std::vector<GaugeBlock::Series> series;
+  for (auto i = 0; i < state.range(0); ++i) {
+    series.push_back({family, {{"index", std::to_string(i)}}});
+  }
+  group.AddBlock(series);
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(group.Collect());
+  }
+}
+BENCHMARK(BM_GaugeBlock_Collect)->Range(8, 4096);
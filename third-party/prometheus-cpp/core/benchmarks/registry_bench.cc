@@ -1,8 +1,14 @@
 #include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 #include <prometheus/counter.h>
+#include <prometheus/detail/worker_pool.h>
 #include <prometheus/registry.h>
+#include <prometheus/text_serializer.h>
 
 #include "benchmark_helpers.h"
 
@@ -41,3 +47,50 @@ static void BM_Registry_CreateCounter(benchmark::State& state) {
   }
 }
 BENCHMARK(BM_Registry_CreateCounter)->Range(0, 4096);
+
+// A scrape of 128 families of 256 series each, collected and serialized
+// like the exposer does with the given number of collect threads.
+static void BM_Registry_Scrape(benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::MetricFamily;
+  using prometheus::Registry;
+  using prometheus::TextSerializer;
+  using prometheus::detail::WorkerPool;
+  Registry registry;
+  for (auto i = 0; i < 128; ++i) {
+    auto& family = BuildCounter()
+                       .Name("benchmark_counter_" + std::to_string(i))
+                       .Help("")
+                       .Register(registry);
+    for (auto j = 0; j < 256; ++j) {
+      family.Add({{"index", std::to_string(j)}}).Increment(j);
+    }
+  }
+  WorkerPool pool{static_cast<std::size_t>(state.range(0))};
+  TextSerializer serializer;
+
+  while (state.KeepRunning()) {
+    auto families = registry.CollectParallel(pool);
+    const auto num_parts = 4 * (pool.Size() + 1);
+    std::vector<std::string> parts(num_parts);
+    pool.ParallelFor(num_parts, [&](std::size_t i) {
+      auto begin = families.begin() + families.size() * i / num_parts;
+      auto end = families.begin() + families.size() * (i + 1) / num_parts;
+      std::ostringstream out;
+      serializer.SerializePart(out, std::vector<MetricFamily>(begin, end));
+      parts[i] = out.str();
+    });
+    std::string body;
+    for (const auto& part : parts) {
+      body += part;
+    }
+    benchmark::DoNotOptimize(body);
+  }
+}
+BENCHMARK(BM_Registry_Scrape)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(3)
+    ->Arg(7)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+#include <prometheus/counter.h>
+#include <prometheus/protobuf_serializer.h>
+#include <prometheus/registry.h>
+#include <prometheus/text_serializer.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<prometheus::MetricFamily> Families(int series) {
+  using prometheus::BuildCounter;
+  prometheus::Registry registry;
+  auto& family = BuildCounter()
+                     .Name("benchmark_counter")
+                     .Help("")
+                     .Labels({{"instance", "benchmark"}})
+                     .Register(registry);
+  for (auto i = 0; i < series; ++i) {
+    family.Add({{"index", std::to_string(i)}}).Increment(i * 0.5);
+  }
+  return registry.Collect();
+}
+}  // namespace
+
+static void BM_Serializer_Text(benchmark::State& state) {
+  auto families = Families(state.range(0));
+  prometheus::TextSerializer serializer;
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(serializer.Serialize(families));
+  }
+  state.counters["bytes"] =
+      static_cast<double>(serializer.Serialize(families).size());
+}
+BENCHMARK(BM_Serializer_Text)->Range(8, 4096);
+
+static void BM_Serializer_Protobuf(benchmark::State& state) {
+  auto families = Families(state.range(0));
+  prometheus::ProtobufSerializer serializer;
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(serializer.Serialize(families));
+  }
+  state.counters["bytes"] =
+      static_cast<double>(serializer.Serialize(families).size());
+}
+BENCHMARK(BM_Serializer_Protobuf)->Range(8, 4096);
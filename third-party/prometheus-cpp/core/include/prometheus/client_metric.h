@@ -78,6 +78,10 @@ struct PROMETHEUS_CPP_CORE_EXPORT ClientMetric {
   // Timestamp
 
   std::int64_t timestamp_ms = 0;
+
+  // Creation time of counters, summaries and histograms
+
+  std::int64_t created_timestamp_ms = 0;
 };
 
 }  // namespace prometheus
@@ -1,15 +1,47 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "prometheus/detail/core_export.h"
 
 namespace prometheus {
 struct MetricFamily;
-}
+namespace detail {
+class WorkerPool;
+}  // namespace detail
+}  // namespace prometheus
 
 namespace prometheus {
 
+class Collectable;
+
+/// \brief Position of an incremental consumer in the changes of a
+/// collectable, see Collectable::CollectChanged().
+///
+/// The consumer keeps one cursor per collectable between calls.
+struct ChangeCursor {
+  struct Position {
+    /// \brief Identifies the family, its address may be reused by another.
+    std::uint64_t instance;
+    /// \brief Sequence number of the last change consumed.
+    std::uint64_t sequence;
+    /// \brief Value of ChangeCursor::pass when the family was collected.
+    std::uint64_t pass;
+  };
+
+  /// \brief Set by the consumer to collect all series, e.g., to resend them.
+  bool all = false;
+  /// \brief Incremented by the consumer before every collection. Positions
+  /// left at an older pass belong to families that are gone.
+  std::uint64_t pass = 0;
+  std::unordered_map<const Collectable*, Position> positions;
+};
+
 /// @brief Interface implemented by anything that can be used by Prometheus to
 /// collect metrics.
 ///
@@ -20,6 +52,47 @@ class PROMETHEUS_CPP_CORE_EXPORT Collectable {
 
   /// \brief Returns a list of metrics and their samples.
   virtual std::vector<MetricFamily> Collect() const = 0;
+
+  /// \brief Returns the metrics with the given names only.
+  ///
+  /// The default implementation collects all metrics and drops the others.
+  /// Collectables that can look up their metrics by name override it, so a
+  /// scrape of a few metrics does not pay for all of them.
+  ///
+  /// \param names Names of the metric families to collect.
+  virtual std::vector<MetricFamily> CollectFamilies(
+      const std::set<std::string>& names) const;
+
+  /// \brief Returns the metrics of one shard only.
+  ///
+  /// Metric families are assigned to shards by their name, see
+  /// detail::shard_of(). Like CollectFamilies(), the default implementation
+  /// collects all metrics and drops the others.
+  ///
+  /// \param shard The shard to collect, less than \p shards.
+  /// \param shards The number of shards.
+  virtual std::vector<MetricFamily> CollectShard(std::size_t shard,
+                                                 std::size_t shards) const;
+
+  /// \brief Returns the same metrics as Collect(), collecting independent
+  /// parts on the threads of the pool.
+  ///
+  /// The default implementation calls Collect(). Collectables made of
+  /// several parts, like a Registry of families, override it.
+  virtual std::vector<MetricFamily> CollectParallel(
+      detail::WorkerPool& pool) const;
+
+  /// \brief Returns the metrics changed since the previous call with the
+  /// same cursor.
+  ///
+  /// Families that track their changes, like Family<ColumnarGauge>, append
+  /// only their changed series to \p changed and advance \p cursor. Removed
+  /// and expired series are not reported. All other metrics are appended to
+  /// \p all like Collect() returns them, the consumer has to compare those
+  /// itself. The default implementation appends Collect() to \p all.
+  virtual void CollectChanged(ChangeCursor& cursor,
+                              std::vector<MetricFamily>& changed,
+                              std::vector<MetricFamily>& all) const;
 };
 
 }  // namespace prometheus
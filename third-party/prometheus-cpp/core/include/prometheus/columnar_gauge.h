@@ -0,0 +1,321 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/aligned_allocator.h"
+#include "prometheus/detail/builder.h"
+#include "prometheus/detail/core_export.h"
+#include "prometheus/detail/series_expiry.h"
+#include "prometheus/detail/series_limit.h"
+#include "prometheus/family.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/metric_type.h"
+#include "prometheus/series_budget.h"
+
+namespace prometheus {
+
+/// \brief Selects the columnar storage mode for a family of gauges.
+///
+/// A Family<Gauge> allocates one Gauge object per dimensional data. A
+/// Family<ColumnarGauge> instead keeps the values of all dimensional data in
+/// one contiguous, cache line aligned array indexed by slot. Removed slots
+/// are kept on a free list and reused by later calls to Add().
+///
+/// Dimensional data is addressed by a Family<ColumnarGauge>::Handle instead
+/// of a reference to a metric object. Collecting the family is a linear scan
+/// over the array, and updating many dimensional data of the same family
+/// touches adjacent cache lines only.
+///
+/// The series are exposed with the metric type gauge.
+class PROMETHEUS_CPP_CORE_EXPORT ColumnarGauge {
+ public:
+  static const MetricType metric_type{MetricType::Gauge};
+};
+
+/// \brief A family of gauges stored in columns.
+///
+/// @copydetails ColumnarGauge
+///
+/// The class is thread-safe. No concurrent call to any API of this type causes
+/// a data race.
+template <>
+class PROMETHEUS_CPP_CORE_EXPORT Family<ColumnarGauge> : public Collectable {
+ public:
+  /// \brief Identifies a dimensional data within the family.
+  ///
+  /// The lower 32 bits hold the slot index, which stays the same for the
+  /// lifetime of the dimensional data. The upper 32 bits hold the generation
+  /// of the slot, so a handle of removed or expired data never refers to the
+  /// data that reuses its slot.
+  using Handle = std::uint64_t;
+
+  /// \brief A handle that never refers to any dimensional data.
+  static constexpr Handle kInvalidHandle = ~Handle{0};
+
+  /// @copydoc Family<>::Family()
+  Family(const std::string& name, const std::string& help,
+         const std::map<std::string, std::string>& constant_labels);
+
+  /// \brief Add a new dimensional data with a value of 0.
+  ///
+  /// \param labels Assign a set of key-value pairs (= labels) to the
+  /// dimensional data. The function does nothing, if the same set of labels
+  /// already exists.
+  /// \return The handle of the newly created dimensional data or - if a same
+  /// set of labels already exists - the handle of the existing one.
+  Handle Add(const std::map<std::string, std::string>& labels);
+
+  /// \brief Remove the given dimensional data.
+  ///
+  /// The slot is put on the free list. The function does nothing, if the
+  /// handle does not refer to existing dimensional data.
+  void Remove(Handle handle);
+
+  /// \brief Set the value of the given dimensional data.
+  ///
+  /// Setting the value the dimensional data already has still counts as an
+  /// update for SetMaxAge(), but not as a change, see ChangeSequence().
+  ///
+  /// \param timestamp_ms Unix time in milliseconds the value was measured at,
+  /// e.g., taken from the source of the value. It is exposed with the value.
+  /// A value of 0 exposes no timestamp, so the value is stamped at scrape
+  /// time. A different timestamp alone is no change.
+  /// \return False if the handle does not refer to existing dimensional data
+  /// anymore, e.g., because it expired. The handle has to be resolved again
+  /// with Add() in that case.
+  bool Set(Handle handle, double value, std::int64_t timestamp_ms = 0);
+
+  /// \brief Set the values of many dimensional data at once.
+  ///
+  /// All values are applied under a single lock acquisition.
+  ///
+  /// \param handles Handles of the dimensional data to update.
+  /// \param values values[i] is assigned to the data of handles[i].
+  /// \param count Number of entries in both arrays.
+  /// \param timestamp_ms Timestamp of all values, see Set(Handle, double,
+  /// std::int64_t).
+  /// \return The number of values applied. Handles that do not refer to
+  /// existing dimensional data anymore are skipped.
+  std::size_t Set(const Handle* handles, const double* values,
+                  std::size_t count, std::int64_t timestamp_ms = 0);
+
+  /// \brief Get the value of the given dimensional data.
+  ///
+  /// \return The current value or NaN if the handle does not refer to
+  /// existing dimensional data.
+  double Value(Handle handle) const;
+
+  /// \brief Expire dimensional data that has not been updated recently.
+  ///
+  /// Works like Family<>::SetMaxAge(), except that both Add() and Set() count
+  /// as update. Handles stay safe to use after their data expired, Set()
+  /// returns false for them and they have to be resolved again with Add().
+  ///
+  /// \param max_age Maximum time since the last update. A value of zero
+  /// disables expiry, which is the default.
+  void SetMaxAge(std::chrono::steady_clock::duration max_age);
+
+  /// @copydoc Family<>::RemoveStale()
+  std::size_t RemoveStale();
+
+  /// @copydoc Family<>::SetMaxSeries()
+  void SetMaxSeries(std::size_t max_series);
+
+  /// @copydoc Family<>::SetSeriesBudget()
+  void SetSeriesBudget(std::shared_ptr<SeriesBudget> budget);
+
+  /// @copydoc Family<>::SetUnit()
+  void SetUnit(const std::string& unit);
+
+  /// @copydoc Family<>::RejectedCount()
+  std::uint64_t RejectedCount() const;
+
+  /// \brief Returns the number of dimensional data in this family.
+  std::size_t Size() const;
+
+  /// @copydoc Family<>::GetName()
+  const std::string& GetName() const;
+
+  /// @copydoc Family<>::GetConstantLabels()
+  const std::map<std::string, std::string> GetConstantLabels() const;
+
+  /// @copydoc Family<>::Collect()
+  std::vector<MetricFamily> Collect() const override;
+
+  /// \brief Returns the sequence number of the last change.
+  ///
+  /// Adding new dimensional data and setting a different value are changes.
+  /// Each change is assigned the next sequence number, starting at 1.
+  /// Removing dimensional data or its expiry is no change.
+  std::uint64_t ChangeSequence() const;
+
+  /// \brief Returns the dimensional data changed after a sequence number.
+  ///
+  /// Incremental consumers, e.g., a pusher that only sends changed series,
+  /// pass the sequence number returned by their previous call.
+  ///
+  /// Removed and expired dimensional data is not reported, there are no
+  /// tombstones. A consumer that has to learn about deletions compares with
+  /// a full collection now and then, e.g., with \p since 0.
+  ///
+  /// \param since Sequence number of the last change already consumed, 0 to
+  /// collect all dimensional data.
+  /// \param sequence Receives the sequence number of the last change
+  /// included in the result.
+  /// \return Zero or one metric family. The family is omitted, if no
+  /// dimensional data changed.
+  std::vector<MetricFamily> CollectChangedSince(std::uint64_t since,
+                                                std::uint64_t* sequence) const;
+
+  /// @copydoc Collectable::CollectChanged()
+  ///
+  /// The series changed since the position of the family in \p cursor are
+  /// appended to \p changed, see CollectChangedSince().
+  void CollectChanged(ChangeCursor& cursor, std::vector<MetricFamily>& changed,
+                      std::vector<MetricFamily>& all) const override;
+
+ private:
+  using Slot = std::uint32_t;
+
+  bool Resolve(Handle handle, Slot* slot) const;
+  Handle MakeHandle(Slot slot) const;
+  void FreeSlot(Slot slot) const;
+  std::size_t RemoveStaleLocked() const;
+  void SetLocked(Slot slot, double value, std::int64_t timestamp_ms,
+                 std::uint64_t epoch);
+  MetricFamily CollectLocked(std::uint64_t since) const;
+
+  // one entry per slot, mutable because Collect() sweeps expired slots
+  mutable std::vector<double, detail::AlignedAllocator<double>> values_;
+  mutable std::vector<std::int64_t> timestamps_ms_;
+  mutable std::vector<std::uint64_t> last_update_epochs_;
+  mutable std::vector<std::uint32_t> generations_;
+  mutable std::vector<std::uint8_t> in_use_;
+  mutable std::vector<std::size_t> label_hashes_;
+  mutable std::vector<std::map<std::string, std::string>> labels_;
+  // sequence number of the last change of each slot
+  mutable std::vector<std::uint64_t> change_sequences_;
+
+  mutable std::vector<Slot> free_slots_;
+  mutable std::unordered_map<std::size_t, Slot> slots_by_hash_;
+  mutable detail::SeriesExpiry expiry_;
+  mutable detail::SeriesLimit limit_;
+  const std::size_t overflow_hash_;
+  // unique in the process, unlike the address of the family
+  const std::uint64_t instance_;
+  std::uint64_t change_sequence_ = 0;
+
+  const std::string name_;
+  const std::string help_;
+  std::string unit_;
+  const std::map<std::string, std::string> constant_labels_;
+  mutable std::mutex mutex_;
+};
+
+/// \brief Pre-resolved dimensional data of one or more columnar gauge families
+/// that are updated together.
+///
+/// A batch is built once from handles returned by Family<ColumnarGauge>::Add()
+/// and then applied repeatedly with a new array of values, e.g., once for
+/// every sample of a data source. Consecutive entries of the same family are
+/// applied with a single lock acquisition on that family.
+///
+/// The class is not thread-safe. The families must outlive the batch.
+class PROMETHEUS_CPP_CORE_EXPORT ColumnarGaugeBatch {
+ public:
+  /// \brief Append a dimensional data to the batch.
+  ///
+  /// \return The position of the value for this data in the array passed to
+  /// Set().
+  std::size_t Add(Family<ColumnarGauge>& family,
+                  Family<ColumnarGauge>::Handle handle);
+
+  /// \brief Remove all entries.
+  void Clear();
+
+  /// \brief Returns the number of entries.
+  std::size_t Size() const { return handles_.size(); }
+
+  /// \brief Assign values[i] to the i-th entry of the batch.
+  ///
+  /// \param values Must hold Size() values.
+  /// \param timestamp_ms Timestamp of all values, see
+  /// Family<ColumnarGauge>::Set().
+  /// \return The number of values applied. If it is less than Size(), some
+  /// handles do not refer to existing dimensional data anymore and the batch
+  /// has to be built again.
+  std::size_t Set(const double* values, std::int64_t timestamp_ms = 0) const;
+
+  /// @copydoc Set(const double*, std::int64_t) const
+  std::size_t Set(const std::vector<double>& values,
+                  std::int64_t timestamp_ms = 0) const;
+
+  /// \brief Assign values[i] to the i-th entry of the batch only if it
+  /// differs from previous[i].
+  ///
+  /// Families without a changed value are not locked at all. Unchanged
+  /// entries are not updated for Family<ColumnarGauge>::SetMaxAge() and keep
+  /// their timestamp, so this is meant for families that do not expire and
+  /// values without timestamp.
+  ///
+  /// \param values Must hold Size() values.
+  /// \param previous Must hold Size() values, e.g., the values of the last
+  /// call.
+  /// \return The number of values applied or unchanged. If it is less than
+  /// Size(), some handles do not refer to existing dimensional data anymore
+  /// and the batch has to be built again.
+  std::size_t SetChanged(const double* values, const double* previous,
+                         std::int64_t timestamp_ms = 0) const;
+
+ private:
+  struct Run {
+    Family<ColumnarGauge>* family;
+    std::size_t begin;
+    std::size_t end;
+  };
+  std::vector<Run> runs_;
+  std::vector<Family<ColumnarGauge>::Handle> handles_;
+  // changed entries of a run, kept to not allocate on every SetChanged()
+  mutable std::vector<Family<ColumnarGauge>::Handle> changed_handles_;
+  mutable std::vector<double> changed_values_;
+};
+
+/// \brief Return a builder to configure and register a columnar gauge family.
+///
+/// Example usage:
+///
+/// \code
+/// auto registry = std::make_shared<Registry>();
+/// auto& gauge_family = prometheus::BuildColumnarGauge()
+///                          .Name("some_name")
+///                          .Help("Additional description.")
+///                          .Labels({{"key", "value"}})
+///                          .Register(*registry);
+/// auto handle = gauge_family.Add({{"instance", "1"}});
+/// gauge_family.Set(handle, 42.0);
+/// \endcode
+///
+/// \return An object of unspecified type T, i.e., an implementation detail
+/// except that it has the following members:
+///
+/// - Name(const std::string&) to set the metric name,
+/// - Help(const std::string&) to set an additional description.
+/// - Unit(const std::string&) to set the unit, e.g., "seconds". It is only
+///   exposed in the OpenMetrics format.
+/// - Label(const std::map<std::string, std::string>&) to assign a set of
+///   key-value pairs (= labels) to the metric.
+///
+/// To finish the configuration of the family register it with
+/// Register(Registry&).
+PROMETHEUS_CPP_CORE_EXPORT detail::Builder<ColumnarGauge> BuildColumnarGauge();
+
+}  // namespace prometheus
@@ -47,6 +47,12 @@ class PROMETHEUS_CPP_CORE_EXPORT Counter {
   ClientMetric Collect() const;
 
  private:
+  template <typename T>
+  friend class Family;
+  friend class Histogram;
+
+  bool ConsumeUpdate() { return gauge_.ConsumeUpdate(); }
+
   Gauge gauge_{0.0};
 };
 
@@ -72,6 +78,8 @@ class PROMETHEUS_CPP_CORE_EXPORT Counter {
 ///
 /// - Name(const std::string&) to set the metric name,
 /// - Help(const std::string&) to set an additional description.
+/// - Unit(const std::string&) to set the unit, e.g., "seconds". It is only
+///   exposed in the OpenMetrics format.
 /// - Label(const std::map<std::string, std::string>&) to assign a set of
 ///   key-value pairs (= labels) to the metric.
 ///
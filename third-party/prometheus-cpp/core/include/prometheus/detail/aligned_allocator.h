@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Size of a cache line on the platforms we care about.
+constexpr std::size_t kCacheLineSize = 64;
+
+/// \brief Allocator returning storage aligned to Alignment bytes.
+///
+/// Over-aligned operator new is not available before C++17, so the allocator
+/// over-allocates and stores the original pointer right before the aligned
+/// block.
+template <typename T, std::size_t Alignment = kCacheLineSize>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(std::size_t n) {
+    const auto size = n * sizeof(T) + Alignment + sizeof(void*);
+    auto raw = static_cast<char*>(::operator new(size));
+    auto address = reinterpret_cast<std::uintptr_t>(raw + sizeof(void*));
+    address = (address + Alignment - 1) & ~(std::uintptr_t{Alignment} - 1);
+    auto aligned = reinterpret_cast<void**>(address);
+    aligned[-1] = raw;
+    return reinterpret_cast<T*>(aligned);
+  }
+
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(reinterpret_cast<void**>(p)[-1]);
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+    return false;
+  }
+};
+
+}  // namespace detail
+
+}  // namespace prometheus
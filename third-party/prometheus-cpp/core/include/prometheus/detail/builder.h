@@ -17,12 +17,14 @@ class Builder {
   Builder& Labels(const std::map<std::string, std::string>& labels);
   Builder& Name(const std::string&);
   Builder& Help(const std::string&);
+  Builder& Unit(const std::string&);
   Family<T>& Register(Registry&);
 
  private:
   std::map<std::string, std::string> labels_;
   std::string name_;
   std::string help_;
+  std::string unit_;
 };
 
 }  // namespace detail
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Primitives to encode protobuf messages by hand.
+///
+/// A message is written by first computing the sizes of its nested messages,
+/// so that every length prefix is known before the nested message is
+/// written and no temporary buffers are needed.
+namespace protobuf {
+
+enum WireType : std::uint32_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+};
+
+inline std::size_t VarintSize(std::uint64_t value) {
+  std::size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline void AppendVarint(std::string& output, std::uint64_t value) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+/// \brief Size of the key of a field with a number below 16.
+constexpr std::size_t kTagSize = 1;
+
+inline void AppendTag(std::string& output, std::uint32_t field,
+                      WireType type) {
+  AppendVarint(output, (field << 3) | type);
+}
+
+/// \brief Size of a length-delimited field with the given payload size.
+inline std::size_t LengthDelimitedSize(std::size_t size) {
+  return kTagSize + VarintSize(size) + size;
+}
+
+inline void AppendLengthDelimited(std::string& output, std::uint32_t field,
+                                  std::size_t size) {
+  AppendTag(output, field, kLengthDelimited);
+  AppendVarint(output, size);
+}
+
+inline std::size_t StringSize(const std::string& value) {
+  return LengthDelimitedSize(value.size());
+}
+
+inline void AppendString(std::string& output, std::uint32_t field,
+                         const std::string& value) {
+  AppendLengthDelimited(output, field, value.size());
+  output.append(value);
+}
+
+constexpr std::size_t kDoubleSize = kTagSize + 8;
+
+inline void AppendDouble(std::string& output, std::uint32_t field,
+                         double value) {
+  AppendTag(output, field, kFixed64);
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (auto i = 0; i < 8; ++i) {
+    output.push_back(static_cast<char>(bits >> (8 * i)));
+  }
+}
+
+/// \brief Size of a varint field, an int64 is encoded as its two's
+/// complement.
+inline std::size_t UintSize(std::uint64_t value) {
+  return kTagSize + VarintSize(value);
+}
+
+inline void AppendUint(std::string& output, std::uint32_t field,
+                       std::uint64_t value) {
+  AppendTag(output, field, kVarint);
+  AppendVarint(output, value);
+}
+
+}  // namespace protobuf
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Epoch based bookkeeping to expire dimensional data of a family.
+///
+/// Updates only record the number of the current epoch, which is advanced by
+/// every sweep. The end time of each epoch is remembered, so a sweep can
+/// decide whether data last touched in a given epoch is older than the max
+/// age without reading the clock on the update path.
+///
+/// The class is not thread-safe, it is guarded by the mutex of its family.
+class PROMETHEUS_CPP_CORE_EXPORT SeriesExpiry {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// \brief Set the max age, a value of zero disables expiry.
+  void SetMaxAge(Clock::duration max_age);
+
+  /// \brief Returns true if a max age was set.
+  bool Enabled() const { return max_age_ != Clock::duration::zero(); }
+
+  /// \brief Returns the epoch updates are recorded in.
+  std::uint64_t Epoch() const { return epoch_; }
+
+  /// \brief Close the current epoch and start a sweep.
+  ///
+  /// \return False if expiry is disabled and nothing has to be swept.
+  bool BeginSweep();
+
+  /// \brief Returns true if data last touched in the given epoch is expired.
+  ///
+  /// Must only be called between BeginSweep() and EndSweep().
+  bool IsStale(std::uint64_t epoch) const;
+
+  /// \brief Finish a sweep and forget epochs no data can refer to anymore.
+  void EndSweep();
+
+ private:
+  Clock::duration max_age_{};
+  Clock::time_point cutoff_;
+  std::uint64_t epoch_ = 0;
+  // epoch_end_times_[i] is the time epoch first_epoch_ + i was closed
+  std::uint64_t first_epoch_ = 0;
+  std::deque<Clock::time_point> epoch_end_times_;
+};
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/series_budget.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Bookkeeping of the number of dimensional data of a family.
+///
+/// Dimensional data admitted by Admit() counts against the max number of
+/// series of the family and against its budget, if any, until Release().
+/// The overflow series that takes the rejected label sets is never counted.
+/// Rejected label sets are counted once each, as long as no more than
+/// kMaxRememberedRejections distinct ones are rejected. The remembered label
+/// sets are forgotten at once beyond that, so a label set may be counted
+/// again.
+///
+/// The class is not thread-safe, it is guarded by the mutex of its family.
+/// Only Rejected() may be called without holding that mutex.
+class PROMETHEUS_CPP_CORE_EXPORT SeriesLimit {
+ public:
+  /// \brief The max number of rejected label sets remembered.
+  static constexpr std::size_t kMaxRememberedRejections = 4096;
+
+  SeriesLimit() = default;
+  SeriesLimit(const SeriesLimit&) = delete;
+  SeriesLimit& operator=(const SeriesLimit&) = delete;
+  ~SeriesLimit();
+
+  /// \brief Returns the labels of the overflow series.
+  static const std::map<std::string, std::string>& OverflowLabels();
+
+  /// \brief Set the max number of series, a value of zero disables the limit.
+  void SetMaxSeries(std::size_t max_series) { max_series_ = max_series; }
+
+  /// \brief Move the admitted series to another budget, may be null.
+  void SetBudget(std::shared_ptr<SeriesBudget> budget);
+
+  /// \brief Count a new series.
+  ///
+  /// \param hash Hash of the label set of the series.
+  /// \return False if the series must go to the overflow series instead. The
+  /// rejection is counted then, unless the label set was rejected before.
+  bool Admit(std::size_t hash);
+
+  /// \brief Stop counting a series returned true by Admit().
+  void Release();
+
+  /// \brief Returns the number of distinct label sets not admitted.
+  std::uint64_t Rejected() const {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::size_t max_series_ = 0;
+  std::size_t admitted_ = 0;
+  std::shared_ptr<SeriesBudget> budget_;
+  std::unordered_set<std::size_t> rejected_hashes_;
+  std::atomic<std::uint64_t> rejected_{0};
+};
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -18,6 +18,18 @@ namespace detail {
 PROMETHEUS_CPP_CORE_EXPORT std::size_t hash_labels(
     const std::map<std::string, std::string>& labels);
 
+/// \brief Compute the shard a metric family belongs to.
+///
+/// The shard only depends on the name, it is the same in every process and
+/// on every platform.
+///
+/// \param name The name of the metric family.
+/// \param shards The number of shards, must not be 0.
+///
+/// \returns A shard in the range [0, shards).
+PROMETHEUS_CPP_CORE_EXPORT std::size_t shard_of(const std::string& name,
+                                                std::size_t shards);
+
 }  // namespace detail
 
 }  // namespace prometheus
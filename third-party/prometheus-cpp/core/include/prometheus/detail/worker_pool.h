@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief A fixed set of threads running the iterations of parallel loops.
+///
+/// Iterations are not assigned up front. Every thread taking part in a loop
+/// claims the next unclaimed iteration until none is left, so threads that
+/// finish cheap iterations early take over the rest of the work.
+///
+/// The calling thread takes part in its own loop. A loop therefore makes
+/// progress even if all workers are busy with the loops of other threads,
+/// e.g., scrapes served concurrently.
+class PROMETHEUS_CPP_CORE_EXPORT WorkerPool {
+ public:
+  /// \brief Start the workers.
+  ///
+  /// \param num_threads Number of threads besides the caller of a loop. With
+  /// 0 the iterations run on the calling thread only.
+  explicit WorkerPool(std::size_t num_threads);
+
+  /// \brief Stop the workers. No loop must be running anymore.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /// \brief Returns the number of worker threads.
+  std::size_t Size() const { return threads_.size(); }
+
+  /// \brief Run task(i) for every i in [0, count) and wait for all of them.
+  ///
+  /// The iterations run concurrently in no particular order. The task must
+  /// not throw.
+  void ParallelFor(std::size_t count,
+                   const std::function<void(std::size_t)>& task);
+
+ private:
+  struct Loop {
+    const std::function<void(std::size_t)>* task;
+    std::size_t count;
+    std::atomic<std::size_t> next{0};
+    // workers inside Run(), guarded by mutex_
+    std::size_t workers = 0;
+  };
+
+  static void Run(Loop& loop);
+  void Work();
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable worker_left_;
+  std::deque<Loop*> loops_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace detail
+
+}  // namespace prometheus
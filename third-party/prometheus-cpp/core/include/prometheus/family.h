@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -17,8 +19,11 @@
 #include "prometheus/collectable.h"
 #include "prometheus/detail/core_export.h"
 #include "prometheus/detail/future_std.h"
+#include "prometheus/detail/series_expiry.h"
+#include "prometheus/detail/series_limit.h"
 #include "prometheus/detail/utils.h"
 #include "prometheus/metric_family.h"
+#include "prometheus/series_budget.h"
 
 namespace prometheus {
 
@@ -107,6 +112,10 @@ class PROMETHEUS_CPP_CORE_EXPORT Family : public Collectable {
   /// Counter, Gauge, Histogram or Summary for required constructor arguments.
   /// \return Return the newly created dimensional data or - if a same set of
   /// labels already exists - the already existing dimensional data.
+  ///
+  /// If a max age is set with SetMaxAge(), the returned reference becomes
+  /// dangling once the dimensional data expired. Updates through it, e.g.,
+  /// Gauge::Set(), keep the data from expiring.
   template <typename... Args>
   T& Add(const std::map<std::string, std::string>& labels, Args&&... args) {
     return Add(labels, detail::make_unique<T>(args...));
@@ -118,6 +127,73 @@ class PROMETHEUS_CPP_CORE_EXPORT Family : public Collectable {
   /// if the given metric was not returned by Add().
   void Remove(T* metric);
 
+  /// \brief Expire dimensional data that has not been updated recently.
+  ///
+  /// A dimensional data counts as updated whenever it is returned by Add() or
+  /// changed through the reference Add() returned, e.g., by
+  /// Counter::Increment() or Histogram::Observe(). Such a change only sets a
+  /// relaxed atomic flag that the next sweep consumes, so the update path pays
+  /// no clock reads and takes no lock. Expired data is dropped by the sweep
+  /// that runs at the start of every Collect() or by an explicit call to
+  /// RemoveStale(), e.g., from a background thread.
+  ///
+  /// A dimensional data is never dropped before it has been idle for at least
+  /// \p max_age. It may survive up to one sweep interval longer.
+  ///
+  /// Expired dimensional data is deleted and references returned by Add() for
+  /// it become invalid. A kept reference stays valid as long as the metric is
+  /// updated more often than \p max_age.
+  ///
+  /// \param max_age Maximum time since the last update. A value of zero
+  /// disables expiry, which is the default.
+  void SetMaxAge(std::chrono::steady_clock::duration max_age);
+
+  /// \brief Remove all dimensional data older than the configured max age.
+  ///
+  /// The function does nothing, if no max age was set with SetMaxAge().
+  ///
+  /// \return The number of removed dimensional data.
+  std::size_t RemoveStale();
+
+  /// \brief Limit the number of dimensional data.
+  ///
+  /// Once the limit is reached, a new set of labels passed to Add() is folded
+  /// into the dimensional data with the labels `{overflow="true"}`, which does
+  /// not count against the limit. Existing dimensional data is not affected.
+  /// Removed or expired dimensional data makes room for new label sets again.
+  ///
+  /// \param max_series Maximum number of dimensional data. A value of zero
+  /// disables the limit, which is the default.
+  void SetMaxSeries(std::size_t max_series);
+
+  /// \brief Count the dimensional data of this family against a budget.
+  ///
+  /// A new set of labels is folded into the overflow series, see
+  /// SetMaxSeries(), if the budget is used up. Existing dimensional data is
+  /// charged to the budget, even if that exceeds it.
+  ///
+  /// \param budget Budget shared with other families, nullptr to stop
+  /// counting.
+  void SetSeriesBudget(std::shared_ptr<SeriesBudget> budget);
+
+  /// \brief Set the unit of the family, e.g., "seconds".
+  ///
+  /// The unit is exposed in the OpenMetrics format only, and only if the
+  /// name of the family ends with it as the format requires.
+  void SetUnit(const std::string& unit);
+
+  /// \brief Returns the number of label sets folded into the overflow series.
+  ///
+  /// A label set is counted once, however often it is passed to Add(). Only
+  /// a bounded number of rejected label sets is remembered, see
+  /// detail::SeriesLimit, beyond that a label set may be counted again.
+  std::uint64_t RejectedCount() const;
+
+  /// \brief Returns the number of dimensional data in this family.
+  ///
+  /// Expired dimensional data is counted until the next Collect().
+  std::size_t Size() const;
+
   /// \brief Returns the name for this family.
   ///
   /// \return The family name.
@@ -136,16 +212,26 @@ class PROMETHEUS_CPP_CORE_EXPORT Family : public Collectable {
   std::vector<MetricFamily> Collect() const override;
 
  private:
-  std::unordered_map<std::size_t, std::unique_ptr<T>> metrics_;
-  std::unordered_map<std::size_t, std::map<std::string, std::string>> labels_;
-  std::unordered_map<T*, std::size_t> labels_reverse_lookup_;
+  // mutable because Collect() sweeps expired dimensional data
+  mutable std::unordered_map<std::size_t, std::unique_ptr<T>> metrics_;
+  mutable std::unordered_map<std::size_t, std::map<std::string, std::string>>
+      labels_;
+  mutable std::unordered_map<T*, std::size_t> labels_reverse_lookup_;
+  mutable std::unordered_map<std::size_t, std::uint64_t> last_update_epochs_;
+  // unix time in milliseconds each dimensional data was added at
+  mutable std::unordered_map<std::size_t, std::int64_t> created_timestamps_ms_;
+  mutable detail::SeriesExpiry expiry_;
+  mutable detail::SeriesLimit limit_;
+  const std::size_t overflow_hash_;
 
   const std::string name_;
   const std::string help_;
+  std::string unit_;
   const std::map<std::string, std::string> constant_labels_;
   mutable std::mutex mutex_;
 
   ClientMetric CollectMetric(std::size_t hash, T* metric) const;
+  std::size_t RemoveStaleLocked() const;
   T& Add(const std::map<std::string, std::string>& labels,
          std::unique_ptr<T> object);
 };
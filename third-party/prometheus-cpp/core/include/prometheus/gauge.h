@@ -58,8 +58,19 @@ class PROMETHEUS_CPP_CORE_EXPORT Gauge {
   ClientMetric Collect() const;
 
  private:
+  template <typename T>
+  friend class Family;
+  friend class Counter;
+
   void Change(double);
+  // Returns whether the value changed since the last call, see
+  // Family<>::SetMaxAge().
+  bool ConsumeUpdate() {
+    return updated_.exchange(false, std::memory_order_relaxed);
+  }
+
   std::atomic<double> value_{0.0};
+  std::atomic<bool> updated_{false};
 };
 
 /// \brief Return a builder to configure and register a Gauge metric.
@@ -84,6 +95,8 @@ class PROMETHEUS_CPP_CORE_EXPORT Gauge {
 ///
 /// - Name(const std::string&) to set the metric name,
 /// - Help(const std::string&) to set an additional description.
+/// - Unit(const std::string&) to set the unit, e.g., "seconds". It is only
+///   exposed in the OpenMetrics format.
 /// - Label(const std::map<std::string, std::string>&) to assign a set of
 ///   key-value pairs (= labels) to the metric.
 ///
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_family.h"
+
+namespace prometheus {
+
+/// \brief The gauge values of one source, e.g., one instance of a data
+/// stream, that are always exposed together.
+///
+/// All values of a block are written with Publish() and become visible to
+/// collection at once. A concurrent Read() returns either the complete
+/// previous or the complete new set of values, never a mix of both.
+///
+/// The block keeps two buffers. Publish() fills the buffer that is not
+/// visible and then flips the epoch that selects the visible buffer. A
+/// reader neither takes a lock nor blocks the writer. It only retries in the
+/// rare case that a whole Publish() completed while it was reading.
+///
+/// Only one thread may call Publish() at a time. Read() can be called
+/// concurrently from any number of threads.
+class PROMETHEUS_CPP_CORE_EXPORT GaugeBlock {
+ public:
+  /// \brief A dimensional data of a block.
+  struct Series {
+    /// \brief Index of the family as returned by GaugeBlockGroup::AddFamily().
+    std::size_t family;
+    /// \brief Labels of the dimensional data.
+    std::map<std::string, std::string> labels;
+  };
+
+  /// \brief Create a block with a value of 0 for every series.
+  explicit GaugeBlock(std::vector<Series> series);
+
+  /// \brief Returns the number of values of this block.
+  std::size_t Size() const { return series_.size(); }
+
+  /// \brief Returns the dimensional data in the order of the values.
+  const std::vector<Series>& GetSeries() const { return series_; }
+
+  /// \brief Make a complete set of values visible.
+  ///
+  /// \param values Must hold Size() values. values[i] belongs to the i-th
+  /// series.
+  /// \param timestamp_ms Unix time in milliseconds all values were measured
+  /// at, 0 to expose them without timestamp.
+  void Publish(const double* values, std::int64_t timestamp_ms = 0);
+
+  /// @copydoc Publish(const double*, std::int64_t)
+  void Publish(const std::vector<double>& values,
+               std::int64_t timestamp_ms = 0);
+
+  /// \brief Read a consistent copy of the last published values.
+  ///
+  /// \param timestamp_ms Receives the timestamp the values were published
+  /// with, unless it is nullptr.
+  /// \return The number of completed calls to Publish() the values belong to.
+  std::uint64_t Read(std::vector<double>* values,
+                     std::int64_t* timestamp_ms = nullptr) const;
+
+ private:
+  const std::vector<Series> series_;
+  // two buffers of Size() values each, the visible one is epoch_ % 2
+  std::unique_ptr<std::atomic<double>[]> buffers_;
+  // timestamp of each buffer
+  std::atomic<std::int64_t> timestamps_ms_[2];
+  std::atomic<std::uint64_t> epoch_{0};
+};
+
+/// \brief A set of gauge families whose dimensional data is organized in
+/// blocks.
+///
+/// Each GaugeBlock may contribute series to any of the families. Collect()
+/// reads every block in a consistent state, see GaugeBlock. This is useful
+/// if values of different families are derived from the same input and must
+/// only be exposed together, e.g., a mean and the number of samples it was
+/// computed from.
+///
+/// The group is not a Registry. Register it with the exposer directly.
+///
+/// The class is thread-safe. No concurrent call to any API of this type causes
+/// a data race.
+class PROMETHEUS_CPP_CORE_EXPORT GaugeBlockGroup : public Collectable {
+ public:
+  /// \brief Add a gauge family.
+  ///
+  /// \param unit Unit of the family, see Family<>::SetUnit().
+  /// \return The index of the family to be used in GaugeBlock::Series.
+  /// \throw std::invalid_argument if the name or a label name is invalid or
+  /// a family with that name exists already.
+  std::size_t AddFamily(
+      const std::string& name, const std::string& help,
+      const std::map<std::string, std::string>& constant_labels = {},
+      const std::string& unit = "");
+
+  /// \brief Add a new block.
+  ///
+  /// The returned reference is valid until the block is removed.
+  ///
+  /// \throw std::invalid_argument if a series refers to an unknown family.
+  GaugeBlock& AddBlock(std::vector<GaugeBlock::Series> series);
+
+  /// \brief Remove the given block.
+  ///
+  /// No other thread may publish to the block concurrently. The function does
+  /// nothing if the block does not belong to this group.
+  void RemoveBlock(const GaugeBlock& block);
+
+  /// \brief Returns the number of blocks.
+  std::size_t Size() const;
+
+  /// \brief Returns a list of metrics and their samples.
+  ///
+  /// Every family added to the group is returned, in the order of their
+  /// addition. Series of a family are ordered by block.
+  std::vector<MetricFamily> Collect() const override;
+
+  /// \brief Returns the families with the given names only.
+  ///
+  /// Series of other families are not copied.
+  std::vector<MetricFamily> CollectFamilies(
+      const std::set<std::string>& names) const override;
+
+  /// \brief Returns the families of one shard only.
+  ///
+  /// Series of other families are not copied.
+  std::vector<MetricFamily> CollectShard(std::size_t shard,
+                                         std::size_t shards) const override;
+
+ private:
+  std::vector<MetricFamily> CollectSelected(
+      const std::function<bool(const std::string&)>& selected) const;
+
+  struct FamilyInfo {
+    std::string name;
+    std::string help;
+    std::map<std::string, std::string> constant_labels;
+    std::string unit;
+  };
+
+  std::vector<FamilyInfo> families_;
+  std::list<GaugeBlock> blocks_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace prometheus
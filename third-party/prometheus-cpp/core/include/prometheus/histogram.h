@@ -66,6 +66,12 @@ class PROMETHEUS_CPP_CORE_EXPORT Histogram {
   ClientMetric Collect() const;
 
  private:
+  template <typename T>
+  friend class Family;
+
+  // every observation adds to the sum
+  bool ConsumeUpdate() { return sum_.ConsumeUpdate(); }
+
   const BucketBoundaries bucket_boundaries_;
   std::vector<Counter> bucket_counts_;
   Counter sum_;
@@ -93,6 +99,8 @@ class PROMETHEUS_CPP_CORE_EXPORT Histogram {
 ///
 /// - Name(const std::string&) to set the metric name,
 /// - Help(const std::string&) to set an additional description.
+/// - Unit(const std::string&) to set the unit, e.g., "seconds". It is only
+///   exposed in the OpenMetrics format.
 /// - Label(const std::map<std::string, std::string>&) to assign a set of
 ///   key-value pairs (= labels) to the metric.
 ///
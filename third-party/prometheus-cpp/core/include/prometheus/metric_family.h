@@ -12,6 +12,7 @@ namespace prometheus {
 struct PROMETHEUS_CPP_CORE_EXPORT MetricFamily {
   std::string name;
   std::string help;
+  std::string unit;
   MetricType type = MetricType::Untyped;
   std::vector<ClientMetric> metric;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/serializer.h"
+
+namespace prometheus {
+
+/// \brief Serializes to the OpenMetrics text format.
+///
+/// In addition to the Prometheus text format the output carries the unit of
+/// a family, the creation time of counters, summaries and histograms as
+/// `_created` sample and ends with `# EOF`. Timestamps are written in
+/// seconds.
+///
+/// The samples of a counter end with `_total`. A counter family whose name
+/// does not end with `_total` gets the suffix appended to its samples. A unit
+/// is only written if the name of the family ends with it, as required by
+/// the format.
+class PROMETHEUS_CPP_CORE_EXPORT OpenMetricsSerializer : public Serializer {
+ public:
+  using Serializer::Serialize;
+  void Serialize(std::ostream& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void SerializePart(std::ostream& out,
+                     const std::vector<MetricFamily>& metrics) const override;
+  void SerializeEnd(std::ostream& out) const override;
+  std::string ContentType() const override;
+};
+
+}  // namespace prometheus
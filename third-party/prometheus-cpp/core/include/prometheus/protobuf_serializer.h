@@ -0,0 +1,30 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/serializer.h"
+
+namespace prometheus {
+
+/// \brief Serializes to the protobuf exposition format.
+///
+/// Every family is written as an io.prometheus.client.MetricFamily message
+/// prefixed by its length as varint. The messages are encoded by hand
+/// straight from the families, no generated protobuf code is involved.
+///
+/// Compared to the text format there is neither formatting of floating
+/// point numbers nor escaping of label values, and bodies are smaller.
+class PROMETHEUS_CPP_CORE_EXPORT ProtobufSerializer : public Serializer {
+ public:
+  std::string Serialize(
+      const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(std::ostream& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  std::string ContentType() const override;
+};
+
+}  // namespace prometheus
@@ -3,7 +3,9 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "prometheus/collectable.h"
@@ -14,11 +16,15 @@
 
 namespace prometheus {
 
+class ColumnarGauge;
 class Counter;
 class Gauge;
 class Histogram;
 class Summary;
 
+template <>
+class Family<ColumnarGauge>;
+
 namespace detail {
 
 template <typename T>
@@ -34,7 +40,7 @@ class Builder;
 /// that returns zero or more metrics and their samples. The metrics are
 /// represented by the class Family<>, which implements the Collectable
 /// interface. A new metric is registered with BuildCounter(), BuildGauge(),
-/// BuildHistogram() or BuildSummary().
+/// BuildColumnarGauge(), BuildHistogram() or BuildSummary().
 ///
 /// The class is thread-safe. No concurrent call to any API of this type causes
 /// a data race.
@@ -73,6 +79,48 @@ class PROMETHEUS_CPP_CORE_EXPORT Registry : public Collectable {
   /// \return Zero or more metrics and their samples.
   std::vector<MetricFamily> Collect() const override;
 
+  /// \brief Returns the metrics with the given names only.
+  ///
+  /// The families are looked up in an index by name, so only the selected
+  /// families are collected.
+  ///
+  /// \return Zero or more metrics and their samples, ordered by name.
+  std::vector<MetricFamily> CollectFamilies(
+      const std::set<std::string>& names) const override;
+
+  /// @copydoc Collectable::CollectShard()
+  ///
+  /// Families of other shards are not collected.
+  std::vector<MetricFamily> CollectShard(std::size_t shard,
+                                         std::size_t shards) const override;
+
+  /// @copydoc Collectable::CollectParallel()
+  ///
+  /// Each family is collected on its own, the result is in the same order as
+  /// the one of Collect().
+  std::vector<MetricFamily> CollectParallel(
+      detail::WorkerPool& pool) const override;
+
+  /// @copydoc Collectable::CollectChanged()
+  ///
+  /// Each family reports its changes on its own.
+  void CollectChanged(ChangeCursor& cursor, std::vector<MetricFamily>& changed,
+                      std::vector<MetricFamily>& all) const override;
+
+  /// \brief Removes a metrics family from the registry.
+  ///
+  /// Please note that this operation invalidates the previously
+  /// returned reference to the Family and all of their added
+  /// metric objects.
+  ///
+  /// \tparam T One of the metric types Counter, Gauge, ColumnarGauge,
+  /// Histogram or Summary.
+  /// \param family The family to remove
+  ///
+  /// \return True if the family was found and removed.
+  template <typename T>
+  bool Remove(const Family<T>& family);
+
  private:
   template <typename T>
   friend class detail::Builder;
@@ -90,8 +138,10 @@ class PROMETHEUS_CPP_CORE_EXPORT Registry : public Collectable {
   const InsertBehavior insert_behavior_;
   std::vector<std::unique_ptr<Family<Counter>>> counters_;
   std::vector<std::unique_ptr<Family<Gauge>>> gauges_;
+  std::vector<std::unique_ptr<Family<ColumnarGauge>>> columnar_gauges_;
   std::vector<std::unique_ptr<Family<Histogram>>> histograms_;
   std::vector<std::unique_ptr<Family<Summary>>> summaries_;
+  std::unordered_multimap<std::string, const Collectable*> families_by_name_;
   mutable std::mutex mutex_;
 };
 
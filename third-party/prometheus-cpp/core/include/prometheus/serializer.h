@@ -15,6 +15,22 @@ class PROMETHEUS_CPP_CORE_EXPORT Serializer {
   virtual std::string Serialize(const std::vector<MetricFamily>&) const;
   virtual void Serialize(std::ostream& out,
                          const std::vector<MetricFamily>& metrics) const = 0;
+
+  /// \brief Serialize families without what the format requires after the
+  /// last one.
+  ///
+  /// The output of several calls, e.g., for ranges of families serialized
+  /// concurrently, can be concatenated and finished with SerializeEnd(). The
+  /// default implementation calls Serialize().
+  virtual void SerializePart(std::ostream& out,
+                             const std::vector<MetricFamily>& metrics) const;
+
+  /// \brief Write what the format requires after the last family, nothing by
+  /// default.
+  virtual void SerializeEnd(std::ostream& out) const;
+
+  /// \brief Returns the value of the Content-Type header of the format.
+  virtual std::string ContentType() const;
 };
 
 }  // namespace prometheus
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+/// \brief A number of dimensional data shared by several families.
+///
+/// Families that share a budget together never hold more dimensional data
+/// than the budget allows, no matter how many families there are. See
+/// Family<T>::SetSeriesBudget().
+///
+/// The class is thread-safe. No concurrent call to any API of this type causes
+/// a data race.
+class PROMETHEUS_CPP_CORE_EXPORT SeriesBudget {
+ public:
+  /// \brief Create a budget.
+  ///
+  /// \param max_series Maximum number of dimensional data of all families
+  /// sharing the budget.
+  explicit SeriesBudget(std::size_t max_series);
+
+  /// \brief Take one dimensional data from the budget.
+  ///
+  /// \return False if the budget is used up.
+  bool Acquire();
+
+  /// \brief Account for dimensional data that exists already.
+  ///
+  /// Unlike Acquire() this never fails, the budget may be exceeded afterwards.
+  void Charge(std::size_t count);
+
+  /// \brief Give dimensional data back to the budget.
+  void Release(std::size_t count);
+
+  /// \brief Returns the number of dimensional data taken from the budget.
+  std::size_t Used() const;
+
+  /// \brief Returns the maximum number of dimensional data.
+  std::size_t Max() const { return max_series_; }
+
+ private:
+  const std::size_t max_series_;
+  std::atomic<std::size_t> used_{0};
+};
+
+}  // namespace prometheus
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <mutex>
@@ -84,11 +85,19 @@ class PROMETHEUS_CPP_CORE_EXPORT Summary {
   ClientMetric Collect() const;
 
  private:
+  template <typename T>
+  friend class Family;
+
+  bool ConsumeUpdate() {
+    return updated_.exchange(false, std::memory_order_relaxed);
+  }
+
   const Quantiles quantiles_;
   mutable std::mutex mutex_;
   std::uint64_t count_;
   double sum_;
   detail::TimeWindowQuantiles quantile_values_;
+  std::atomic<bool> updated_{false};
 };
 
 /// \brief Return a builder to configure and register a Summary metric.
@@ -113,6 +122,8 @@ class PROMETHEUS_CPP_CORE_EXPORT Summary {
 ///
 /// - Name(const std::string&) to set the metric name,
 /// - Help(const std::string&) to set an additional description.
+/// - Unit(const std::string&) to set the unit, e.g., "seconds". It is only
+///   exposed in the OpenMetrics format.
 /// - Label(const std::map<std::string, std::string>&) to assign a set of
 ///   key-value pairs (= labels) to the metric.
 ///
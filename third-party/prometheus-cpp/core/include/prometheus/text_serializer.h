@@ -15,6 +15,7 @@ class PROMETHEUS_CPP_CORE_EXPORT TextSerializer : public Serializer {
   using Serializer::Serialize;
   void Serialize(std::ostream& out,
                  const std::vector<MetricFamily>& metrics) const override;
+  std::string ContentType() const override;
 };
 
 }  // namespace prometheus
@@ -0,0 +1,48 @@
+#include "prometheus/collectable.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "prometheus/detail/utils.h"
+#include "prometheus/metric_family.h"
+
+namespace prometheus {
+
+std::vector<MetricFamily> Collectable::CollectFamilies(
+    const std::set<std::string>& names) const {
+  auto families = Collect();
+  auto not_selected = [&names](const MetricFamily& family) {
+    return names.count(family.name) == 0;
+  };
+  families.erase(
+      std::remove_if(families.begin(), families.end(), not_selected),
+      families.end());
+  return families;
+}
+
+std::vector<MetricFamily> Collectable::CollectShard(std::size_t shard,
+                                                    std::size_t shards) const {
+  auto families = Collect();
+  auto not_selected = [shard, shards](const MetricFamily& family) {
+    return detail::shard_of(family.name, shards) != shard;
+  };
+  families.erase(
+      std::remove_if(families.begin(), families.end(), not_selected),
+      families.end());
+  return families;
+}
+
+std::vector<MetricFamily> Collectable::CollectParallel(
+    detail::WorkerPool& /* pool */) const {
+  return Collect();
+}
+
+void Collectable::CollectChanged(ChangeCursor& /* cursor */,
+                                 std::vector<MetricFamily>& /* changed */,
+                                 std::vector<MetricFamily>& all) const {
+  auto metrics = Collect();
+  all.insert(all.end(), std::make_move_iterator(metrics.begin()),
+             std::make_move_iterator(metrics.end()));
+}
+
+}  // namespace prometheus
@@ -0,0 +1,373 @@
+#include "prometheus/columnar_gauge.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "prometheus/check_names.h"
+#include "prometheus/detail/utils.h"
+
+namespace prometheus {
+
+constexpr Family<ColumnarGauge>::Handle Family<ColumnarGauge>::kInvalidHandle;
+
+namespace {
+std::atomic<std::uint64_t> next_instance{1};
+}  // namespace
+
+Family<ColumnarGauge>::Family(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& constant_labels)
+    : overflow_hash_(
+          detail::hash_labels(detail::SeriesLimit::OverflowLabels())),
+      instance_(next_instance.fetch_add(1, std::memory_order_relaxed)),
+      name_(name),
+      help_(help),
+      constant_labels_(constant_labels) {
+  assert(CheckMetricName(name_));
+}
+
+Family<ColumnarGauge>::Handle Family<ColumnarGauge>::Add(
+    const std::map<std::string, std::string>& labels) {
+  auto hash = detail::hash_labels(labels);
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto slot_iter = slots_by_hash_.find(hash);
+  const auto* series_labels = &labels;
+
+  if (slot_iter == slots_by_hash_.end() && hash != overflow_hash_ &&
+      !limit_.Admit(hash)) {
+    // fold the new set of labels into the overflow series
+    hash = overflow_hash_;
+    series_labels = &detail::SeriesLimit::OverflowLabels();
+    slot_iter = slots_by_hash_.find(hash);
+  }
+
+  if (slot_iter != slots_by_hash_.end()) {
+    const auto slot = slot_iter->second;
+    assert(*series_labels == labels_[slot]);
+    last_update_epochs_[slot] = expiry_.Epoch();
+    return MakeHandle(slot);
+  }
+
+#ifndef NDEBUG
+  for (auto& label_pair : *series_labels) {
+    auto& label_name = label_pair.first;
+    assert(CheckLabelName(label_name));
+  }
+#endif
+
+  Slot slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    assert(values_.size() < std::numeric_limits<Slot>::max());
+    slot = static_cast<Slot>(values_.size());
+    values_.push_back(0.0);
+    timestamps_ms_.push_back(0);
+    last_update_epochs_.push_back(0);
+    generations_.push_back(0);
+    in_use_.push_back(0);
+    label_hashes_.push_back(0);
+    labels_.emplace_back();
+    change_sequences_.push_back(0);
+  }
+
+  values_[slot] = 0.0;
+  timestamps_ms_[slot] = 0;
+  change_sequences_[slot] = ++change_sequence_;
+  last_update_epochs_[slot] = expiry_.Epoch();
+  in_use_[slot] = 1;
+  label_hashes_[slot] = hash;
+  labels_[slot] = *series_labels;
+  slots_by_hash_.insert({hash, slot});
+  return MakeHandle(slot);
+}
+
+void Family<ColumnarGauge>::Remove(Handle handle) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  Slot slot;
+  if (!Resolve(handle, &slot)) {
+    return;
+  }
+  FreeSlot(slot);
+}
+
+bool Family<ColumnarGauge>::Set(Handle handle, double value,
+                                std::int64_t timestamp_ms) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  Slot slot;
+  if (!Resolve(handle, &slot)) {
+    return false;
+  }
+  SetLocked(slot, value, timestamp_ms, expiry_.Epoch());
+  return true;
+}
+
+std::size_t Family<ColumnarGauge>::Set(const Handle* handles,
+                                      const double* values,
+                                      std::size_t count,
+                                      std::int64_t timestamp_ms) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto epoch = expiry_.Epoch();
+  std::size_t applied = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    Slot slot;
+    if (!Resolve(handles[i], &slot)) {
+      continue;
+    }
+    SetLocked(slot, values[i], timestamp_ms, epoch);
+    ++applied;
+  }
+  return applied;
+}
+
+double Family<ColumnarGauge>::Value(Handle handle) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  Slot slot;
+  if (!Resolve(handle, &slot)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return values_[slot];
+}
+
+void Family<ColumnarGauge>::SetMaxAge(
+    std::chrono::steady_clock::duration max_age) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  expiry_.SetMaxAge(max_age);
+}
+
+std::size_t Family<ColumnarGauge>::RemoveStale() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return RemoveStaleLocked();
+}
+
+void Family<ColumnarGauge>::SetMaxSeries(std::size_t max_series) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  limit_.SetMaxSeries(max_series);
+}
+
+void Family<ColumnarGauge>::SetSeriesBudget(
+    std::shared_ptr<SeriesBudget> budget) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  limit_.SetBudget(std::move(budget));
+}
+
+void Family<ColumnarGauge>::SetUnit(const std::string& unit) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  unit_ = unit;
+}
+
+std::uint64_t Family<ColumnarGauge>::RejectedCount() const {
+  return limit_.Rejected();
+}
+
+std::size_t Family<ColumnarGauge>::Size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return slots_by_hash_.size();
+}
+
+const std::string& Family<ColumnarGauge>::GetName() const { return name_; }
+
+const std::map<std::string, std::string>
+Family<ColumnarGauge>::GetConstantLabels() const {
+  return constant_labels_;
+}
+
+std::vector<MetricFamily> Family<ColumnarGauge>::Collect() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  RemoveStaleLocked();
+  return {CollectLocked(0)};
+}
+
+std::uint64_t Family<ColumnarGauge>::ChangeSequence() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return change_sequence_;
+}
+
+std::vector<MetricFamily> Family<ColumnarGauge>::CollectChangedSince(
+    std::uint64_t since, std::uint64_t* sequence) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  RemoveStaleLocked();
+  *sequence = change_sequence_;
+  if (change_sequence_ <= since) {
+    return {};
+  }
+  return {CollectLocked(since)};
+}
+
+void Family<ColumnarGauge>::CollectChanged(
+    ChangeCursor& cursor, std::vector<MetricFamily>& changed,
+    std::vector<MetricFamily>& /* all */) const {
+  auto& position = cursor.positions[this];
+  if (position.instance != instance_) {
+    position.instance = instance_;
+    position.sequence = 0;
+  }
+  position.pass = cursor.pass;
+  auto metrics =
+      CollectChangedSince(cursor.all ? 0 : position.sequence,
+                          &position.sequence);
+  changed.insert(changed.end(), std::make_move_iterator(metrics.begin()),
+                 std::make_move_iterator(metrics.end()));
+}
+
+MetricFamily Family<ColumnarGauge>::CollectLocked(std::uint64_t since) const {
+  auto family = MetricFamily{};
+  family.name = name_;
+  family.help = help_;
+  family.unit = unit_;
+  family.type = ColumnarGauge::metric_type;
+  if (since == 0) {
+    family.metric.reserve(slots_by_hash_.size());
+  }
+
+  auto add_label = [](ClientMetric& collected,
+                      const std::pair<const std::string, std::string>& pair) {
+    auto label = ClientMetric::Label{};
+    label.name = pair.first;
+    label.value = pair.second;
+    collected.label.push_back(std::move(label));
+  };
+
+  for (std::size_t slot = 0; slot < values_.size(); ++slot) {
+    if (!in_use_[slot] || change_sequences_[slot] <= since) {
+      continue;
+    }
+    auto collected = ClientMetric{};
+    collected.gauge.value = values_[slot];
+    collected.timestamp_ms = timestamps_ms_[slot];
+    collected.label.reserve(constant_labels_.size() + labels_[slot].size());
+    for (auto& label_pair : constant_labels_) {
+      add_label(collected, label_pair);
+    }
+    for (auto& label_pair : labels_[slot]) {
+      add_label(collected, label_pair);
+    }
+    family.metric.push_back(std::move(collected));
+  }
+  return family;
+}
+
+std::size_t ColumnarGaugeBatch::Add(Family<ColumnarGauge>& family,
+                                    Family<ColumnarGauge>::Handle handle) {
+  const auto position = handles_.size();
+  handles_.push_back(handle);
+  if (!runs_.empty() && runs_.back().family == &family) {
+    runs_.back().end = handles_.size();
+  } else {
+    runs_.push_back({&family, position, handles_.size()});
+  }
+  return position;
+}
+
+void ColumnarGaugeBatch::Clear() {
+  runs_.clear();
+  handles_.clear();
+}
+
+std::size_t ColumnarGaugeBatch::Set(const double* values,
+                                    std::int64_t timestamp_ms) const {
+  std::size_t applied = 0;
+  for (const auto& run : runs_) {
+    applied +=
+        run.family->Set(handles_.data() + run.begin, values + run.begin,
+                        run.end - run.begin, timestamp_ms);
+  }
+  return applied;
+}
+
+std::size_t ColumnarGaugeBatch::Set(const std::vector<double>& values,
+                                    std::int64_t timestamp_ms) const {
+  assert(values.size() == handles_.size());
+  return Set(values.data(), timestamp_ms);
+}
+
+std::size_t ColumnarGaugeBatch::SetChanged(const double* values,
+                                           const double* previous,
+                                           std::int64_t timestamp_ms) const {
+  std::size_t applied = 0;
+  for (const auto& run : runs_) {
+    changed_handles_.clear();
+    changed_values_.clear();
+    for (auto i = run.begin; i < run.end; ++i) {
+      if (values[i] == previous[i] ||
+          (std::isnan(values[i]) && std::isnan(previous[i]))) {
+        ++applied;
+        continue;
+      }
+      changed_handles_.push_back(handles_[i]);
+      changed_values_.push_back(values[i]);
+    }
+    if (!changed_handles_.empty()) {
+      applied += run.family->Set(changed_handles_.data(),
+                                 changed_values_.data(),
+                                 changed_handles_.size(), timestamp_ms);
+    }
+  }
+  return applied;
+}
+
+bool Family<ColumnarGauge>::Resolve(Handle handle, Slot* slot) const {
+  const auto index = static_cast<Slot>(handle & 0xffffffffu);
+  const auto generation = static_cast<std::uint32_t>(handle >> 32);
+  if (index >= values_.size() || !in_use_[index] ||
+      generations_[index] != generation) {
+    return false;
+  }
+  *slot = index;
+  return true;
+}
+
+void Family<ColumnarGauge>::SetLocked(Slot slot, double value,
+                                      std::int64_t timestamp_ms,
+                                      std::uint64_t epoch) {
+  last_update_epochs_[slot] = epoch;
+  timestamps_ms_[slot] = timestamp_ms;
+  // NaN never compares equal, but setting NaN again is no change either
+  if (values_[slot] == value ||
+      (std::isnan(values_[slot]) && std::isnan(value))) {
+    return;
+  }
+  values_[slot] = value;
+  change_sequences_[slot] = ++change_sequence_;
+}
+
+Family<ColumnarGauge>::Handle Family<ColumnarGauge>::MakeHandle(
+    Slot slot) const {
+  return (static_cast<Handle>(generations_[slot]) << 32) | slot;
+}
+
+void Family<ColumnarGauge>::FreeSlot(Slot slot) const {
+  if (label_hashes_[slot] != overflow_hash_) {
+    limit_.Release();
+  }
+  slots_by_hash_.erase(label_hashes_[slot]);
+  labels_[slot].clear();
+  in_use_[slot] = 0;
+  // outstanding handles of this slot must not match the next occupant
+  ++generations_[slot];
+  free_slots_.push_back(slot);
+}
+
+std::size_t Family<ColumnarGauge>::RemoveStaleLocked() const {
+  if (!expiry_.BeginSweep()) {
+    return 0;
+  }
+
+  std::size_t removed = 0;
+  for (std::size_t slot = 0; slot < values_.size(); ++slot) {
+    if (in_use_[slot] && expiry_.IsStale(last_update_epochs_[slot])) {
+      FreeSlot(static_cast<Slot>(slot));
+      ++removed;
+    }
+  }
+
+  expiry_.EndSweep();
+  return removed;
+}
+
+}  // namespace prometheus
@@ -1,5 +1,6 @@
 #include "prometheus/detail/builder.h"
 
+#include "prometheus/columnar_gauge.h"
 #include "prometheus/counter.h"
 #include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
@@ -29,13 +30,24 @@ Builder<T>& Builder<T>::Help(const std::string& help) {
   return *this;
 }
 
+template <typename T>
+Builder<T>& Builder<T>::Unit(const std::string& unit) {
+  unit_ = unit;
+  return *this;
+}
+
 template <typename T>
 Family<T>& Builder<T>::Register(Registry& registry) {
-  return registry.Add<T>(name_, help_, labels_);
+  auto& family = registry.Add<T>(name_, help_, labels_);
+  if (!unit_.empty()) {
+    family.SetUnit(unit_);
+  }
+  return family;
 }
 
 template class PROMETHEUS_CPP_CORE_EXPORT Builder<Counter>;
 template class PROMETHEUS_CPP_CORE_EXPORT Builder<Gauge>;
+template class PROMETHEUS_CPP_CORE_EXPORT Builder<ColumnarGauge>;
 template class PROMETHEUS_CPP_CORE_EXPORT Builder<Histogram>;
 template class PROMETHEUS_CPP_CORE_EXPORT Builder<Summary>;
 
@@ -43,6 +55,7 @@ template class PROMETHEUS_CPP_CORE_EXPORT Builder<Summary>;
 
 detail::Builder<Counter> BuildCounter() { return {}; }
 detail::Builder<Gauge> BuildGauge() { return {}; }
+detail::Builder<ColumnarGauge> BuildColumnarGauge() { return {}; }
 detail::Builder<Histogram> BuildHistogram() { return {}; }
 detail::Builder<Summary> BuildSummary() { return {}; }
 
@@ -0,0 +1,39 @@
+#include "prometheus/detail/series_expiry.h"
+
+namespace prometheus {
+
+namespace detail {
+
+void SeriesExpiry::SetMaxAge(Clock::duration max_age) { max_age_ = max_age; }
+
+bool SeriesExpiry::BeginSweep() {
+  if (!Enabled()) {
+    return false;
+  }
+
+  // close the current epoch, everything touched from now on is newer
+  const auto now = Clock::now();
+  epoch_end_times_.push_back(now);
+  ++epoch_;
+  cutoff_ = now - max_age_;
+  return true;
+}
+
+bool SeriesExpiry::IsStale(std::uint64_t epoch) const {
+  // Data last touched in an epoch was updated no later than the end of it.
+  // Epochs before first_epoch_ were dropped because they ended even earlier.
+  return epoch < first_epoch_ ||
+         epoch_end_times_.at(epoch - first_epoch_) < cutoff_;
+}
+
+void SeriesExpiry::EndSweep() {
+  // all data touched in epochs ended before the cutoff is gone now
+  while (!epoch_end_times_.empty() && epoch_end_times_.front() < cutoff_) {
+    epoch_end_times_.pop_front();
+    ++first_epoch_;
+  }
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
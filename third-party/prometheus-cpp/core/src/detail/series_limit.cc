@@ -0,0 +1,57 @@
+#include "prometheus/detail/series_limit.h"
+
+#include <utility>
+
+namespace prometheus {
+
+namespace detail {
+
+SeriesLimit::~SeriesLimit() {
+  if (budget_) {
+    budget_->Release(admitted_);
+  }
+}
+
+const std::map<std::string, std::string>& SeriesLimit::OverflowLabels() {
+  static const std::map<std::string, std::string> labels{
+      {"overflow", "true"}};
+  return labels;
+}
+
+void SeriesLimit::SetBudget(std::shared_ptr<SeriesBudget> budget) {
+  if (budget_) {
+    budget_->Release(admitted_);
+  }
+  budget_ = std::move(budget);
+  if (budget_) {
+    budget_->Charge(admitted_);
+  }
+}
+
+constexpr std::size_t SeriesLimit::kMaxRememberedRejections;
+
+bool SeriesLimit::Admit(std::size_t hash) {
+  if ((max_series_ != 0 && admitted_ >= max_series_) ||
+      (budget_ && !budget_->Acquire())) {
+    if (rejected_hashes_.size() >= kMaxRememberedRejections) {
+      rejected_hashes_.clear();
+    }
+    if (rejected_hashes_.insert(hash).second) {
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return false;
+  }
+  ++admitted_;
+  return true;
+}
+
+void SeriesLimit::Release() {
+  --admitted_;
+  if (budget_) {
+    budget_->Release(1);
+  }
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
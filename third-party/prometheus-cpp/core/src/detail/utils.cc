@@ -1,6 +1,7 @@
 #include "prometheus/detail/utils.h"
 #include "hash.h"
 
+#include <cstdint>
 #include <numeric>
 
 namespace prometheus {
@@ -16,6 +17,16 @@ std::size_t hash_labels(const std::map<std::string, std::string>& labels) {
   return seed;
 }
 
+std::size_t shard_of(const std::string& name, std::size_t shards) {
+  // FNV-1a, std::hash differs between standard libraries
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (auto c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<std::size_t>(hash % shards);
+}
+
 }  // namespace detail
 
 }  // namespace prometheus
@@ -0,0 +1,89 @@
+#include "prometheus/detail/worker_pool.h"
+
+#include <algorithm>
+
+namespace prometheus {
+
+namespace detail {
+
+WorkerPool::WorkerPool(std::size_t num_threads) {
+  threads_.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&WorkerPool::Work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::ParallelFor(std::size_t count,
+                             const std::function<void(std::size_t)>& task) {
+  if (threads_.empty() || count < 2) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  Loop loop;
+  loop.task = &task;
+  loop.count = count;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    loops_.push_back(&loop);
+  }
+  work_available_.notify_all();
+
+  Run(loop);
+
+  // every iteration is claimed, wait for the workers still running one
+  std::unique_lock<std::mutex> lock{mutex_};
+  auto queued = std::find(loops_.begin(), loops_.end(), &loop);
+  if (queued != loops_.end()) {
+    loops_.erase(queued);
+  }
+  worker_left_.wait(lock, [&loop] { return loop.workers == 0; });
+}
+
+void WorkerPool::Run(Loop& loop) {
+  for (auto i = loop.next.fetch_add(1); i < loop.count;
+       i = loop.next.fetch_add(1)) {
+    (*loop.task)(i);
+  }
+}
+
+void WorkerPool::Work() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    work_available_.wait(lock, [this] { return stop_ || !loops_.empty(); });
+    if (stop_) {
+      return;
+    }
+
+    auto& loop = *loops_.front();
+    // no one else has to look at a loop without unclaimed iterations
+    if (loop.next.load() >= loop.count) {
+      loops_.pop_front();
+      continue;
+    }
+    ++loop.workers;
+    lock.unlock();
+    Run(loop);
+    lock.lock();
+    if (--loop.workers == 0) {
+      worker_left_.notify_all();
+    }
+  }
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -7,10 +7,22 @@
 
 namespace prometheus {
 
+namespace {
+std::int64_t UnixTimeMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
 template <typename T>
 Family<T>::Family(const std::string& name, const std::string& help,
                   const std::map<std::string, std::string>& constant_labels)
-    : name_(name), help_(help), constant_labels_(constant_labels) {
+    : overflow_hash_(
+          detail::hash_labels(detail::SeriesLimit::OverflowLabels())),
+      name_(name),
+      help_(help),
+      constant_labels_(constant_labels) {
   assert(CheckMetricName(name_));
 }
 
@@ -20,18 +32,30 @@ T& Family<T>::Add(const std::map<std::string, std::string>& labels,
   auto hash = detail::hash_labels(labels);
   std::lock_guard<std::mutex> lock{mutex_};
   auto metrics_iter = metrics_.find(hash);
+  const auto* series_labels = &labels;
+
+  if (metrics_iter == metrics_.end() && hash != overflow_hash_ &&
+      !limit_.Admit(hash)) {
+    // fold the new set of labels into the overflow series
+    hash = overflow_hash_;
+    series_labels = &detail::SeriesLimit::OverflowLabels();
+    metrics_iter = metrics_.find(hash);
+  }
 
   if (metrics_iter != metrics_.end()) {
 #ifndef NDEBUG
     auto labels_iter = labels_.find(hash);
     assert(labels_iter != labels_.end());
     const auto& old_labels = labels_iter->second;
-    assert(labels == old_labels);
+    assert(*series_labels == old_labels);
 #endif
+    if (expiry_.Enabled()) {
+      last_update_epochs_[hash] = expiry_.Epoch();
+    }
     return *metrics_iter->second;
   } else {
 #ifndef NDEBUG
-    for (auto& label_pair : labels) {
+    for (auto& label_pair : *series_labels) {
       auto& label_name = label_pair.first;
       assert(CheckLabelName(label_name));
     }
@@ -39,8 +63,10 @@ T& Family<T>::Add(const std::map<std::string, std::string>& labels,
 
     auto metric = metrics_.insert(std::make_pair(hash, std::move(object)));
     assert(metric.second);
-    labels_.insert({hash, labels});
+    labels_.insert({hash, *series_labels});
     labels_reverse_lookup_.insert({metric.first->second.get(), hash});
+    last_update_epochs_.insert({hash, expiry_.Epoch()});
+    created_timestamps_ms_.insert({hash, UnixTimeMs()});
     return *(metric.first->second);
   }
 }
@@ -53,9 +79,88 @@ void Family<T>::Remove(T* metric) {
   }
 
   auto hash = labels_reverse_lookup_.at(metric);
+  if (hash != overflow_hash_) {
+    limit_.Release();
+  }
   metrics_.erase(hash);
   labels_.erase(hash);
   labels_reverse_lookup_.erase(metric);
+  last_update_epochs_.erase(hash);
+  created_timestamps_ms_.erase(hash);
+}
+
+template <typename T>
+void Family<T>::SetMaxAge(std::chrono::steady_clock::duration max_age) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  expiry_.SetMaxAge(max_age);
+}
+
+template <typename T>
+std::size_t Family<T>::RemoveStale() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return RemoveStaleLocked();
+}
+
+template <typename T>
+std::size_t Family<T>::RemoveStaleLocked() const {
+  if (!expiry_.BeginSweep()) {
+    return 0;
+  }
+
+  std::size_t removed = 0;
+  for (auto it = last_update_epochs_.begin();
+       it != last_update_epochs_.end();) {
+    // updated through a kept reference in the epoch just closed
+    if (metrics_.at(it->first)->ConsumeUpdate()) {
+      it->second = expiry_.Epoch() - 1;
+    }
+    if (!expiry_.IsStale(it->second)) {
+      ++it;
+      continue;
+    }
+    if (it->first != overflow_hash_) {
+      limit_.Release();
+    }
+    auto metrics_iter = metrics_.find(it->first);
+    labels_reverse_lookup_.erase(metrics_iter->second.get());
+    metrics_.erase(metrics_iter);
+    labels_.erase(it->first);
+    created_timestamps_ms_.erase(it->first);
+    it = last_update_epochs_.erase(it);
+    ++removed;
+  }
+
+  expiry_.EndSweep();
+  return removed;
+}
+
+template <typename T>
+void Family<T>::SetMaxSeries(std::size_t max_series) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  limit_.SetMaxSeries(max_series);
+}
+
+template <typename T>
+void Family<T>::SetSeriesBudget(std::shared_ptr<SeriesBudget> budget) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  limit_.SetBudget(std::move(budget));
+}
+
+template <typename T>
+void Family<T>::SetUnit(const std::string& unit) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  unit_ = unit;
+}
+
+template <typename T>
+std::uint64_t Family<T>::RejectedCount() const {
+  return limit_.Rejected();
+}
+
+template <typename T>
+std::size_t Family<T>::Size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return metrics_.size();
 }
 
 template <typename T>
@@ -71,9 +176,11 @@ const std::map<std::string, std::string> Family<T>::GetConstantLabels() const {
 template <typename T>
 std::vector<MetricFamily> Family<T>::Collect() const {
   std::lock_guard<std::mutex> lock{mutex_};
+  RemoveStaleLocked();
   auto family = MetricFamily{};
   family.name = name_;
   family.help = help_;
+  family.unit = unit_;
   family.type = T::metric_type;
   for (const auto& m : metrics_) {
     family.metric.push_back(std::move(CollectMetric(m.first, m.second.get())));
@@ -84,6 +191,9 @@ std::vector<MetricFamily> Family<T>::Collect() const {
 template <typename T>
 ClientMetric Family<T>::CollectMetric(std::size_t hash, T* metric) const {
   auto collected = metric->Collect();
+  if (T::metric_type != MetricType::Gauge) {
+    collected.created_timestamp_ms = created_timestamps_ms_.at(hash);
+  }
   auto add_label =
       [&collected](const std::pair<std::string, std::string>& label_pair) {
         auto label = ClientMetric::Label{};
@@ -24,12 +24,16 @@ void Gauge::Decrement(const double value) {
   Change(-1.0 * value);
 }
 
-void Gauge::Set(const double value) { value_.store(value); }
+void Gauge::Set(const double value) {
+  value_.store(value);
+  updated_.store(true, std::memory_order_relaxed);
+}
 
 void Gauge::Change(const double value) {
   auto current = value_.load();
   while (!value_.compare_exchange_weak(current, current + value))
     ;
+  updated_.store(true, std::memory_order_relaxed);
 }
 
 void Gauge::SetToCurrentTime() {
@@ -0,0 +1,200 @@
+#include "prometheus/gauge_block.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "prometheus/check_names.h"
+#include "prometheus/client_metric.h"
+#include "prometheus/detail/utils.h"
+
+namespace prometheus {
+
+GaugeBlock::GaugeBlock(std::vector<Series> series)
+    : series_(std::move(series)),
+      buffers_(new std::atomic<double>[2 * series_.size()]) {
+  for (std::size_t i = 0; i < 2 * series_.size(); ++i) {
+    buffers_[i].store(0.0, std::memory_order_relaxed);
+  }
+  timestamps_ms_[0].store(0, std::memory_order_relaxed);
+  timestamps_ms_[1].store(0, std::memory_order_relaxed);
+}
+
+void GaugeBlock::Publish(const double* values, std::int64_t timestamp_ms) {
+  const auto epoch = epoch_.load(std::memory_order_relaxed);
+  // keeps the stores below after the previous flip, a reader of this buffer
+  // that sees one of them also sees the flip and retries
+  std::atomic_thread_fence(std::memory_order_release);
+  auto* buffer = &buffers_[((epoch + 1) % 2) * series_.size()];
+  for (std::size_t i = 0; i < series_.size(); ++i) {
+    buffer[i].store(values[i], std::memory_order_relaxed);
+  }
+  timestamps_ms_[(epoch + 1) % 2].store(timestamp_ms,
+                                        std::memory_order_relaxed);
+  epoch_.store(epoch + 1, std::memory_order_release);
+}
+
+void GaugeBlock::Publish(const std::vector<double>& values,
+                         std::int64_t timestamp_ms) {
+  assert(values.size() == series_.size());
+  Publish(values.data(), timestamp_ms);
+}
+
+std::uint64_t GaugeBlock::Read(std::vector<double>* values,
+                               std::int64_t* timestamp_ms) const {
+  values->resize(series_.size());
+  for (;;) {
+    const auto epoch = epoch_.load(std::memory_order_acquire);
+    const auto* buffer = &buffers_[(epoch % 2) * series_.size()];
+    for (std::size_t i = 0; i < series_.size(); ++i) {
+      (*values)[i] = buffer[i].load(std::memory_order_relaxed);
+    }
+    const auto timestamp =
+        timestamps_ms_[epoch % 2].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the buffer is only written again after the next flip
+    if (epoch_.load(std::memory_order_relaxed) == epoch) {
+      if (timestamp_ms) {
+        *timestamp_ms = timestamp;
+      }
+      return epoch;
+    }
+  }
+}
+
+std::size_t GaugeBlockGroup::AddFamily(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& constant_labels,
+    const std::string& unit) {
+  if (!CheckMetricName(name)) {
+    throw std::invalid_argument("Invalid metric name");
+  }
+  for (auto& label_pair : constant_labels) {
+    if (!CheckLabelName(label_pair.first)) {
+      throw std::invalid_argument("Invalid label name");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto same_name = [&name](const FamilyInfo& family) {
+    return family.name == name;
+  };
+  if (std::any_of(families_.begin(), families_.end(), same_name)) {
+    throw std::invalid_argument("Family name already exists");
+  }
+  families_.push_back({name, help, constant_labels, unit});
+  return families_.size() - 1;
+}
+
+GaugeBlock& GaugeBlockGroup::AddBlock(std::vector<GaugeBlock::Series> series) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (auto& s : series) {
+    if (s.family >= families_.size()) {
+      throw std::invalid_argument("Unknown family");
+    }
+#ifndef NDEBUG
+    for (auto& label_pair : s.labels) {
+      assert(CheckLabelName(label_pair.first));
+    }
+#endif
+  }
+  blocks_.emplace_back(std::move(series));
+  return blocks_.back();
+}
+
+void GaugeBlockGroup::RemoveBlock(const GaugeBlock& block) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+    if (&*it == &block) {
+      blocks_.erase(it);
+      return;
+    }
+  }
+}
+
+std::size_t GaugeBlockGroup::Size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return blocks_.size();
+}
+
+std::vector<MetricFamily> GaugeBlockGroup::Collect() const {
+  return CollectSelected(nullptr);
+}
+
+std::vector<MetricFamily> GaugeBlockGroup::CollectFamilies(
+    const std::set<std::string>& names) const {
+  return CollectSelected([&names](const std::string& name) {
+    return names.count(name) != 0;
+  });
+}
+
+std::vector<MetricFamily> GaugeBlockGroup::CollectShard(
+    std::size_t shard, std::size_t shards) const {
+  return CollectSelected([shard, shards](const std::string& name) {
+    return detail::shard_of(name, shards) == shard;
+  });
+}
+
+std::vector<MetricFamily> GaugeBlockGroup::CollectSelected(
+    const std::function<bool(const std::string&)>& selected) const {
+  static const auto kNotSelected = std::numeric_limits<std::size_t>::max();
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto collected = std::vector<MetricFamily>{};
+  // position of each family in the result
+  auto positions = std::vector<std::size_t>(families_.size(), kNotSelected);
+  for (std::size_t f = 0; f < families_.size(); ++f) {
+    const auto& info = families_[f];
+    if (selected && !selected(info.name)) {
+      continue;
+    }
+    positions[f] = collected.size();
+    auto family = MetricFamily{};
+    family.name = info.name;
+    family.help = info.help;
+    family.unit = info.unit;
+    family.type = MetricType::Gauge;
+    collected.push_back(std::move(family));
+  }
+  if (collected.empty()) {
+    return collected;
+  }
+
+  auto add_label = [](ClientMetric& metric,
+                      const std::pair<const std::string, std::string>& pair) {
+    auto label = ClientMetric::Label{};
+    label.name = pair.first;
+    label.value = pair.second;
+    metric.label.push_back(std::move(label));
+  };
+
+  std::vector<double> values;
+  for (auto& block : blocks_) {
+    std::int64_t timestamp_ms;
+    block.Read(&values, &timestamp_ms);
+    const auto& series = block.GetSeries();
+    for (std::size_t i = 0; i < series.size(); ++i) {
+      const auto position = positions[series[i].family];
+      if (position == kNotSelected) {
+        continue;
+      }
+      const auto& info = families_[series[i].family];
+      auto metric = ClientMetric{};
+      metric.gauge.value = values[i];
+      metric.timestamp_ms = timestamp_ms;
+      metric.label.reserve(info.constant_labels.size() +
+                           series[i].labels.size());
+      for (auto& label_pair : info.constant_labels) {
+        add_label(metric, label_pair);
+      }
+      for (auto& label_pair : series[i].labels) {
+        add_label(metric, label_pair);
+      }
+      collected[position].metric.push_back(std::move(metric));
+    }
+  }
+  return collected;
+}
+
+}  // namespace prometheus
@@ -0,0 +1,287 @@
+#include "prometheus/openmetrics_serializer.h"
+
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <ostream>
+
+namespace prometheus {
+
+namespace {
+
+const std::string kTotalSuffix = "_total";
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Format a double with the fewest digits that read back as the same value
+std::string FormatValue(double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  if (std::isinf(value)) {
+    return value < 0 ? "-Inf" : "+Inf";
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+  if (std::strtod(buffer, nullptr) != value) {
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  }
+  // printf and strtod follow the global C locale, the format does not
+  auto* point = std::strchr(buffer, *std::localeconv()->decimal_point);
+  if (point) {
+    *point = '.';
+  }
+  return buffer;
+}
+
+void WriteValue(std::ostream& out, double value) { out << FormatValue(value); }
+
+// Bucket bounds and quantiles are label values, the format recommends
+// floating point notation for them, e.g., 1.0 instead of 1
+std::string FormatFloatLabel(double value) {
+  auto formatted = FormatValue(value);
+  if (formatted.find_first_of(".eEnI") == std::string::npos) {
+    formatted += ".0";
+  }
+  return formatted;
+}
+
+void WriteEscaped(std::ostream& out, const std::string& value) {
+  for (auto c : value) {
+    switch (c) {
+      case '\n':
+        out << '\\' << 'n';
+        break;
+
+      case '\\':
+        out << '\\' << c;
+        break;
+
+      case '"':
+        out << '\\' << c;
+        break;
+
+      default:
+        out << c;
+        break;
+    }
+  }
+}
+
+// Unix time in milliseconds as seconds with up to three decimals
+void WriteTimestamp(std::ostream& out, std::int64_t timestamp_ms) {
+  if (timestamp_ms < 0) {
+    out << '-';
+    timestamp_ms = -timestamp_ms;
+  }
+  out << timestamp_ms / 1000;
+  auto millis = static_cast<int>(timestamp_ms % 1000);
+  if (millis != 0) {
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), ".%03d", millis);
+    out << buffer;
+  }
+}
+
+// Write a line header: sample name and labels
+void WriteHead(std::ostream& out, const std::string& name,
+               const ClientMetric& metric, const std::string& suffix = "",
+               const std::string& extraLabelName = "",
+               const std::string& extraLabelValue = "") {
+  out << name << suffix;
+  if (!metric.label.empty() || !extraLabelName.empty()) {
+    out << "{";
+    const char* prefix = "";
+
+    for (auto& lp : metric.label) {
+      out << prefix << lp.name << "=\"";
+      WriteEscaped(out, lp.value);
+      out << "\"";
+      prefix = ",";
+    }
+    if (!extraLabelName.empty()) {
+      out << prefix << extraLabelName << "=\"";
+      WriteEscaped(out, extraLabelValue);
+      out << "\"";
+    }
+    out << "}";
+  }
+  out << " ";
+}
+
+// Write a line trailer: timestamp
+void WriteTail(std::ostream& out, const ClientMetric& metric) {
+  if (metric.timestamp_ms != 0) {
+    out << " ";
+    WriteTimestamp(out, metric.timestamp_ms);
+  }
+  out << "\n";
+}
+
+void WriteCreated(std::ostream& out, const std::string& name,
+                  const ClientMetric& metric) {
+  if (metric.created_timestamp_ms == 0) {
+    return;
+  }
+  WriteHead(out, name, metric, "_created");
+  WriteTimestamp(out, metric.created_timestamp_ms);
+  out << "\n";
+}
+
+void SerializeCounter(std::ostream& out, const std::string& name,
+                      const ClientMetric& metric) {
+  WriteHead(out, name, metric, kTotalSuffix);
+  WriteValue(out, metric.counter.value);
+  WriteTail(out, metric);
+  WriteCreated(out, name, metric);
+}
+
+void SerializeGauge(std::ostream& out, const std::string& name,
+                    const ClientMetric& metric) {
+  WriteHead(out, name, metric);
+  WriteValue(out, metric.gauge.value);
+  WriteTail(out, metric);
+}
+
+void SerializeSummary(std::ostream& out, const std::string& name,
+                      const ClientMetric& metric) {
+  auto& sum = metric.summary;
+  for (auto& q : sum.quantile) {
+    WriteHead(out, name, metric, "", "quantile", FormatFloatLabel(q.quantile));
+    WriteValue(out, q.value);
+    WriteTail(out, metric);
+  }
+
+  WriteHead(out, name, metric, "_sum");
+  WriteValue(out, sum.sample_sum);
+  WriteTail(out, metric);
+
+  WriteHead(out, name, metric, "_count");
+  out << sum.sample_count;
+  WriteTail(out, metric);
+
+  WriteCreated(out, name, metric);
+}
+
+void SerializeUntyped(std::ostream& out, const std::string& name,
+                      const ClientMetric& metric) {
+  WriteHead(out, name, metric);
+  WriteValue(out, metric.untyped.value);
+  WriteTail(out, metric);
+}
+
+void SerializeHistogram(std::ostream& out, const std::string& name,
+                        const ClientMetric& metric) {
+  auto& hist = metric.histogram;
+  double last = -std::numeric_limits<double>::infinity();
+  for (auto& b : hist.bucket) {
+    WriteHead(out, name, metric, "_bucket", "le",
+              FormatFloatLabel(b.upper_bound));
+    last = b.upper_bound;
+    out << b.cumulative_count;
+    WriteTail(out, metric);
+  }
+
+  if (last != std::numeric_limits<double>::infinity()) {
+    WriteHead(out, name, metric, "_bucket", "le", "+Inf");
+    out << hist.sample_count;
+    WriteTail(out, metric);
+  }
+
+  WriteHead(out, name, metric, "_sum");
+  WriteValue(out, hist.sample_sum);
+  WriteTail(out, metric);
+
+  WriteHead(out, name, metric, "_count");
+  out << hist.sample_count;
+  WriteTail(out, metric);
+
+  WriteCreated(out, name, metric);
+}
+
+void WriteMetadata(std::ostream& out, const MetricFamily& family,
+                   const std::string& name, const char* type) {
+  out << "# TYPE " << name << " " << type << "\n";
+  if (!family.unit.empty() && EndsWith(name, "_" + family.unit)) {
+    out << "# UNIT " << name << " " << family.unit << "\n";
+  }
+  if (!family.help.empty()) {
+    out << "# HELP " << name << " ";
+    WriteEscaped(out, family.help);
+    out << "\n";
+  }
+}
+
+void SerializeFamily(std::ostream& out, const MetricFamily& family) {
+  switch (family.type) {
+    case MetricType::Counter: {
+      // the family is named without the suffix of its samples
+      auto name = family.name;
+      if (EndsWith(name, kTotalSuffix)) {
+        name.resize(name.size() - kTotalSuffix.size());
+      }
+      WriteMetadata(out, family, name, "counter");
+      for (auto& metric : family.metric) {
+        SerializeCounter(out, name, metric);
+      }
+      break;
+    }
+    case MetricType::Gauge:
+      WriteMetadata(out, family, family.name, "gauge");
+      for (auto& metric : family.metric) {
+        SerializeGauge(out, family.name, metric);
+      }
+      break;
+    case MetricType::Summary:
+      WriteMetadata(out, family, family.name, "summary");
+      for (auto& metric : family.metric) {
+        SerializeSummary(out, family.name, metric);
+      }
+      break;
+    case MetricType::Untyped:
+      WriteMetadata(out, family, family.name, "unknown");
+      for (auto& metric : family.metric) {
+        SerializeUntyped(out, family.name, metric);
+      }
+      break;
+    case MetricType::Histogram:
+      WriteMetadata(out, family, family.name, "histogram");
+      for (auto& metric : family.metric) {
+        SerializeHistogram(out, family.name, metric);
+      }
+      break;
+  }
+}
+}  // namespace
+
+void OpenMetricsSerializer::Serialize(
+    std::ostream& out, const std::vector<MetricFamily>& metrics) const {
+  SerializePart(out, metrics);
+  SerializeEnd(out);
+}
+
+void OpenMetricsSerializer::SerializePart(
+    std::ostream& out, const std::vector<MetricFamily>& metrics) const {
+  std::locale saved_locale = out.getloc();
+  out.imbue(std::locale::classic());
+  for (auto& family : metrics) {
+    SerializeFamily(out, family);
+  }
+  out.imbue(saved_locale);
+}
+
+void OpenMetricsSerializer::SerializeEnd(std::ostream& out) const {
+  out << "# EOF\n";
+}
+
+std::string OpenMetricsSerializer::ContentType() const {
+  return "application/openmetrics-text; version=1.0.0; charset=utf-8";
+}
+}  // namespace prometheus
@@ -0,0 +1,211 @@
+#include "prometheus/protobuf_serializer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "prometheus/detail/protobuf_writer.h"
+
+namespace prometheus {
+
+namespace {
+
+using namespace detail::protobuf;
+
+// field numbers of metrics.proto of io.prometheus.client
+namespace field {
+constexpr std::uint32_t kFamilyName = 1;
+constexpr std::uint32_t kFamilyHelp = 2;
+constexpr std::uint32_t kFamilyType = 3;
+constexpr std::uint32_t kFamilyMetric = 4;
+
+constexpr std::uint32_t kMetricLabel = 1;
+constexpr std::uint32_t kMetricGauge = 2;
+constexpr std::uint32_t kMetricCounter = 3;
+constexpr std::uint32_t kMetricSummary = 4;
+constexpr std::uint32_t kMetricUntyped = 5;
+constexpr std::uint32_t kMetricTimestamp = 6;
+constexpr std::uint32_t kMetricHistogram = 7;
+
+constexpr std::uint32_t kLabelName = 1;
+constexpr std::uint32_t kLabelValue = 2;
+
+// Gauge, Counter and Untyped
+constexpr std::uint32_t kValue = 1;
+
+// Summary and Histogram
+constexpr std::uint32_t kSampleCount = 1;
+constexpr std::uint32_t kSampleSum = 2;
+constexpr std::uint32_t kQuantileOrBucket = 3;
+
+constexpr std::uint32_t kQuantileQuantile = 1;
+constexpr std::uint32_t kQuantileValue = 2;
+
+constexpr std::uint32_t kBucketCumulativeCount = 1;
+constexpr std::uint32_t kBucketUpperBound = 2;
+}  // namespace field
+
+// the enum of metrics.proto has the order of MetricType
+std::uint64_t TypeValue(MetricType type) {
+  return static_cast<std::uint64_t>(type);
+}
+
+std::size_t LabelSize(const ClientMetric::Label& label) {
+  return StringSize(label.name) + StringSize(label.value);
+}
+
+std::size_t QuantileSize() { return 2 * kDoubleSize; }
+
+std::size_t BucketSize(const ClientMetric::Bucket& bucket) {
+  return UintSize(bucket.cumulative_count) + kDoubleSize;
+}
+
+// the +Inf bucket is implicit in the protobuf format
+bool IsImplicitBucket(const ClientMetric::Bucket& bucket) {
+  return std::isinf(bucket.upper_bound) && bucket.upper_bound > 0;
+}
+
+std::size_t SummarySize(const ClientMetric::Summary& summary) {
+  return UintSize(summary.sample_count) + kDoubleSize +
+         summary.quantile.size() * LengthDelimitedSize(QuantileSize());
+}
+
+std::size_t HistogramSize(const ClientMetric::Histogram& histogram) {
+  auto size = UintSize(histogram.sample_count) + kDoubleSize;
+  for (auto& bucket : histogram.bucket) {
+    if (!IsImplicitBucket(bucket)) {
+      size += LengthDelimitedSize(BucketSize(bucket));
+    }
+  }
+  return size;
+}
+
+std::size_t ValueSize(MetricType type, const ClientMetric& metric) {
+  switch (type) {
+    case MetricType::Counter:
+    case MetricType::Gauge:
+    case MetricType::Untyped:
+      return LengthDelimitedSize(kDoubleSize);
+    case MetricType::Summary:
+      return LengthDelimitedSize(SummarySize(metric.summary));
+    case MetricType::Histogram:
+      return LengthDelimitedSize(HistogramSize(metric.histogram));
+  }
+  return 0;
+}
+
+std::size_t MetricSize(MetricType type, const ClientMetric& metric) {
+  auto size = ValueSize(type, metric);
+  for (auto& label : metric.label) {
+    size += LengthDelimitedSize(LabelSize(label));
+  }
+  if (metric.timestamp_ms != 0) {
+    size += UintSize(static_cast<std::uint64_t>(metric.timestamp_ms));
+  }
+  return size;
+}
+
+void AppendValue(std::string& output, std::uint32_t field, double value) {
+  AppendLengthDelimited(output, field, kDoubleSize);
+  AppendDouble(output, field::kValue, value);
+}
+
+void AppendMetric(std::string& output, MetricType type,
+                  const ClientMetric& metric) {
+  for (auto& label : metric.label) {
+    AppendLengthDelimited(output, field::kMetricLabel, LabelSize(label));
+    AppendString(output, field::kLabelName, label.name);
+    AppendString(output, field::kLabelValue, label.value);
+  }
+
+  switch (type) {
+    case MetricType::Counter:
+      AppendValue(output, field::kMetricCounter, metric.counter.value);
+      break;
+    case MetricType::Gauge:
+      AppendValue(output, field::kMetricGauge, metric.gauge.value);
+      break;
+    case MetricType::Untyped:
+      AppendValue(output, field::kMetricUntyped, metric.untyped.value);
+      break;
+    case MetricType::Summary: {
+      auto& summary = metric.summary;
+      AppendLengthDelimited(output, field::kMetricSummary,
+                            SummarySize(summary));
+      AppendUint(output, field::kSampleCount, summary.sample_count);
+      AppendDouble(output, field::kSampleSum, summary.sample_sum);
+      for (auto& quantile : summary.quantile) {
+        AppendLengthDelimited(output, field::kQuantileOrBucket,
+                              QuantileSize());
+        AppendDouble(output, field::kQuantileQuantile, quantile.quantile);
+        AppendDouble(output, field::kQuantileValue, quantile.value);
+      }
+      break;
+    }
+    case MetricType::Histogram: {
+      auto& histogram = metric.histogram;
+      AppendLengthDelimited(output, field::kMetricHistogram,
+                            HistogramSize(histogram));
+      AppendUint(output, field::kSampleCount, histogram.sample_count);
+      AppendDouble(output, field::kSampleSum, histogram.sample_sum);
+      for (auto& bucket : histogram.bucket) {
+        if (IsImplicitBucket(bucket)) {
+          continue;
+        }
+        AppendLengthDelimited(output, field::kQuantileOrBucket,
+                              BucketSize(bucket));
+        AppendUint(output, field::kBucketCumulativeCount,
+                   bucket.cumulative_count);
+        AppendDouble(output, field::kBucketUpperBound, bucket.upper_bound);
+      }
+      break;
+    }
+  }
+
+  if (metric.timestamp_ms != 0) {
+    AppendUint(output, field::kMetricTimestamp,
+               static_cast<std::uint64_t>(metric.timestamp_ms));
+  }
+}
+
+}  // namespace
+
+std::string ProtobufSerializer::Serialize(
+    const std::vector<MetricFamily>& metrics) const {
+  auto output = std::string{};
+  auto metric_sizes = std::vector<std::size_t>{};
+  for (auto& family : metrics) {
+    // the size of each metric is needed twice, for the family and itself
+    metric_sizes.clear();
+    auto family_size = StringSize(family.name) + StringSize(family.help) +
+                       UintSize(TypeValue(family.type));
+    for (auto& metric : family.metric) {
+      metric_sizes.push_back(MetricSize(family.type, metric));
+      family_size += LengthDelimitedSize(metric_sizes.back());
+    }
+
+    AppendVarint(output, family_size);
+    AppendString(output, field::kFamilyName, family.name);
+    AppendString(output, field::kFamilyHelp, family.help);
+    AppendUint(output, field::kFamilyType, TypeValue(family.type));
+    for (std::size_t i = 0; i < family.metric.size(); ++i) {
+      AppendLengthDelimited(output, field::kFamilyMetric, metric_sizes[i]);
+      AppendMetric(output, family.type, family.metric[i]);
+    }
+  }
+  return output;
+}
+
+void ProtobufSerializer::Serialize(
+    std::ostream& out, const std::vector<MetricFamily>& metrics) const {
+  auto output = Serialize(metrics);
+  out.write(output.data(), static_cast<std::streamsize>(output.size()));
+}
+
+std::string ProtobufSerializer::ContentType() const {
+  return "application/vnd.google.protobuf; "
+         "proto=io.prometheus.client.MetricFamily; encoding=delimited";
+}
+
+}  // namespace prometheus
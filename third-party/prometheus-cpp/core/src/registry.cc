@@ -1,10 +1,14 @@
 #include "prometheus/registry.h"
 
+#include "prometheus/columnar_gauge.h"
 #include "prometheus/counter.h"
+#include "prometheus/detail/utils.h"
+#include "prometheus/detail/worker_pool.h"
 #include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
 #include "prometheus/summary.h"
 
+#include <algorithm>
 #include <iterator>
 
 namespace prometheus {
@@ -19,6 +23,34 @@ void CollectAll(std::vector<MetricFamily>& results, const T& families) {
   }
 }
 
+template <typename T>
+void CollectShardOf(std::vector<MetricFamily>& results, const T& families,
+                    std::size_t shard, std::size_t shards) {
+  for (auto&& collectable : families) {
+    if (detail::shard_of(collectable->GetName(), shards) != shard) {
+      continue;
+    }
+    auto metrics = collectable->Collect();
+    results.insert(results.end(), std::make_move_iterator(metrics.begin()),
+                   std::make_move_iterator(metrics.end()));
+  }
+}
+
+template <typename T>
+void CollectChangedOf(ChangeCursor& cursor, std::vector<MetricFamily>& changed,
+                      std::vector<MetricFamily>& all, const T& families) {
+  for (auto&& collectable : families) {
+    collectable->CollectChanged(cursor, changed, all);
+  }
+}
+
+template <typename T>
+void AddParts(std::vector<const Collectable*>& parts, const T& families) {
+  for (auto&& collectable : families) {
+    parts.push_back(collectable.get());
+  }
+}
+
 bool FamilyNameExists(const std::string& /* name */) { return false; }
 
 template <typename T, typename... Args>
@@ -44,12 +76,82 @@ std::vector<MetricFamily> Registry::Collect() const {
 
   CollectAll(results, counters_);
   CollectAll(results, gauges_);
+  CollectAll(results, columnar_gauges_);
   CollectAll(results, histograms_);
   CollectAll(results, summaries_);
 
   return results;
 }
 
+std::vector<MetricFamily> Registry::CollectFamilies(
+    const std::set<std::string>& names) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto results = std::vector<MetricFamily>{};
+
+  for (auto& name : names) {
+    auto range = families_by_name_.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto metrics = it->second->Collect();
+      results.insert(results.end(), std::make_move_iterator(metrics.begin()),
+                     std::make_move_iterator(metrics.end()));
+    }
+  }
+
+  return results;
+}
+
+std::vector<MetricFamily> Registry::CollectShard(std::size_t shard,
+                                                 std::size_t shards) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto results = std::vector<MetricFamily>{};
+
+  CollectShardOf(results, counters_, shard, shards);
+  CollectShardOf(results, gauges_, shard, shards);
+  CollectShardOf(results, columnar_gauges_, shard, shards);
+  CollectShardOf(results, histograms_, shard, shards);
+  CollectShardOf(results, summaries_, shard, shards);
+
+  return results;
+}
+
+std::vector<MetricFamily> Registry::CollectParallel(
+    detail::WorkerPool& pool) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto parts = std::vector<const Collectable*>{};
+  parts.reserve(families_by_name_.size());
+
+  AddParts(parts, counters_);
+  AddParts(parts, gauges_);
+  AddParts(parts, columnar_gauges_);
+  AddParts(parts, histograms_);
+  AddParts(parts, summaries_);
+
+  auto collected = std::vector<std::vector<MetricFamily>>(parts.size());
+  pool.ParallelFor(parts.size(), [&parts, &collected](std::size_t i) {
+    collected[i] = parts[i]->Collect();
+  });
+
+  auto results = std::vector<MetricFamily>{};
+  results.reserve(parts.size());
+  for (auto& metrics : collected) {
+    results.insert(results.end(), std::make_move_iterator(metrics.begin()),
+                   std::make_move_iterator(metrics.end()));
+  }
+  return results;
+}
+
+void Registry::CollectChanged(ChangeCursor& cursor,
+                              std::vector<MetricFamily>& changed,
+                              std::vector<MetricFamily>& all) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  CollectChangedOf(cursor, changed, all, counters_);
+  CollectChangedOf(cursor, changed, all, gauges_);
+  CollectChangedOf(cursor, changed, all, columnar_gauges_);
+  CollectChangedOf(cursor, changed, all, histograms_);
+  CollectChangedOf(cursor, changed, all, summaries_);
+}
+
 template <>
 std::vector<std::unique_ptr<Family<Counter>>>& Registry::GetFamilies() {
   return counters_;
@@ -60,6 +162,11 @@ std::vector<std::unique_ptr<Family<Gauge>>>& Registry::GetFamilies() {
   return gauges_;
 }
 
+template <>
+std::vector<std::unique_ptr<Family<ColumnarGauge>>>& Registry::GetFamilies() {
+  return columnar_gauges_;
+}
+
 template <>
 std::vector<std::unique_ptr<Family<Histogram>>>& Registry::GetFamilies() {
   return histograms_;
@@ -72,22 +179,32 @@ std::vector<std::unique_ptr<Family<Summary>>>& Registry::GetFamilies() {
 
 template <>
 bool Registry::NameExistsInOtherType<Counter>(const std::string& name) const {
-  return FamilyNameExists(name, gauges_, histograms_, summaries_);
+  return FamilyNameExists(name, gauges_, columnar_gauges_, histograms_,
+                          summaries_);
 }
 
 template <>
 bool Registry::NameExistsInOtherType<Gauge>(const std::string& name) const {
-  return FamilyNameExists(name, counters_, histograms_, summaries_);
+  return FamilyNameExists(name, counters_, columnar_gauges_, histograms_,
+                          summaries_);
+}
+
+template <>
+bool Registry::NameExistsInOtherType<ColumnarGauge>(
+    const std::string& name) const {
+  return FamilyNameExists(name, counters_, gauges_, histograms_, summaries_);
 }
 
 template <>
 bool Registry::NameExistsInOtherType<Histogram>(const std::string& name) const {
-  return FamilyNameExists(name, counters_, gauges_, summaries_);
+  return FamilyNameExists(name, counters_, gauges_, columnar_gauges_,
+                          summaries_);
 }
 
 template <>
 bool Registry::NameExistsInOtherType<Summary>(const std::string& name) const {
-  return FamilyNameExists(name, counters_, gauges_, histograms_);
+  return FamilyNameExists(name, counters_, gauges_, columnar_gauges_,
+                          histograms_);
 }
 
 template <typename T>
@@ -130,6 +247,7 @@ Family<T>& Registry::Add(const std::string& name, const std::string& help,
   auto family = detail::make_unique<Family<T>>(name, help, labels);
   auto& ref = *family;
   families.push_back(std::move(family));
+  families_by_name_.insert({name, &ref});
   return ref;
 }
 
@@ -141,6 +259,10 @@ template Family<Gauge>& Registry::Add(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels);
 
+template Family<ColumnarGauge>& Registry::Add(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& labels);
+
 template Family<Summary>& Registry::Add(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels);
@@ -149,4 +271,44 @@ template Family<Histogram>& Registry::Add(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels);
 
+template <typename T>
+bool Registry::Remove(const Family<T>& family) {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  auto& families = GetFamilies<T>();
+  auto same_family = [&family](const std::unique_ptr<Family<T>>& in) {
+    return &family == in.get();
+  };
+
+  auto it = std::find_if(families.begin(), families.end(), same_family);
+  if (it == families.end()) {
+    return false;
+  }
+
+  auto range = families_by_name_.equal_range(family.GetName());
+  for (auto index = range.first; index != range.second; ++index) {
+    if (index->second == &family) {
+      families_by_name_.erase(index);
+      break;
+    }
+  }
+  families.erase(it);
+  return true;
+}
+
+template bool PROMETHEUS_CPP_CORE_EXPORT
+Registry::Remove(const Family<Counter>& family);
+
+template bool PROMETHEUS_CPP_CORE_EXPORT
+Registry::Remove(const Family<Gauge>& family);
+
+template bool PROMETHEUS_CPP_CORE_EXPORT
+Registry::Remove(const Family<ColumnarGauge>& family);
+
+template bool PROMETHEUS_CPP_CORE_EXPORT
+Registry::Remove(const Family<Summary>& family);
+
+template bool PROMETHEUS_CPP_CORE_EXPORT
+Registry::Remove(const Family<Histogram>& family);
+
 }  // namespace prometheus
@@ -10,4 +10,13 @@ std::string Serializer::Serialize(
   Serialize(ss, metrics);
   return ss.str();
 }
+
+void Serializer::SerializePart(std::ostream &out,
+                               const std::vector<MetricFamily> &metrics) const {
+  Serialize(out, metrics);
+}
+
+void Serializer::SerializeEnd(std::ostream & /* out */) const {}
+
+std::string Serializer::ContentType() const { return "text/plain"; }
 }  // namespace prometheus
@@ -0,0 +1,30 @@
+#include "prometheus/series_budget.h"
+
+namespace prometheus {
+
+SeriesBudget::SeriesBudget(std::size_t max_series) : max_series_(max_series) {}
+
+bool SeriesBudget::Acquire() {
+  auto used = used_.load(std::memory_order_relaxed);
+  do {
+    if (used >= max_series_) {
+      return false;
+    }
+  } while (!used_.compare_exchange_weak(used, used + 1,
+                                        std::memory_order_relaxed));
+  return true;
+}
+
+void SeriesBudget::Charge(std::size_t count) {
+  used_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void SeriesBudget::Release(std::size_t count) {
+  used_.fetch_sub(count, std::memory_order_relaxed);
+}
+
+std::size_t SeriesBudget::Used() const {
+  return used_.load(std::memory_order_relaxed);
+}
+
+}  // namespace prometheus
@@ -15,6 +15,7 @@ void Summary::Observe(const double value) {
   count_ += 1;
   sum_ += value;
   quantile_values_.insert(value);
+  updated_.store(true, std::memory_order_relaxed);
 }
 
 ClientMetric Summary::Collect() const {
@@ -192,4 +192,8 @@ void TextSerializer::Serialize(std::ostream& out,
   }
   out.imbue(saved_locale);
 }
+
+std::string TextSerializer::ContentType() const {
+  return "text/plain; version=0.0.4; charset=utf-8";
+}
 }  // namespace prometheus
@@ -1,3 +1,4 @@
+#include "prometheus/columnar_gauge.h"
 #include "prometheus/counter.h"
 #include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
@@ -59,6 +60,18 @@ TEST_F(BuilderTest, build_counter) {
   verifyCollectedLabels();
 }
 
+TEST_F(BuilderTest, build_with_unit) {
+  BuildGauge().Name("some_seconds").Help(help).Unit("seconds").Register(
+      registry);
+  BuildColumnarGauge().Name("other_seconds").Unit("seconds").Register(
+      registry);
+
+  const auto collected = registry.Collect();
+  ASSERT_EQ(2U, collected.size());
+  EXPECT_EQ("seconds", collected.at(0).unit);
+  EXPECT_EQ("seconds", collected.at(1).unit);
+}
+
 TEST_F(BuilderTest, build_gauge) {
   auto& family = BuildGauge()
                      .Name(name)
@@ -0,0 +1,277 @@
+#include "prometheus/columnar_gauge.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+#include "prometheus/client_metric.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+
+namespace prometheus {
+namespace {
+
+TEST(ColumnarGaugeTest, initialize_with_zero) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle = family.Add({{"name", "gauge1"}});
+  EXPECT_EQ(family.Value(handle), 0.0);
+}
+
+TEST(ColumnarGaugeTest, set) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle = family.Add({{"name", "gauge1"}});
+  EXPECT_TRUE(family.Set(handle, 3.0));
+  EXPECT_EQ(family.Value(handle), 3.0);
+}
+
+TEST(ColumnarGaugeTest, collect_timestamp) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle = family.Add({{"name", "gauge1"}});
+  EXPECT_TRUE(family.Set(handle, 3.0, 1234));
+  EXPECT_EQ(family.Collect().at(0).metric.at(0).timestamp_ms, 1234);
+
+  std::uint64_t sequence = family.ChangeSequence();
+  EXPECT_TRUE(family.Set(handle, 3.0, 5678));
+  EXPECT_EQ(family.ChangeSequence(), sequence);
+  EXPECT_EQ(family.Collect().at(0).metric.at(0).timestamp_ms, 5678);
+
+  EXPECT_TRUE(family.Set(handle, 4.0));
+  EXPECT_EQ(family.Collect().at(0).metric.at(0).timestamp_ms, 0);
+}
+
+TEST(ColumnarGaugeTest, add_twice) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle1 = family.Add({{"name", "gauge1"}});
+  auto handle2 = family.Add({{"name", "gauge1"}});
+  EXPECT_EQ(handle1, handle2);
+  EXPECT_EQ(family.Size(), 1U);
+}
+
+TEST(ColumnarGaugeTest, collect_in_slot_order) {
+  auto const_label = ClientMetric::Label{"component", "test"};
+  Family<ColumnarGauge> family{"entity_status",
+                               "Status of an entity",
+                               {{const_label.name, const_label.value}}};
+  family.Set(family.Add({{"name", "gauge1"}}), 1.0);
+  family.Set(family.Add({{"name", "gauge2"}}), 2.0);
+
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].type, MetricType::Gauge);
+  ASSERT_EQ(collected[0].metric.size(), 2U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 1.0);
+  EXPECT_THAT(collected[0].metric[0].label,
+              ::testing::ElementsAre(const_label,
+                                     ClientMetric::Label{"name", "gauge1"}));
+  EXPECT_EQ(collected[0].metric[1].gauge.value, 2.0);
+}
+
+TEST(ColumnarGaugeTest, remove_reuses_slot) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle1 = family.Add({{"name", "gauge1"}});
+  family.Set(handle1, 5.0);
+  family.Remove(handle1);
+  EXPECT_EQ(family.Size(), 0U);
+
+  auto handle2 = family.Add({{"name", "gauge2"}});
+  EXPECT_EQ(handle1 & 0xffffffffu, handle2 & 0xffffffffu);
+  EXPECT_NE(handle1, handle2);
+  EXPECT_EQ(family.Value(handle2), 0.0);
+
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].metric.size(), 1U);
+}
+
+TEST(ColumnarGaugeTest, stale_handle_is_rejected) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle1 = family.Add({{"name", "gauge1"}});
+  family.Remove(handle1);
+  auto handle2 = family.Add({{"name", "gauge2"}});
+
+  EXPECT_FALSE(family.Set(handle1, 1.0));
+  EXPECT_TRUE(std::isnan(family.Value(handle1)));
+  EXPECT_EQ(family.Value(handle2), 0.0);
+}
+
+TEST(ColumnarGaugeTest, invalid_handle_is_rejected) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  EXPECT_FALSE(family.Set(Family<ColumnarGauge>::kInvalidHandle, 1.0));
+  family.Remove(Family<ColumnarGauge>::kInvalidHandle);
+}
+
+TEST(ColumnarGaugeTest, expire_series_not_updated_within_max_age) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  family.SetMaxAge(std::chrono::milliseconds{50});
+  auto gone = family.Add({{"name", "gone"}});
+  auto alive = family.Add({{"name", "alive"}});
+  family.RemoveStale();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  EXPECT_TRUE(family.Set(alive, 1.0));
+
+  EXPECT_EQ(family.RemoveStale(), 1U);
+  EXPECT_FALSE(family.Set(gone, 1.0));
+  EXPECT_EQ(family.Value(alive), 1.0);
+}
+
+TEST(ColumnarGaugeTest, set_many) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  Family<ColumnarGauge>::Handle handles[] = {family.Add({{"name", "gauge1"}}),
+                                             family.Add({{"name", "gauge2"}})};
+  const double values[] = {1.0, 2.0};
+  EXPECT_EQ(family.Set(handles, values, 2), 2U);
+  EXPECT_EQ(family.Value(handles[0]), 1.0);
+  EXPECT_EQ(family.Value(handles[1]), 2.0);
+}
+
+TEST(ColumnarGaugeTest, set_many_skips_stale_handles) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  Family<ColumnarGauge>::Handle handles[] = {family.Add({{"name", "gauge1"}}),
+                                             family.Add({{"name", "gauge2"}})};
+  family.Remove(handles[0]);
+  const double values[] = {1.0, 2.0};
+  EXPECT_EQ(family.Set(handles, values, 2), 1U);
+  EXPECT_EQ(family.Value(handles[1]), 2.0);
+}
+
+TEST(ColumnarGaugeTest, fold_new_series_into_overflow_beyond_max_series) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  family.SetMaxSeries(1);
+  auto handle1 = family.Add({{"name", "gauge1"}});
+  auto overflow = family.Add({{"name", "gauge2"}});
+  EXPECT_NE(handle1, overflow);
+  EXPECT_EQ(overflow, family.Add({{"name", "gauge3"}}));
+  EXPECT_EQ(overflow, family.Add({{"name", "gauge3"}}));
+  EXPECT_EQ(family.RejectedCount(), 2U);
+  EXPECT_EQ(family.Size(), 2U);
+
+  family.Remove(handle1);
+  EXPECT_NE(overflow, family.Add({{"name", "gauge4"}}));
+  EXPECT_EQ(family.RejectedCount(), 2U);
+
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_THAT(collected[0].metric[1].label,
+              ::testing::ElementsAre(ClientMetric::Label{"overflow", "true"}));
+}
+
+TEST(ColumnarGaugeTest, setting_same_value_is_no_change) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle = family.Add({{"name", "gauge1"}});
+  const auto added = family.ChangeSequence();
+  EXPECT_GT(added, 0U);
+
+  EXPECT_TRUE(family.Set(handle, 0.0));
+  EXPECT_EQ(family.ChangeSequence(), added);
+  EXPECT_TRUE(family.Set(handle, 1.0));
+  EXPECT_EQ(family.ChangeSequence(), added + 1);
+  family.Set(handle, std::nan(""));
+  family.Set(handle, std::nan(""));
+  EXPECT_EQ(family.ChangeSequence(), added + 2);
+}
+
+TEST(ColumnarGaugeTest, collect_changed_since) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  auto handle1 = family.Add({{"name", "gauge1"}});
+  auto handle2 = family.Add({{"name", "gauge2"}});
+
+  std::uint64_t sequence = 0;
+  auto collected = family.CollectChangedSince(0, &sequence);
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].metric.size(), 2U);
+
+  auto since = sequence;
+  EXPECT_TRUE(family.CollectChangedSince(since, &sequence).empty());
+  EXPECT_EQ(sequence, since);
+
+  const Family<ColumnarGauge>::Handle handles[] = {handle1, handle2};
+  const double values[] = {0.0, 2.0};
+  family.Set(handles, values, 2);
+  collected = family.CollectChangedSince(since, &sequence);
+  ASSERT_EQ(collected.size(), 1U);
+  ASSERT_EQ(collected[0].metric.size(), 1U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 2.0);
+  EXPECT_THAT(collected[0].metric[0].label,
+              ::testing::ElementsAre(ClientMetric::Label{"name", "gauge2"}));
+}
+
+TEST(ColumnarGaugeBatchTest, set_across_families) {
+  Family<ColumnarGauge> family1{"mean", "Mean", {}};
+  Family<ColumnarGauge> family2{"count", "Count", {}};
+  ColumnarGaugeBatch batch;
+  EXPECT_EQ(batch.Add(family1, family1.Add({{"index", "1"}})), 0U);
+  EXPECT_EQ(batch.Add(family1, family1.Add({{"index", "2"}})), 1U);
+  EXPECT_EQ(batch.Add(family2, family2.Add({})), 2U);
+  ASSERT_EQ(batch.Size(), 3U);
+
+  EXPECT_EQ(batch.Set({1.0, 2.0, 3.0}), 3U);
+  EXPECT_EQ(family1.Value(family1.Add({{"index", "1"}})), 1.0);
+  EXPECT_EQ(family1.Value(family1.Add({{"index", "2"}})), 2.0);
+  EXPECT_EQ(family2.Value(family2.Add({})), 3.0);
+}
+
+TEST(ColumnarGaugeBatchTest, set_changed_values_only) {
+  Family<ColumnarGauge> family1{"mean", "Mean", {}};
+  Family<ColumnarGauge> family2{"count", "Count", {}};
+  ColumnarGaugeBatch batch;
+  auto changing = family1.Add({{"index", "1"}});
+  batch.Add(family1, changing);
+  batch.Add(family1, family1.Add({{"index", "2"}}));
+  batch.Add(family2, family2.Add({}));
+  const double previous[] = {1.0, 2.0, std::nan("")};
+  EXPECT_EQ(batch.Set(previous), 3U);
+  const auto sequence1 = family1.ChangeSequence();
+  const auto sequence2 = family2.ChangeSequence();
+
+  const double values[] = {4.0, 2.0, std::nan("")};
+  EXPECT_EQ(batch.SetChanged(values, previous), 3U);
+  EXPECT_EQ(family1.Value(changing), 4.0);
+  EXPECT_EQ(family1.ChangeSequence(), sequence1 + 1);
+  EXPECT_EQ(family2.ChangeSequence(), sequence2);
+  // only the changed value is reported as change
+  std::uint64_t sequence = 0;
+  auto collected = family1.CollectChangedSince(sequence1, &sequence);
+  ASSERT_EQ(collected.size(), 1U);
+  ASSERT_EQ(collected[0].metric.size(), 1U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 4.0);
+}
+
+TEST(ColumnarGaugeBatchTest, report_stale_entries) {
+  Family<ColumnarGauge> family{"entity_status", "Status of an entity", {}};
+  ColumnarGaugeBatch batch;
+  auto handle = family.Add({{"name", "gauge1"}});
+  batch.Add(family, handle);
+  batch.Add(family, family.Add({{"name", "gauge2"}}));
+  family.Remove(handle);
+
+  EXPECT_EQ(batch.Set({1.0, 2.0}), 1U);
+  batch.Clear();
+  EXPECT_EQ(batch.Size(), 0U);
+}
+
+TEST(ColumnarGaugeTest, register_with_registry) {
+  Registry registry{};
+  auto& family =
+      BuildColumnarGauge().Name("test").Help("a test").Register(registry);
+  family.Set(family.Add({{"name", "gauge1"}}), 1.0);
+
+  auto collected = registry.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].name, "test");
+  EXPECT_EQ(collected[0].type, MetricType::Gauge);
+  ASSERT_EQ(collected[0].metric.size(), 1U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 1.0);
+}
+
+TEST(ColumnarGaugeTest, reject_same_name_as_gauge) {
+  Registry registry{};
+  EXPECT_NO_THROW(BuildGauge().Name("same_name").Register(registry));
+  EXPECT_ANY_THROW(BuildColumnarGauge().Name("same_name").Register(registry));
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -1,11 +1,14 @@
 #include "prometheus/family.h"
 
+#include <chrono>
 #include <memory>
+#include <thread>
 
 #include <gmock/gmock.h>
 
 #include "prometheus/client_metric.h"
 #include "prometheus/detail/future_std.h"
+#include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
 
 namespace prometheus {
@@ -62,6 +65,20 @@ TEST(FamilyTest, Histogram) {
   EXPECT_EQ(1U, collected[0].metric.at(0).histogram.sample_count);
 }
 
+TEST(FamilyTest, collect_creation_time) {
+  const auto before = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  Family<Counter> counters{"total_requests", "Counts all requests", {}};
+  counters.Add({});
+  const auto created = counters.Collect().at(0).metric.at(0);
+  EXPECT_GE(created.created_timestamp_ms, before);
+
+  Family<Gauge> gauges{"temperature", "Current temperature", {}};
+  gauges.Add({});
+  EXPECT_EQ(gauges.Collect().at(0).metric.at(0).created_timestamp_ms, 0);
+}
+
 TEST(FamilyTest, add_twice) {
   Family<Counter> family{"total_requests", "Counts all requests", {}};
   auto& counter = family.Add({{"name", "counter1"}});
@@ -69,6 +86,135 @@ TEST(FamilyTest, add_twice) {
   ASSERT_EQ(&counter, &counter1);
 }
 
+TEST(FamilyTest, keep_series_without_max_age) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  family.Add({{"name", "counter1"}});
+  EXPECT_EQ(0U, family.RemoveStale());
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].metric.size(), 1U);
+}
+
+TEST(FamilyTest, expire_series_not_updated_within_max_age) {
+  Family<Gauge> family{"entity_status", "Status of an entity", {}};
+  family.SetMaxAge(std::chrono::milliseconds{50});
+  family.Add({{"name", "gone"}});
+  family.Add({{"name", "alive"}});
+  family.RemoveStale();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  family.Add({{"name", "alive"}});
+
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  ASSERT_EQ(collected[0].metric.size(), 1U);
+  EXPECT_THAT(collected[0].metric.at(0).label,
+              ::testing::ElementsAre(ClientMetric::Label{"name", "alive"}));
+}
+
+TEST(FamilyTest, keep_series_younger_than_max_age) {
+  Family<Gauge> family{"entity_status", "Status of an entity", {}};
+  family.SetMaxAge(std::chrono::hours{1});
+  family.Add({{"name", "gauge1"}});
+  EXPECT_EQ(0U, family.RemoveStale());
+  EXPECT_EQ(0U, family.RemoveStale());
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].metric.size(), 1U);
+}
+
+TEST(FamilyTest, update_through_reference_keeps_series) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  family.SetMaxAge(std::chrono::milliseconds{50});
+  auto& counter = family.Add({{"name", "counter1"}});
+  family.Add({{"name", "counter2"}});
+  family.RemoveStale();
+  for (int i = 0; i < 4; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{30});
+    counter.Increment();
+    family.RemoveStale();
+  }
+  EXPECT_EQ(1U, family.Size());
+  EXPECT_EQ(4.0, counter.Value());
+}
+
+TEST(FamilyTest, add_after_expiry_creates_new_series) {
+  Family<Gauge> family{"entity_status", "Status of an entity", {}};
+  family.SetMaxAge(std::chrono::milliseconds{10});
+  family.Add({{"name", "gauge1"}}).Set(5.0);
+  family.RemoveStale();
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  EXPECT_EQ(1U, family.RemoveStale());
+  EXPECT_EQ(0.0, family.Add({{"name", "gauge1"}}).Value());
+}
+
+TEST(FamilyTest, fold_new_series_into_overflow_beyond_max_series) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  family.SetMaxSeries(1);
+  auto& counter1 = family.Add({{"name", "counter1"}});
+  auto& overflow = family.Add({{"name", "counter2"}});
+  EXPECT_NE(&counter1, &overflow);
+  EXPECT_EQ(&overflow, &family.Add({{"name", "counter3"}}));
+  EXPECT_EQ(&counter1, &family.Add({{"name", "counter1"}}));
+  EXPECT_EQ(2U, family.RejectedCount());
+  EXPECT_EQ(&overflow, &family.Add({{"name", "counter2"}}));
+  EXPECT_EQ(2U, family.RejectedCount());
+
+  auto collected = family.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  ASSERT_EQ(collected[0].metric.size(), 2U);
+}
+
+TEST(FamilyTest, size) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  EXPECT_EQ(0U, family.Size());
+  auto& counter = family.Add({{"name", "counter1"}});
+  family.Add({{"name", "counter1"}});
+  family.Add({{"name", "counter2"}});
+  EXPECT_EQ(2U, family.Size());
+  family.Remove(&counter);
+  EXPECT_EQ(1U, family.Size());
+}
+
+TEST(FamilyTest, removed_series_makes_room) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  family.SetMaxSeries(1);
+  family.Remove(&family.Add({{"name", "counter1"}}));
+  family.Add({{"name", "counter2"}});
+  EXPECT_EQ(0U, family.RejectedCount());
+}
+
+TEST(FamilyTest, share_series_budget) {
+  auto budget = std::make_shared<SeriesBudget>(2);
+  Family<Counter> family1{"family1", "first", {}};
+  Family<Counter> family2{"family2", "second", {}};
+  family1.SetSeriesBudget(budget);
+  family2.SetSeriesBudget(budget);
+  family1.Add({{"name", "counter1"}});
+  auto& counter2 = family2.Add({{"name", "counter2"}});
+  family2.Add({{"name", "counter3"}});
+  EXPECT_EQ(2U, budget->Used());
+  EXPECT_EQ(0U, family1.RejectedCount());
+  EXPECT_EQ(1U, family2.RejectedCount());
+
+  family2.Remove(&counter2);
+  EXPECT_EQ(1U, budget->Used());
+  family1.Add({{"name", "counter4"}});
+  EXPECT_EQ(0U, family1.RejectedCount());
+}
+
+TEST(FamilyTest, charge_existing_series_to_budget) {
+  auto budget = std::make_shared<SeriesBudget>(1);
+  {
+    Family<Counter> family{"total_requests", "Counts all requests", {}};
+    family.Add({{"name", "counter1"}});
+    family.Add({{"name", "counter2"}});
+    family.SetSeriesBudget(budget);
+    EXPECT_EQ(2U, budget->Used());
+  }
+  EXPECT_EQ(0U, budget->Used());
+}
+
 TEST(FamilyTest, should_assert_on_invalid_metric_name) {
   auto create_family_with_invalid_name = []() {
     return detail::make_unique<Family<Counter>>(
@@ -0,0 +1,151 @@
+#include "prometheus/gauge_block.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+#include "prometheus/client_metric.h"
+#include "prometheus/detail/utils.h"
+
+namespace prometheus {
+namespace {
+
+TEST(GaugeBlockTest, initialize_with_zero) {
+  GaugeBlock block{{{0, {}}, {0, {{"index", "1"}}}}};
+  std::vector<double> values;
+  EXPECT_EQ(block.Read(&values), 0U);
+  EXPECT_THAT(values, ::testing::ElementsAre(0.0, 0.0));
+}
+
+TEST(GaugeBlockTest, publish) {
+  GaugeBlock block{{{0, {}}, {0, {{"index", "1"}}}}};
+  block.Publish({1.0, 2.0});
+  block.Publish({3.0, 4.0});
+  std::vector<double> values;
+  EXPECT_EQ(block.Read(&values), 2U);
+  EXPECT_THAT(values, ::testing::ElementsAre(3.0, 4.0));
+}
+
+TEST(GaugeBlockTest, publish_timestamp) {
+  GaugeBlock block{{{0, {}}}};
+  block.Publish({1.0}, 1234);
+  std::vector<double> values;
+  std::int64_t timestamp_ms = 0;
+  block.Read(&values, &timestamp_ms);
+  EXPECT_EQ(timestamp_ms, 1234);
+  block.Publish({2.0});
+  block.Read(&values, &timestamp_ms);
+  EXPECT_EQ(timestamp_ms, 0);
+}
+
+TEST(GaugeBlockTest, read_is_consistent_with_concurrent_publish) {
+  const std::size_t size = 64;
+  std::vector<GaugeBlock::Series> series;
+  for (std::size_t i = 0; i < size; ++i) {
+    series.push_back({0, {{"index", std::to_string(i)}}});
+  }
+  GaugeBlock block{series};
+
+  std::atomic<bool> done{false};
+  std::thread writer{[&] {
+    std::vector<double> values(size);
+    for (int round = 1; round <= 10000; ++round) {
+      std::fill(values.begin(), values.end(), round);
+      block.Publish(values);
+    }
+    done = true;
+  }};
+
+  std::vector<double> values;
+  do {
+    auto epoch = block.Read(&values);
+    EXPECT_THAT(values, ::testing::Each(static_cast<double>(epoch)));
+  } while (!done);
+  writer.join();
+}
+
+TEST(GaugeBlockGroupTest, collect_all_families) {
+  GaugeBlockGroup group;
+  auto mean = group.AddFamily("mean", "Mean", {{"component", "test"}});
+  auto count = group.AddFamily("count", "Count");
+  auto& block1 =
+      group.AddBlock({{mean, {{"key", "1"}}}, {count, {{"key", "1"}}}});
+  auto& block2 = group.AddBlock({{mean, {{"key", "2"}}}});
+  block1.Publish({1.5, 10.0});
+  block2.Publish({2.5});
+
+  auto collected = group.Collect();
+  ASSERT_EQ(collected.size(), 2U);
+  EXPECT_EQ(collected[0].name, "mean");
+  EXPECT_EQ(collected[0].type, MetricType::Gauge);
+  ASSERT_EQ(collected[0].metric.size(), 2U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 1.5);
+  EXPECT_THAT(collected[0].metric[0].label,
+              ::testing::ElementsAre(ClientMetric::Label{"component", "test"},
+                                     ClientMetric::Label{"key", "1"}));
+  EXPECT_EQ(collected[0].metric[1].gauge.value, 2.5);
+  EXPECT_EQ(collected[1].name, "count");
+  ASSERT_EQ(collected[1].metric.size(), 1U);
+  EXPECT_EQ(collected[1].metric[0].gauge.value, 10.0);
+}
+
+TEST(GaugeBlockGroupTest, collect_families_by_name) {
+  GaugeBlockGroup group;
+  auto mean = group.AddFamily("mean", "Mean");
+  auto count = group.AddFamily("count", "Count");
+  group.AddBlock({{mean, {{"key", "1"}}}, {count, {{"key", "1"}}}})
+      .Publish({1.5, 10.0});
+
+  auto collected = group.CollectFamilies({"count"});
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].name, "count");
+  ASSERT_EQ(collected[0].metric.size(), 1U);
+  EXPECT_EQ(collected[0].metric[0].gauge.value, 10.0);
+  EXPECT_TRUE(group.CollectFamilies({"unknown"}).empty());
+}
+
+TEST(GaugeBlockGroupTest, collect_shards) {
+  GaugeBlockGroup group;
+  auto mean = group.AddFamily("mean", "Mean");
+  auto count = group.AddFamily("count", "Count");
+  group.AddBlock({{mean, {}}, {count, {}}}).Publish({1.5, 10.0});
+
+  const std::size_t shards = 2;
+  std::size_t collected = 0;
+  for (std::size_t shard = 0; shard < shards; ++shard) {
+    for (const auto& family : group.CollectShard(shard, shards)) {
+      EXPECT_EQ(detail::shard_of(family.name, shards), shard);
+      EXPECT_EQ(family.metric.size(), 1U);
+      ++collected;
+    }
+  }
+  EXPECT_EQ(collected, 2U);
+}
+
+TEST(GaugeBlockGroupTest, remove_block) {
+  GaugeBlockGroup group;
+  auto family = group.AddFamily("mean", "Mean");
+  auto& block = group.AddBlock({{family, {}}});
+  EXPECT_EQ(group.Size(), 1U);
+  group.RemoveBlock(block);
+  EXPECT_EQ(group.Size(), 0U);
+
+  auto collected = group.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_TRUE(collected[0].metric.empty());
+}
+
+TEST(GaugeBlockGroupTest, reject_invalid_families) {
+  GaugeBlockGroup group;
+  group.AddFamily("mean", "Mean");
+  EXPECT_THROW(group.AddFamily("mean", "Mean"), std::invalid_argument);
+  EXPECT_THROW(group.AddFamily("0invalid", ""), std::invalid_argument);
+  EXPECT_THROW(group.AddBlock({{1, {}}}), std::invalid_argument);
+}
+
+}  // namespace
+}  // namespace prometheus
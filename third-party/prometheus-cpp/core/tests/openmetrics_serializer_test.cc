@@ -0,0 +1,152 @@
+#include "prometheus/openmetrics_serializer.h"
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "prometheus/histogram.h"
+#include "prometheus/summary.h"
+
+namespace prometheus {
+namespace {
+
+class OpenMetricsSerializerTest : public testing::Test {
+ public:
+  std::string Serialize(MetricType type) const {
+    MetricFamily metricFamily;
+    metricFamily.name = name;
+    metricFamily.help = "my metric help text";
+    metricFamily.unit = unit;
+    metricFamily.type = type;
+    metricFamily.metric = std::vector<ClientMetric>{metric};
+
+    std::vector<MetricFamily> families{metricFamily};
+
+    return serializer.Serialize(families);
+  }
+
+  std::string name = "my_metric";
+  std::string unit;
+  ClientMetric metric;
+  OpenMetricsSerializer serializer;
+};
+
+TEST_F(OpenMetricsSerializerTest, shouldEndWithEof) {
+  metric.gauge.value = 1.0;
+  EXPECT_THAT(Serialize(MetricType::Gauge), testing::EndsWith("# EOF\n"));
+  EXPECT_EQ("# EOF\n", serializer.Serialize({}));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldEndOnlyConcatenatedParts) {
+  std::ostringstream out;
+  serializer.SerializePart(out, {});
+  EXPECT_EQ(out.str(), "");
+  serializer.SerializeEnd(out);
+  EXPECT_EQ(out.str(), "# EOF\n");
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeSpecialValues) {
+  metric.gauge.value = std::nan("");
+  EXPECT_THAT(Serialize(MetricType::Gauge), testing::HasSubstr(name + " NaN"));
+  metric.gauge.value = -std::numeric_limits<double>::infinity();
+  EXPECT_THAT(Serialize(MetricType::Gauge), testing::HasSubstr(name + " -Inf"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeShortestValue) {
+  metric.gauge.value = 0.1;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 0.1\n"));
+  metric.gauge.value = 1.0 / 3.0;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 0.33333333333333331\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeTimestampInSeconds) {
+  metric.gauge.value = 64.0;
+  metric.timestamp_ms = 1234567;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 64 1234.567\n"));
+  metric.timestamp_ms = 1234000;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 64 1234\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeCounterWithTotalSuffix) {
+  name = "my_metric_total";
+  metric.counter.value = 3.0;
+  metric.created_timestamp_ms = 1500;
+
+  const auto serialized = Serialize(MetricType::Counter);
+  EXPECT_THAT(serialized, testing::HasSubstr("# TYPE my_metric counter\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr("# HELP my_metric my metric"));
+  EXPECT_THAT(serialized, testing::HasSubstr("my_metric_total 3\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr("my_metric_created 1.500\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldAppendTotalSuffixToCounter) {
+  metric.counter.value = 3.0;
+
+  const auto serialized = Serialize(MetricType::Counter);
+  EXPECT_THAT(serialized, testing::HasSubstr("# TYPE my_metric counter\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr("my_metric_total 3\n"));
+  EXPECT_THAT(serialized, testing::Not(testing::HasSubstr("_created")));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeUnitIfNameEndsWithIt) {
+  name = "my_metric_seconds";
+  unit = "seconds";
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr("# UNIT my_metric_seconds seconds\n"));
+
+  name = "my_metric";
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::Not(testing::HasSubstr("# UNIT")));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeUntypedAsUnknown) {
+  metric.untyped.value = 64.0;
+  EXPECT_THAT(Serialize(MetricType::Untyped),
+              testing::HasSubstr("# TYPE my_metric unknown\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeHistogram) {
+  Histogram histogram{{1}};
+  histogram.Observe(0);
+  histogram.Observe(200);
+  metric = histogram.Collect();
+  metric.created_timestamp_ms = 2000;
+
+  const auto serialized = Serialize(MetricType::Histogram);
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_bucket{le=\"1.0\"} 1\n"
+                                                    "my_metric_bucket{le=\"+"
+                                                    "Inf\"} 2\n"
+                                                    "my_metric_sum 200\n"
+                                                    "my_metric_count 2\n"
+                                                    "my_metric_created 2\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeSummary) {
+  Summary summary{Summary::Quantiles{{0.5, 0.05}}};
+  summary.Observe(0);
+  summary.Observe(200);
+  metric = summary.Collect();
+
+  const auto serialized = Serialize(MetricType::Summary);
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "{quantile=\"0.5\"} 0\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 200\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_count 2\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldEscapeHelp) {
+  MetricFamily family;
+  family.name = name;
+  family.help = "a \"quoted\"\nhelp";
+  family.type = MetricType::Gauge;
+  EXPECT_THAT(serializer.Serialize({family}),
+              testing::HasSubstr("# HELP my_metric a \\\"quoted\\\"\\nhelp\n"));
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -0,0 +1,222 @@
+#include "prometheus/protobuf_serializer.h"
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace prometheus {
+namespace {
+
+// A decoded protobuf message, the values of each field number in order.
+// Length-delimited values are kept as bytes, fixed64 values as double.
+struct Message {
+  std::multimap<std::uint32_t, std::string> bytes;
+  std::multimap<std::uint32_t, std::uint64_t> varints;
+  std::multimap<std::uint32_t, double> doubles;
+
+  std::vector<Message> Nested(std::uint32_t field) const;
+  std::string String(std::uint32_t field) const {
+    auto it = bytes.find(field);
+    return it == bytes.end() ? std::string{} : it->second;
+  }
+};
+
+std::uint64_t ReadVarint(const std::string& data, std::size_t& pos) {
+  std::uint64_t value = 0;
+  for (auto shift = 0;; shift += 7) {
+    auto byte = static_cast<unsigned char>(data.at(pos++));
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+}
+
+Message Decode(const std::string& data) {
+  auto message = Message{};
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    auto key = ReadVarint(data, pos);
+    auto field = static_cast<std::uint32_t>(key >> 3);
+    switch (key & 7) {
+      case 0:
+        message.varints.emplace(field, ReadVarint(data, pos));
+        break;
+      case 1: {
+        std::uint64_t bits = 0;
+        for (auto i = 0; i < 8; ++i) {
+          bits |= static_cast<std::uint64_t>(
+                      static_cast<unsigned char>(data.at(pos++)))
+                  << (8 * i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        message.doubles.emplace(field, value);
+        break;
+      }
+      case 2: {
+        auto size = ReadVarint(data, pos);
+        message.bytes.emplace(field, data.substr(pos, size));
+        pos += size;
+        break;
+      }
+      default:
+        ADD_FAILURE() << "unexpected wire type " << (key & 7);
+        return message;
+    }
+  }
+  return message;
+}
+
+std::vector<Message> Message::Nested(std::uint32_t field) const {
+  auto nested = std::vector<Message>{};
+  auto range = bytes.equal_range(field);
+  for (auto it = range.first; it != range.second; ++it) {
+    nested.push_back(Decode(it->second));
+  }
+  return nested;
+}
+
+std::vector<Message> DecodeDelimited(const std::string& data) {
+  auto families = std::vector<Message>{};
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    auto size = ReadVarint(data, pos);
+    families.push_back(Decode(data.substr(pos, size)));
+    pos += size;
+  }
+  EXPECT_EQ(data.size(), pos);
+  return families;
+}
+
+class ProtobufSerializerTest : public testing::Test {
+ public:
+  std::vector<Message> Serialize(MetricType type) const {
+    MetricFamily metricFamily;
+    metricFamily.name = "my_metric";
+    metricFamily.help = "my metric help text";
+    metricFamily.type = type;
+    metricFamily.metric = std::vector<ClientMetric>{metric};
+
+    return DecodeDelimited(serializer.Serialize({metricFamily}));
+  }
+
+  ClientMetric metric;
+  ProtobufSerializer serializer;
+};
+
+TEST_F(ProtobufSerializerTest, shouldSerializeFamily) {
+  metric.label = {{"k", "v\"\n"}};
+  metric.counter.value = 64.0;
+
+  auto families = Serialize(MetricType::Counter);
+  ASSERT_EQ(1u, families.size());
+  EXPECT_EQ("my_metric", families[0].String(1));
+  EXPECT_EQ("my metric help text", families[0].String(2));
+  EXPECT_EQ(0u, families[0].varints.find(3)->second);
+
+  auto metrics = families[0].Nested(4);
+  ASSERT_EQ(1u, metrics.size());
+  auto labels = metrics[0].Nested(1);
+  ASSERT_EQ(1u, labels.size());
+  EXPECT_EQ("k", labels[0].String(1));
+  EXPECT_EQ("v\"\n", labels[0].String(2));
+  auto counter = metrics[0].Nested(3);
+  ASSERT_EQ(1u, counter.size());
+  EXPECT_EQ(64.0, counter[0].doubles.find(1)->second);
+  EXPECT_EQ(0u, metrics[0].varints.count(6));
+}
+
+TEST_F(ProtobufSerializerTest, shouldSerializeGaugeWithTimestamp) {
+  metric.gauge.value = -std::numeric_limits<double>::infinity();
+  metric.timestamp_ms = 1234;
+
+  auto families = Serialize(MetricType::Gauge);
+  ASSERT_EQ(1u, families.size());
+  EXPECT_EQ(1u, families[0].varints.find(3)->second);
+  auto metrics = families[0].Nested(4);
+  ASSERT_EQ(1u, metrics.size());
+  EXPECT_EQ(metric.gauge.value,
+            metrics[0].Nested(2).at(0).doubles.find(1)->second);
+  EXPECT_EQ(1234u, metrics[0].varints.find(6)->second);
+}
+
+TEST_F(ProtobufSerializerTest, shouldSerializeSummary) {
+  metric.summary.sample_count = 3;
+  metric.summary.sample_sum = 1.5;
+  for (auto q : {0.5, 0.9}) {
+    auto quantile = ClientMetric::Quantile{};
+    quantile.quantile = q;
+    quantile.value = 2 * q - 0.8;
+    metric.summary.quantile.push_back(quantile);
+  }
+
+  auto families = Serialize(MetricType::Summary);
+  ASSERT_EQ(1u, families.size());
+  EXPECT_EQ(2u, families[0].varints.find(3)->second);
+  auto summary = families[0].Nested(4).at(0).Nested(4).at(0);
+  EXPECT_EQ(3u, summary.varints.find(1)->second);
+  EXPECT_EQ(1.5, summary.doubles.find(2)->second);
+  auto quantiles = summary.Nested(3);
+  ASSERT_EQ(2u, quantiles.size());
+  EXPECT_EQ(0.9, quantiles[1].doubles.find(1)->second);
+  EXPECT_DOUBLE_EQ(1.0, quantiles[1].doubles.find(2)->second);
+}
+
+TEST_F(ProtobufSerializerTest, shouldOmitInfiniteBucket) {
+  metric.histogram.sample_count = 2;
+  metric.histogram.sample_sum = 7.0;
+  for (auto bound : {1.0, std::numeric_limits<double>::infinity()}) {
+    auto bucket = ClientMetric::Bucket{};
+    bucket.cumulative_count = metric.histogram.bucket.size() + 1;
+    bucket.upper_bound = bound;
+    metric.histogram.bucket.push_back(bucket);
+  }
+
+  auto families = Serialize(MetricType::Histogram);
+  ASSERT_EQ(1u, families.size());
+  EXPECT_EQ(4u, families[0].varints.find(3)->second);
+  auto histogram = families[0].Nested(4).at(0).Nested(7).at(0);
+  EXPECT_EQ(2u, histogram.varints.find(1)->second);
+  EXPECT_EQ(7.0, histogram.doubles.find(2)->second);
+  auto buckets = histogram.Nested(3);
+  ASSERT_EQ(1u, buckets.size());
+  EXPECT_EQ(1u, buckets[0].varints.find(1)->second);
+  EXPECT_EQ(1.0, buckets[0].doubles.find(2)->second);
+}
+
+TEST_F(ProtobufSerializerTest, shouldDelimitEveryFamily) {
+  MetricFamily first;
+  first.name = "first";
+  first.type = MetricType::Untyped;
+  first.metric.resize(300);
+  MetricFamily second;
+  second.name = "second";
+  second.type = MetricType::Gauge;
+
+  auto families = DecodeDelimited(serializer.Serialize({first, second}));
+  ASSERT_EQ(2u, families.size());
+  EXPECT_EQ(300u, families[0].Nested(4).size());
+  EXPECT_EQ("second", families[1].String(1));
+}
+
+TEST_F(ProtobufSerializerTest, shouldWriteSameBytesToStream) {
+  metric.gauge.value = 1.0;
+  MetricFamily family;
+  family.name = "my_metric";
+  family.type = MetricType::Gauge;
+  family.metric = {metric};
+
+  std::ostringstream out;
+  serializer.Serialize(out, {family});
+  EXPECT_EQ(serializer.Serialize({family}), out.str());
+}
+
+}  // namespace
+}  // namespace prometheus
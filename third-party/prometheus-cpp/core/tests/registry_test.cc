@@ -1,8 +1,13 @@
 #include "prometheus/registry.h"
 #include "prometheus/counter.h"
+#include "prometheus/detail/utils.h"
+#include "prometheus/detail/worker_pool.h"
+#include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
 #include "prometheus/summary.h"
 
+#include <set>
+#include <string>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -136,5 +141,93 @@ TEST(RegistryTest, do_not_merge_families_with_different_labels) {
                        .Register(registry));
 }
 
+TEST(RegistryTest, remove_family) {
+  Registry registry{};
+  auto& counter = BuildCounter().Name("counter").Register(registry);
+  auto& gauge = BuildGauge().Name("gauge").Register(registry);
+
+  EXPECT_TRUE(registry.Remove(counter));
+  auto collected = registry.Collect();
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].name, "gauge");
+
+  EXPECT_TRUE(registry.Remove(gauge));
+  EXPECT_TRUE(registry.Collect().empty());
+}
+
+TEST(RegistryTest, remove_unknown_family) {
+  Registry registry{};
+  Registry other{};
+  auto& counter = BuildCounter().Name("counter").Register(other);
+
+  EXPECT_FALSE(registry.Remove(counter));
+  EXPECT_EQ(other.Collect().size(), 1U);
+}
+
+TEST(RegistryTest, collect_families_by_name) {
+  Registry registry{Registry::InsertBehavior::NonStandardAppend};
+  BuildCounter().Name("counter").Register(registry).Add({});
+  BuildGauge().Name("gauge").Register(registry).Add({});
+  BuildGauge().Name("gauge").Register(registry).Add({});
+  auto& removed = BuildHistogram().Name("histogram").Register(registry);
+  ASSERT_TRUE(registry.Remove(removed));
+
+  auto collected = registry.CollectFamilies({"gauge", "histogram", "unknown"});
+  ASSERT_EQ(collected.size(), 2U);
+  EXPECT_EQ(collected[0].name, "gauge");
+  EXPECT_EQ(collected[1].name, "gauge");
+  EXPECT_TRUE(registry.CollectFamilies({}).empty());
+}
+
+TEST(RegistryTest, collect_shards) {
+  Registry registry{};
+  const std::vector<std::string> names{"a", "b", "c", "d", "e", "f", "g"};
+  for (const auto& name : names) {
+    BuildGauge().Name(name).Register(registry).Add({});
+  }
+
+  const std::size_t shards = 3;
+  std::set<std::string> collected;
+  for (std::size_t shard = 0; shard < shards; ++shard) {
+    for (const auto& family : registry.CollectShard(shard, shards)) {
+      EXPECT_EQ(detail::shard_of(family.name, shards), shard);
+      EXPECT_TRUE(collected.insert(family.name).second);
+    }
+  }
+  EXPECT_EQ(collected.size(), names.size());
+  EXPECT_EQ(registry.CollectShard(0, 1).size(), names.size());
+}
+
+TEST(RegistryTest, collect_parallel_in_order) {
+  Registry registry{};
+  for (auto i = 0; i < 20; ++i) {
+    BuildGauge()
+        .Name("gauge_" + std::to_string(i))
+        .Register(registry)
+        .Add({})
+        .Set(i);
+  }
+  BuildCounter().Name("counter").Register(registry).Add({});
+
+  detail::WorkerPool pool{2};
+  auto collected = registry.CollectParallel(pool);
+  auto expected = registry.Collect();
+  ASSERT_EQ(collected.size(), expected.size());
+  for (std::size_t i = 0; i < collected.size(); ++i) {
+    EXPECT_EQ(collected[i].name, expected[i].name);
+    ASSERT_EQ(collected[i].metric.size(), 1U);
+    EXPECT_EQ(collected[i].metric[0].gauge.value,
+              expected[i].metric[0].gauge.value);
+  }
+}
+
+TEST(RegistryTest, register_again_after_remove) {
+  Registry registry{};
+  auto& counter = BuildCounter().Name("name").Register(registry);
+  ASSERT_TRUE(registry.Remove(counter));
+
+  EXPECT_NO_THROW(BuildGauge().Name("name").Register(registry));
+}
+
 }  // namespace
 }  // namespace prometheus
@@ -2,6 +2,8 @@
 
 #include <gmock/gmock.h>
 #include <map>
+#include <string>
+#include <vector>
 
 namespace prometheus {
 
@@ -29,6 +31,20 @@ TEST(UtilsTest, hash_label_3) {
   EXPECT_NE(detail::hash_labels(labels1), detail::hash_labels(labels2));
 }
 
+TEST(UtilsTest, shard_of) {
+  EXPECT_EQ(detail::shard_of("a", 1), 0U);
+  EXPECT_EQ(detail::shard_of("http_requests_total", 4),
+            detail::shard_of("http_requests_total", 4));
+  // FNV-1a of "a" is 0xaf63dc4c8601ec8c
+  EXPECT_EQ(detail::shard_of("a", 1000), 0xaf63dc4c8601ec8cULL % 1000);
+
+  std::vector<std::size_t> sizes(4);
+  for (int i = 0; i < 1000; ++i) {
+    ++sizes[detail::shard_of("metric_" + std::to_string(i), sizes.size())];
+  }
+  EXPECT_THAT(sizes, ::testing::Each(::testing::Gt(200U)));
+}
+
 }  // namespace
 
 }  // namespace prometheus
@@ -0,0 +1,53 @@
+#include "prometheus/detail/worker_pool.h"
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace prometheus {
+namespace {
+
+TEST(WorkerPoolTest, run_every_iteration_once) {
+  detail::WorkerPool pool{3};
+  EXPECT_EQ(pool.Size(), 3U);
+
+  std::vector<std::atomic<int>> runs(1000);
+  pool.ParallelFor(runs.size(), [&runs](std::size_t i) { ++runs[i]; });
+  for (const auto& count : runs) {
+    EXPECT_EQ(count.load(), 1);
+  }
+}
+
+TEST(WorkerPoolTest, run_on_caller_without_threads) {
+  detail::WorkerPool pool{0};
+  const auto caller = std::this_thread::get_id();
+  std::size_t runs = 0;
+  pool.ParallelFor(10, [&](std::size_t) {
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+    ++runs;
+  });
+  EXPECT_EQ(runs, 10U);
+}
+
+TEST(WorkerPoolTest, run_concurrent_loops) {
+  detail::WorkerPool pool{2};
+  std::atomic<std::size_t> runs{0};
+  std::vector<std::thread> callers;
+  for (auto i = 0; i < 4; ++i) {
+    callers.emplace_back([&pool, &runs] {
+      for (auto j = 0; j < 50; ++j) {
+        pool.ParallelFor(20, [&runs](std::size_t) { ++runs; });
+      }
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(runs.load(), 4U * 50U * 20U);
+}
+
+}  // namespace
+}  // namespace prometheus
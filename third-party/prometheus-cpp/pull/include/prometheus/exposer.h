@@ -18,13 +18,20 @@ namespace prometheus {
 namespace detail {
 class Endpoint;
 class MetricsHandler;
+class WorkerPool;
 }  // namespace detail
 
 class PROMETHEUS_CPP_PULL_EXPORT Exposer {
  public:
+  /// \param num_threads Number of threads serving requests.
+  /// \param num_collect_threads Number of threads collecting and serializing
+  /// the families of a scrape together with the thread serving it. With 0 a
+  /// scrape is collected on the serving thread only.
   explicit Exposer(const std::string& bind_address,
-                   const std::size_t num_threads = 2);
-  explicit Exposer(std::vector<std::string> options);
+                   const std::size_t num_threads = 2,
+                   const std::size_t num_collect_threads = 0);
+  explicit Exposer(std::vector<std::string> options,
+                   const std::size_t num_collect_threads = 0);
   ~Exposer();
   void RegisterCollectable(const std::weak_ptr<Collectable>& collectable,
                            const std::string& uri = std::string("/metrics"));
@@ -39,6 +46,8 @@ class PROMETHEUS_CPP_PULL_EXPORT Exposer {
  private:
   detail::Endpoint& GetEndpointForUri(const std::string& uri);
 
+  // outlives the server and the endpoints using it
+  std::unique_ptr<detail::WorkerPool> collect_pool_;
   std::unique_ptr<CivetServer> server_;
   std::vector<std::unique_ptr<detail::Endpoint>> endpoints_;
 };
@@ -7,12 +7,12 @@
 namespace prometheus {
 namespace detail {
 
-Endpoint::Endpoint(CivetServer& server, std::string uri)
+Endpoint::Endpoint(CivetServer& server, std::string uri, WorkerPool* pool)
     : server_(server),
       uri_(std::move(uri)),
       endpoint_registry_(std::make_shared<Registry>()),
       metrics_handler_(detail::make_unique<MetricsHandler>(
-          collectables_, *endpoint_registry_)) {
+          collectables_, *endpoint_registry_, pool)) {
   RegisterCollectable(endpoint_registry_);
   server_.addHandler(uri_, metrics_handler_.get());
 }
@@ -14,10 +14,12 @@ class CivetServer;
 namespace prometheus {
 namespace detail {
 class MetricsHandler;
+class WorkerPool;
 
 class Endpoint {
  public:
-  explicit Endpoint(CivetServer& server, std::string uri);
+  explicit Endpoint(CivetServer& server, std::string uri,
+                    WorkerPool* pool = nullptr);
   ~Endpoint();
 
   void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
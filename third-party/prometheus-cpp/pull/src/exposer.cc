@@ -9,16 +9,24 @@
 #include "handler.h"
 #include "prometheus/client_metric.h"
 #include "prometheus/detail/future_std.h"
+#include "prometheus/detail/worker_pool.h"
 
 namespace prometheus {
 
-Exposer::Exposer(const std::string& bind_address, const std::size_t num_threads)
+Exposer::Exposer(const std::string& bind_address, const std::size_t num_threads,
+                 const std::size_t num_collect_threads)
     : Exposer(std::vector<std::string>{"listening_ports", bind_address,
                                        "num_threads",
-                                       std::to_string(num_threads)}) {}
+                                       std::to_string(num_threads)},
+              num_collect_threads) {}
 
-Exposer::Exposer(std::vector<std::string> options)
-    : server_(detail::make_unique<CivetServer>(std::move(options))) {}
+Exposer::Exposer(std::vector<std::string> options,
+                 const std::size_t num_collect_threads)
+    : collect_pool_(num_collect_threads == 0
+                        ? nullptr
+                        : detail::make_unique<detail::WorkerPool>(
+                              num_collect_threads)),
+      server_(detail::make_unique<CivetServer>(std::move(options))) {}
 
 Exposer::~Exposer() = default;
 
@@ -48,7 +56,8 @@ detail::Endpoint& Exposer::GetEndpointForUri(const std::string& uri) {
     return *it->get();
   }
 
-  endpoints_.emplace_back(detail::make_unique<detail::Endpoint>(*server_, uri));
+  endpoints_.emplace_back(detail::make_unique<detail::Endpoint>(
+      *server_, uri, collect_pool_.get()));
   return *endpoints_.back().get();
 }
 
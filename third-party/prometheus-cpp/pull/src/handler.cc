@@ -1,8 +1,17 @@
 #include "handler.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "prometheus/counter.h"
+#include "prometheus/detail/utils.h"
+#include "prometheus/histogram.h"
 #include "prometheus/summary.h"
 
 #ifdef HAVE_ZLIB
@@ -10,16 +19,40 @@
 #endif
 
 #include "metrics_collector.h"
+#include "series_selector.h"
+#include "prometheus/openmetrics_serializer.h"
+#include "prometheus/protobuf_serializer.h"
 #include "prometheus/serializer.h"
 #include "prometheus/text_serializer.h"
 
 namespace prometheus {
 namespace detail {
 
+namespace {
+// 100us to 10s
+const Histogram::BucketBoundaries kDurations = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+    0.05,   0.1,     0.25,   0.5,   1,      2.5,   5,    10};
+// 1KiB to 1GiB in steps of four
+const Histogram::BucketBoundaries kSizes = {
+    1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20,
+    1 << 22, 1 << 24, 1 << 26, 1 << 28, 1 << 30};
+const Histogram::BucketBoundaries kSeries = {10,     100,     1000,
+                                             10000,  100000,  1000000,
+                                             10000000};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+}  // namespace
+
 MetricsHandler::MetricsHandler(
     const std::vector<std::weak_ptr<Collectable>>& collectables,
-    Registry& registry)
+    Registry& registry, WorkerPool* pool)
     : collectables_(collectables),
+      pool_(pool),
       bytes_transferred_family_(
           BuildCounter()
               .Name("exposer_transferred_bytes_total")
@@ -37,7 +70,36 @@ MetricsHandler::MetricsHandler(
               .Help("Latencies of serving scrape requests, in microseconds")
               .Register(registry)),
       request_latencies_(request_latencies_family_.Add(
-          {}, Summary::Quantiles{{0.5, 0.05}, {0.9, 0.01}, {0.99, 0.001}})) {}
+          {}, Summary::Quantiles{{0.5, 0.05}, {0.9, 0.01}, {0.99, 0.001}})),
+      phase_durations_family_(
+          BuildHistogram()
+              .Name("exposer_scrape_phase_duration_seconds")
+              .Help("Time spent in each phase of serving a scrape")
+              .Unit("seconds")
+              .Register(registry)),
+      collect_duration_(
+          phase_durations_family_.Add({{"phase", "collect"}}, kDurations)),
+      serialize_duration_(
+          phase_durations_family_.Add({{"phase", "serialize"}}, kDurations)),
+      compress_duration_(
+          phase_durations_family_.Add({{"phase", "compress"}}, kDurations)),
+      write_duration_(
+          phase_durations_family_.Add({{"phase", "write"}}, kDurations)),
+      body_sizes_family_(BuildHistogram()
+                             .Name("exposer_response_body_bytes")
+                             .Help("Size of scrape responses in bytes, "
+                                   "before and after compression")
+                             .Unit("bytes")
+                             .Register(registry)),
+      body_size_(body_sizes_family_.Add({{"encoding", "identity"}}, kSizes)),
+      compressed_body_size_(
+          body_sizes_family_.Add({{"encoding", "gzip"}}, kSizes)),
+      scraped_series_family_(BuildHistogram()
+                                 .Name("exposer_scraped_series")
+                                 .Help("Number of series serialized by a "
+                                       "scrape")
+                                 .Register(registry)),
+      scraped_series_(scraped_series_family_.Add({}, kSeries)) {}
 
 #ifdef HAVE_ZLIB
 static bool IsEncodingAccepted(struct mg_connection* conn,
@@ -88,42 +150,373 @@ static std::vector<Byte> GZipCompress(const std::string& input) {
 }
 #endif
 
-static std::size_t WriteResponse(struct mg_connection* conn,
-                                 const std::string& body) {
+static std::string Trim(const std::string& s) {
+  auto begin = s.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return {};
+  }
+  return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+// Picks the format of the Accept header with the highest quality, the text
+// format if the header is missing or it is as welcome as another format.
+static std::unique_ptr<Serializer> NegotiateSerializer(
+    struct mg_connection* conn) {
+  auto accept = mg_get_header(conn, "Accept");
+  auto protobuf_quality = 0.0;
+  auto openmetrics_quality = 0.0;
+  auto text_quality = accept ? 0.0 : 1.0;
+
+  std::istringstream ranges{accept ? accept : ""};
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    std::istringstream parts{range};
+    std::string part;
+    std::getline(parts, part, ';');
+    auto media_type = Trim(part);
+    auto quality = 1.0;
+    auto proto = std::string{};
+    auto encoding = std::string{};
+    auto version = std::string{};
+    while (std::getline(parts, part, ';')) {
+      auto equals = part.find('=');
+      if (equals == std::string::npos) {
+        continue;
+      }
+      auto name = Trim(part.substr(0, equals));
+      auto value = Trim(part.substr(equals + 1));
+      if (name == "q") {
+        quality = std::strtod(value.c_str(), nullptr);
+      } else if (name == "proto") {
+        proto = value;
+      } else if (name == "encoding") {
+        encoding = value;
+      } else if (name == "version") {
+        version = value;
+      }
+    }
+
+    if (media_type == "application/vnd.google.protobuf" &&
+        proto == "io.prometheus.client.MetricFamily" &&
+        encoding == "delimited") {
+      protobuf_quality = std::max(protobuf_quality, quality);
+    } else if (media_type == "application/openmetrics-text" &&
+               (version.empty() || version == "1.0.0" ||
+                version == "0.0.1")) {
+      openmetrics_quality = std::max(openmetrics_quality, quality);
+    } else if (media_type == "text/plain" || media_type == "text/*" ||
+               media_type == "*/*") {
+      text_quality = std::max(text_quality, quality);
+    }
+  }
+
+  if (protobuf_quality > text_quality &&
+      protobuf_quality >= openmetrics_quality) {
+    return std::unique_ptr<Serializer>{new ProtobufSerializer()};
+  }
+  if (openmetrics_quality > text_quality) {
+    return std::unique_ptr<Serializer>{new OpenMetricsSerializer()};
+  }
+  return std::unique_ptr<Serializer>{new TextSerializer()};
+}
+
+// Families and series requested with name[] and match[], e.g.,
+// /metrics?name[]=up&match[]={job="api"}. Both are optional, and series
+// must match at least one selector if any is given.
+//
+// A scrape may further be restricted to one of n shards of the families
+// with /metrics?shard=i&of=n or /metrics/shard/i?of=n.
+struct ScrapeQuery {
+  std::set<std::string> names;
+  std::vector<SeriesSelector> selectors;
+  std::size_t shard = 0;
+  std::size_t shards = 0;
+};
+
+static const std::string kShardPath = "/shard/";
+
+// Parses a shard index or count, false unless it is a plain decimal number
+static bool ParseShardNumber(const std::string& value, std::size_t* number) {
+  if (value.empty() || value.size() > 9 ||
+      value.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  *number = static_cast<std::size_t>(std::strtoul(value.c_str(), nullptr, 10));
+  return true;
+}
+
+static std::string UrlDecode(const std::string& encoded) {
+  std::vector<char> decoded(encoded.size() + 1);
+  auto size = mg_url_decode(encoded.data(), static_cast<int>(encoded.size()),
+                            decoded.data(), static_cast<int>(decoded.size()),
+                            1);
+  return size < 0 ? std::string{} : std::string(decoded.data(), size);
+}
+
+// Returns false with a message if a selector or the shard is invalid
+static bool ParseQuery(struct mg_connection* conn, ScrapeQuery* query,
+                       std::string* error) {
+  auto request_info = mg_get_request_info(conn);
+  if (!request_info) {
+    return true;
+  }
+
+  auto has_shard = false;
+  auto has_shards = false;
+  if (request_info->local_uri) {
+    std::string uri{request_info->local_uri};
+    auto pos = uri.rfind(kShardPath);
+    if (pos != std::string::npos) {
+      if (!ParseShardNumber(uri.substr(pos + kShardPath.size()),
+                            &query->shard)) {
+        *error = "invalid shard\n";
+        return false;
+      }
+      has_shard = true;
+    }
+  }
+
+  std::istringstream parameters{
+      request_info->query_string ? request_info->query_string : ""};
+  std::string parameter;
+  while (std::getline(parameters, parameter, '&')) {
+    auto equals = parameter.find('=');
+    if (equals == std::string::npos) {
+      continue;
+    }
+    auto name = UrlDecode(parameter.substr(0, equals));
+    auto value = UrlDecode(parameter.substr(equals + 1));
+    if (name == "name[]") {
+      query->names.insert(value);
+    } else if (name == "match[]") {
+      query->selectors.emplace_back();
+      if (!query->selectors.back().Parse(value)) {
+        *error = "invalid match[] selector\n";
+        return false;
+      }
+    } else if (name == "shard") {
+      if (!ParseShardNumber(value, &query->shard)) {
+        *error = "invalid shard\n";
+        return false;
+      }
+      has_shard = true;
+    } else if (name == "of") {
+      if (!ParseShardNumber(value, &query->shards)) {
+        *error = "invalid shard count\n";
+        return false;
+      }
+      has_shards = true;
+    }
+  }
+
+  if (has_shard != has_shards ||
+      (has_shards && query->shard >= query->shards)) {
+    *error = "shard requires of with a shard count above it\n";
+    return false;
+  }
+
+  // selectors of known families only need to look at these
+  if (query->names.empty() && !query->selectors.empty()) {
+    for (auto& selector : query->selectors) {
+      if (selector.Name().empty()) {
+        query->names.clear();
+        break;
+      }
+      query->names.insert(selector.Name());
+    }
+  }
+  return true;
+}
+
+// Drops the series that no selector matches, and families left empty
+static void FilterSeries(std::vector<MetricFamily>& families,
+                         const std::vector<SeriesSelector>& selectors) {
+  if (selectors.empty()) {
+    return;
+  }
+  for (auto& family : families) {
+    auto not_selected = [&family, &selectors](const ClientMetric& metric) {
+      return std::none_of(selectors.begin(), selectors.end(),
+                          [&family, &metric](const SeriesSelector& selector) {
+                            return selector.Matches(family, metric);
+                          });
+    };
+    family.metric.erase(std::remove_if(family.metric.begin(),
+                                       family.metric.end(), not_selected),
+                        family.metric.end());
+  }
+  families.erase(std::remove_if(families.begin(), families.end(),
+                                [](const MetricFamily& family) {
+                                  return family.metric.empty();
+                                }),
+                 families.end());
+}
+
+// Serializes ranges of about the same number of series on the threads of the
+// pool and concatenates them in order. The families are moved from.
+static std::string SerializeParallel(const Serializer& serializer,
+                                     std::vector<MetricFamily>& metrics,
+                                     WorkerPool& pool) {
+  // a few more ranges than threads, so a slow range does not hold up the rest
+  const auto num_ranges = std::min(metrics.size(), 4 * (pool.Size() + 1));
+  auto total_series = std::size_t{0};
+  for (const auto& family : metrics) {
+    total_series += family.metric.size();
+  }
+
+  auto range_ends = std::vector<std::size_t>{};
+  range_ends.reserve(num_ranges);
+  auto series = std::size_t{0};
+  for (std::size_t i = 0; i < metrics.size(); ++i) {
+    series += metrics[i].metric.size();
+    // a range ends once it has its share of the series
+    if (series * num_ranges >= total_series * (range_ends.size() + 1) &&
+        range_ends.size() + 1 < num_ranges) {
+      range_ends.push_back(i + 1);
+    }
+  }
+  range_ends.push_back(metrics.size());
+
+  auto parts = std::vector<std::string>(range_ends.size());
+  pool.ParallelFor(parts.size(), [&](std::size_t i) {
+    auto begin = metrics.begin() + (i == 0 ? 0 : range_ends[i - 1]);
+    auto end = metrics.begin() + range_ends[i];
+    auto range = std::vector<MetricFamily>(std::make_move_iterator(begin),
+                                           std::make_move_iterator(end));
+    std::ostringstream out;
+    serializer.SerializePart(out, range);
+    parts[i] = out.str();
+  });
+
+  std::ostringstream end;
+  serializer.SerializeEnd(end);
+  parts.push_back(end.str());
+
+  auto size = std::size_t{0};
+  for (const auto& part : parts) {
+    size += part.size();
+  }
+  auto body = std::string{};
+  body.reserve(size);
+  for (const auto& part : parts) {
+    body += part;
+  }
+  return body;
+}
+
+static void WriteBadRequest(struct mg_connection* conn,
+                            const std::string& message) {
   mg_printf(conn,
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: text/plain\r\n");
+            "HTTP/1.1 400 Bad Request\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: %lu\r\n\r\n",
+            static_cast<unsigned long>(message.size()));
+  mg_write(conn, message.data(), message.size());
+}
+
+// Time spent compressing and writing a response, and its compressed size,
+// which is 0 if compression failed
+struct WriteStats {
+  bool compressed = false;
+  double compress_seconds = 0;
+  std::size_t compressed_size = 0;
+  double write_seconds = 0;
+};
 
+static std::size_t WriteResponse(struct mg_connection* conn,
+                                 const std::string& content_type,
+                                 const std::string& body, WriteStats* stats) {
 #ifdef HAVE_ZLIB
   auto acceptsGzip = IsEncodingAccepted(conn, "gzip");
 
   if (acceptsGzip) {
+    auto start_of_compress = std::chrono::steady_clock::now();
     auto compressed = GZipCompress(body);
+    stats->compressed = true;
+    stats->compress_seconds = SecondsSince(start_of_compress);
     if (!compressed.empty()) {
+      stats->compressed_size = compressed.size();
+      auto start_of_write = std::chrono::steady_clock::now();
       mg_printf(conn,
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: %s\r\n"
                 "Content-Encoding: gzip\r\n"
                 "Content-Length: %lu\r\n\r\n",
+                content_type.c_str(),
                 static_cast<unsigned long>(compressed.size()));
       mg_write(conn, compressed.data(), compressed.size());
+      stats->write_seconds = SecondsSince(start_of_write);
       return compressed.size();
     }
   }
 #endif
 
-  mg_printf(conn, "Content-Length: %lu\r\n\r\n",
-            static_cast<unsigned long>(body.size()));
+  auto start_of_write = std::chrono::steady_clock::now();
+  mg_printf(conn,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %lu\r\n\r\n",
+            content_type.c_str(), static_cast<unsigned long>(body.size()));
   mg_write(conn, body.data(), body.size());
+  stats->write_seconds = SecondsSince(start_of_write);
   return body.size();
 }
 
 bool MetricsHandler::handleGet(CivetServer*, struct mg_connection* conn) {
   auto start_time_of_request = std::chrono::steady_clock::now();
 
-  auto metrics = CollectMetrics(collectables_);
+  auto query = ScrapeQuery{};
+  auto error = std::string{};
+  if (!ParseQuery(conn, &query, &error)) {
+    WriteBadRequest(conn, error);
+    return true;
+  }
 
-  auto serializer = std::unique_ptr<Serializer>{new TextSerializer()};
+  auto start_of_collect = std::chrono::steady_clock::now();
+  auto metrics = std::vector<MetricFamily>{};
+  if (!query.names.empty()) {
+    metrics = CollectMetrics(collectables_, query.names);
+    if (query.shards != 0) {
+      metrics.erase(std::remove_if(metrics.begin(), metrics.end(),
+                                   [&query](const MetricFamily& family) {
+                                     return shard_of(family.name,
+                                                     query.shards) !=
+                                            query.shard;
+                                   }),
+                    metrics.end());
+    }
+  } else if (query.shards != 0) {
+    metrics = CollectMetrics(collectables_, query.shard, query.shards);
+  } else if (pool_) {
+    metrics = CollectMetrics(collectables_, *pool_);
+  } else {
+    metrics = CollectMetrics(collectables_);
+  }
+  FilterSeries(metrics, query.selectors);
+  collect_duration_.Observe(SecondsSince(start_of_collect));
 
-  auto bodySize = WriteResponse(conn, serializer->Serialize(metrics));
+  auto series = std::size_t{0};
+  for (const auto& family : metrics) {
+    series += family.metric.size();
+  }
+  scraped_series_.Observe(series);
+
+  auto start_of_serialize = std::chrono::steady_clock::now();
+  auto serializer = NegotiateSerializer(conn);
+  auto body = pool_ ? SerializeParallel(*serializer, metrics, *pool_)
+                    : serializer->Serialize(metrics);
+  serialize_duration_.Observe(SecondsSince(start_of_serialize));
+  body_size_.Observe(body.size());
+
+  auto stats = WriteStats{};
+  auto bodySize = WriteResponse(conn, serializer->ContentType(), body, &stats);
+  if (stats.compressed) {
+    compress_duration_.Observe(stats.compress_seconds);
+  }
+  if (stats.compressed_size != 0) {
+    compressed_body_size_.Observe(stats.compressed_size);
+  }
+  write_duration_.Observe(stats.write_seconds);
 
   auto stop_time_of_request = std::chrono::steady_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
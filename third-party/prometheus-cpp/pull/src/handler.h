@@ -5,6 +5,8 @@
 
 #include "CivetServer.h"
 #include "prometheus/counter.h"
+#include "prometheus/detail/worker_pool.h"
+#include "prometheus/histogram.h"
 #include "prometheus/registry.h"
 #include "prometheus/summary.h"
 
@@ -13,18 +15,31 @@ namespace detail {
 class MetricsHandler : public CivetHandler {
  public:
   MetricsHandler(const std::vector<std::weak_ptr<Collectable>>& collectables,
-                 Registry& registry);
+                 Registry& registry, WorkerPool* pool = nullptr);
 
   bool handleGet(CivetServer* server, struct mg_connection* conn) override;
 
  private:
   const std::vector<std::weak_ptr<Collectable>>& collectables_;
+  // collects and serializes a scrape concurrently if set
+  WorkerPool* pool_;
   Family<Counter>& bytes_transferred_family_;
   Counter& bytes_transferred_;
   Family<Counter>& num_scrapes_family_;
   Counter& num_scrapes_;
   Family<Summary>& request_latencies_family_;
   Summary& request_latencies_;
+  // histograms, unlike the summary, can be aggregated across exposers
+  Family<Histogram>& phase_durations_family_;
+  Histogram& collect_duration_;
+  Histogram& serialize_duration_;
+  Histogram& compress_duration_;
+  Histogram& write_duration_;
+  Family<Histogram>& body_sizes_family_;
+  Histogram& body_size_;
+  Histogram& compressed_body_size_;
+  Family<Histogram>& scraped_series_family_;
+  Histogram& scraped_series_;
 };
 }  // namespace detail
 }  // namespace prometheus
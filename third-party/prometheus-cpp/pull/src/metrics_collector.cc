@@ -24,5 +24,65 @@ std::vector<MetricFamily> CollectMetrics(
   return collected_metrics;
 }
 
+std::vector<MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    const std::set<std::string>& names) {
+  auto collected_metrics = std::vector<MetricFamily>{};
+
+  for (auto&& wcollectable : collectables) {
+    auto collectable = wcollectable.lock();
+    if (!collectable) {
+      continue;
+    }
+
+    auto&& metrics = collectable->CollectFamilies(names);
+    collected_metrics.insert(collected_metrics.end(),
+                             std::make_move_iterator(metrics.begin()),
+                             std::make_move_iterator(metrics.end()));
+  }
+
+  return collected_metrics;
+}
+
+std::vector<MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    std::size_t shard, std::size_t shards) {
+  auto collected_metrics = std::vector<MetricFamily>{};
+
+  for (auto&& wcollectable : collectables) {
+    auto collectable = wcollectable.lock();
+    if (!collectable) {
+      continue;
+    }
+
+    auto&& metrics = collectable->CollectShard(shard, shards);
+    collected_metrics.insert(collected_metrics.end(),
+                             std::make_move_iterator(metrics.begin()),
+                             std::make_move_iterator(metrics.end()));
+  }
+
+  return collected_metrics;
+}
+
+std::vector<MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    WorkerPool& pool) {
+  auto collected_metrics = std::vector<MetricFamily>{};
+
+  for (auto&& wcollectable : collectables) {
+    auto collectable = wcollectable.lock();
+    if (!collectable) {
+      continue;
+    }
+
+    auto&& metrics = collectable->CollectParallel(pool);
+    collected_metrics.insert(collected_metrics.end(),
+                             std::make_move_iterator(metrics.begin()),
+                             std::make_move_iterator(metrics.end()));
+  }
+
+  return collected_metrics;
+}
+
 }  // namespace detail
 }  // namespace prometheus
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "prometheus/metric_family.h"
@@ -8,7 +11,24 @@
 namespace prometheus {
 class Collectable;
 namespace detail {
+class WorkerPool;
+
 std::vector<prometheus::MetricFamily> CollectMetrics(
     const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables);
+
+// Collects the families with the given names only
+std::vector<prometheus::MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    const std::set<std::string>& names);
+
+// Collects the families of one shard only
+std::vector<prometheus::MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    std::size_t shard, std::size_t shards);
+
+// Collects the parts of each collectable on the threads of the pool
+std::vector<prometheus::MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    WorkerPool& pool);
 }  // namespace detail
 }  // namespace prometheus
@@ -0,0 +1,195 @@
+#include "series_selector.h"
+
+#include <cctype>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+class Scanner {
+ public:
+  explicit Scanner(const std::string& input) : input_(input) {}
+
+  bool AtEnd() {
+    SkipSpace();
+    return pos_ == input_.size();
+  }
+
+  bool Consume(char c) {
+    SkipSpace();
+    if (pos_ < input_.size() && input_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // [a-zA-Z_:][a-zA-Z0-9_:]* for metric names, without ':' for labels
+  std::string Identifier(bool allow_colon) {
+    SkipSpace();
+    auto begin = pos_;
+    while (pos_ < input_.size()) {
+      auto c = static_cast<unsigned char>(input_[pos_]);
+      if (!(std::isalpha(c) || c == '_' || (allow_colon && c == ':') ||
+            (pos_ > begin && std::isdigit(c)))) {
+        break;
+      }
+      ++pos_;
+    }
+    return input_.substr(begin, pos_ - begin);
+  }
+
+  // a value in double or single quotes or backticks, the latter without
+  // escape sequences
+  bool QuotedString(std::string* value) {
+    SkipSpace();
+    if (pos_ == input_.size()) {
+      return false;
+    }
+    auto quote = input_[pos_];
+    if (quote != '"' && quote != '\'' && quote != '`') {
+      return false;
+    }
+    for (++pos_; pos_ < input_.size(); ++pos_) {
+      auto c = input_[pos_];
+      if (c == quote) {
+        ++pos_;
+        return true;
+      }
+      if (c == '\\' && quote != '`' && pos_ + 1 < input_.size()) {
+        c = input_[++pos_];
+        switch (c) {
+          case 'n':
+            c = '\n';
+            break;
+          case 't':
+            c = '\t';
+            break;
+          default:
+            break;
+        }
+      }
+      value->push_back(c);
+    }
+    return false;
+  }
+
+ private:
+  void SkipSpace() {
+    while (pos_ < input_.size() &&
+           std::isspace(static_cast<unsigned char>(input_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+  const std::string& input_;
+  std::size_t pos_ = 0;
+};
+
+const std::string kNameLabel = "__name__";
+
+}  // namespace
+
+bool SeriesSelector::Parse(const std::string& selector) {
+  name_.clear();
+  matchers_.clear();
+
+  Scanner scanner{selector};
+  name_ = scanner.Identifier(true);
+  if (scanner.Consume('{')) {
+    while (!scanner.Consume('}')) {
+      auto matcher = Matcher{};
+      matcher.label = scanner.Identifier(false);
+      if (matcher.label.empty()) {
+        return false;
+      }
+      if (scanner.Consume('=')) {
+        matcher.op =
+            scanner.Consume('~') ? Operator::RegexMatch : Operator::Equal;
+      } else if (scanner.Consume('!')) {
+        if (scanner.Consume('=')) {
+          matcher.op = Operator::NotEqual;
+        } else if (scanner.Consume('~')) {
+          matcher.op = Operator::RegexNoMatch;
+        } else {
+          return false;
+        }
+      } else {
+        return false;
+      }
+      if (!scanner.QuotedString(&matcher.value)) {
+        return false;
+      }
+      if (matcher.op == Operator::RegexMatch ||
+          matcher.op == Operator::RegexNoMatch) {
+        try {
+          matcher.regex = std::regex{matcher.value};
+        } catch (const std::regex_error&) {
+          return false;
+        }
+      }
+
+      if (matcher.label == kNameLabel && matcher.op == Operator::Equal) {
+        // a name given twice must be the same
+        if (!name_.empty() && name_ != matcher.value) {
+          return false;
+        }
+        name_ = matcher.value;
+      } else {
+        matchers_.push_back(std::move(matcher));
+      }
+
+      if (!scanner.Consume(',')) {
+        if (!scanner.Consume('}')) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+  return scanner.AtEnd() && !(name_.empty() && matchers_.empty());
+}
+
+bool SeriesSelector::Matches(const MetricFamily& family,
+                             const ClientMetric& metric) const {
+  if (!name_.empty() && family.name != name_) {
+    return false;
+  }
+  static const std::string kMissing;
+  for (const auto& matcher : matchers_) {
+    const std::string* value = &kMissing;
+    if (matcher.label == kNameLabel) {
+      value = &family.name;
+    } else {
+      for (const auto& label : metric.label) {
+        if (label.name == matcher.label) {
+          value = &label.value;
+          break;
+        }
+      }
+    }
+    if (!Matches(matcher, *value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SeriesSelector::Matches(const Matcher& matcher,
+                             const std::string& value) const {
+  switch (matcher.op) {
+    case Operator::Equal:
+      return value == matcher.value;
+    case Operator::NotEqual:
+      return value != matcher.value;
+    case Operator::RegexMatch:
+      return std::regex_match(value, matcher.regex);
+    case Operator::RegexNoMatch:
+      return !std::regex_match(value, matcher.regex);
+  }
+  return false;
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "prometheus/client_metric.h"
+#include "prometheus/metric_family.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief A series selector as accepted by the match[] parameter of the
+/// Prometheus federation endpoint, e.g., `up{job="api",instance=~"a.*"}`.
+///
+/// Label values are compared with =, !=, =~ and !~. Regular expressions are
+/// anchored at both ends. A label the series does not have matches like an
+/// empty value. The label `__name__` refers to the name of the family, so
+/// `http_requests` selects the samples `http_requests_sum`,
+/// `http_requests_count` and so on of a summary as well.
+class SeriesSelector {
+ public:
+  /// \brief Parse a selector.
+  ///
+  /// \return False if the selector is not valid or selects nothing.
+  bool Parse(const std::string& selector);
+
+  /// \brief Returns the name of the family the selector is restricted to,
+  /// empty if it may select series of any family.
+  const std::string& Name() const { return name_; }
+
+  /// \brief Returns true if the series of the family is selected.
+  bool Matches(const MetricFamily& family, const ClientMetric& metric) const;
+
+ private:
+  enum class Operator { Equal, NotEqual, RegexMatch, RegexNoMatch };
+
+  struct Matcher {
+    std::string label;
+    Operator op;
+    std::string value;
+    std::regex regex;
+  };
+
+  bool Matches(const Matcher& matcher, const std::string& value) const;
+
+  std::string name_;
+  std::vector<Matcher> matchers_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
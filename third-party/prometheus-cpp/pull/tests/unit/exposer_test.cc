@@ -2,6 +2,16 @@
 
 #include <gmock/gmock.h>
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civetweb.h"
+#include "prometheus/counter.h"
+#include "prometheus/registry.h"
+
 namespace prometheus {
 namespace {
 
@@ -21,5 +31,215 @@ TEST(ExposerTest, listenOnDistinctPorts) {
   EXPECT_NE(firstExposerPorts, secondExposerPorts);
 }
 
+// content type of the response to a scrape with the given Accept header
+std::string ScrapeContentType(int port, const std::string& accept) {
+  char error[256] = {};
+  auto request = "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\n" + accept +
+                 "Connection: close\r\n\r\n";
+  auto conn = mg_download("127.0.0.1", port, 0, error, sizeof(error), "%s",
+                          request.c_str());
+  if (!conn) {
+    ADD_FAILURE() << error;
+    return {};
+  }
+  auto content_type = mg_get_header(conn, "Content-Type");
+  auto result = std::string{content_type ? content_type : ""};
+  mg_close_connection(conn);
+  return result;
+}
+
+// body of the response to a GET of the given path
+std::string Scrape(int port, const std::string& path, int* status) {
+  char error[256] = {};
+  auto conn = mg_download("127.0.0.1", port, 0, error, sizeof(error),
+                          "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                          "Connection: close\r\n\r\n",
+                          path.c_str());
+  if (!conn) {
+    ADD_FAILURE() << error;
+    return {};
+  }
+  *status = mg_get_response_info(conn)->status_code;
+  auto body = std::string{};
+  char buffer[4096];
+  int read;
+  while ((read = mg_read(conn, buffer, sizeof(buffer))) > 0) {
+    body.append(buffer, read);
+  }
+  mg_close_connection(conn);
+  return body;
+}
+
+TEST(ExposerTest, filterScrape) {
+  Exposer exposer{"127.0.0.1:0"};
+  auto registry = std::make_shared<Registry>();
+  auto& requests = BuildCounter().Name("requests_total").Register(*registry);
+  requests.Add({{"job", "api"}});
+  requests.Add({{"job", "web"}});
+  BuildCounter().Name("errors_total").Register(*registry).Add({});
+  exposer.RegisterCollectable(registry);
+  auto port = exposer.GetListeningPorts().front();
+  int status = 0;
+
+  auto body = Scrape(port, "/metrics?name[]=errors_total", &status);
+  EXPECT_EQ(200, status);
+  EXPECT_THAT(body, HasSubstr("errors_total"));
+  EXPECT_THAT(body, Not(HasSubstr("requests_total")));
+  EXPECT_THAT(body, Not(HasSubstr("exposer_scrapes_total")));
+
+  // match[]=requests_total{job=~"a.*"}
+  body = Scrape(port,
+                "/metrics?match%5B%5D=requests_total%7Bjob%3D~%22a.*%22%7D",
+                &status);
+  EXPECT_EQ(200, status);
+  EXPECT_THAT(body, HasSubstr("requests_total{job=\"api\"}"));
+  EXPECT_THAT(body, Not(HasSubstr("web")));
+  EXPECT_THAT(body, Not(HasSubstr("errors_total")));
+
+  // match[]={job!="api"}
+  body = Scrape(port, "/metrics?match[]=%7Bjob!%3D%22api%22%7D", &status);
+  EXPECT_THAT(body, HasSubstr("requests_total{job=\"web\"}"));
+  EXPECT_THAT(body, Not(HasSubstr("job=\"api\"")));
+
+  body = Scrape(port, "/metrics?name[]=errors_total&match[]=requests_total",
+                &status);
+  EXPECT_THAT(body, Not(HasSubstr("_total")));
+
+  Scrape(port, "/metrics?match[]=%7Bjob%3D~%22(%22%7D", &status);
+  EXPECT_EQ(400, status);
+}
+
+TEST(ExposerTest, shardScrape) {
+  Exposer exposer{"127.0.0.1:0", 2};
+  auto registry = std::make_shared<Registry>();
+  const std::vector<std::string> names{"a_total", "b_total", "c_total",
+                                       "d_total", "e_total"};
+  for (const auto& name : names) {
+    BuildCounter().Name(name).Register(*registry).Add({});
+  }
+  exposer.RegisterCollectable(registry);
+  auto port = exposer.GetListeningPorts().front();
+  int status = 0;
+
+  const auto first = Scrape(port, "/metrics/shard/0?of=2", &status);
+  EXPECT_EQ(200, status);
+  const auto second = Scrape(port, "/metrics?shard=1&of=2", &status);
+  EXPECT_EQ(200, status);
+  for (const auto& name : names) {
+    auto line = "\n" + name + " ";
+    EXPECT_NE(first.find(line) == std::string::npos,
+              second.find(line) == std::string::npos)
+        << name;
+  }
+
+  Scrape(port, "/metrics/shard/2?of=2", &status);
+  EXPECT_EQ(400, status);
+  Scrape(port, "/metrics?shard=0", &status);
+  EXPECT_EQ(400, status);
+  Scrape(port, "/metrics?shard=x&of=2", &status);
+  EXPECT_EQ(400, status);
+}
+
+TEST(ExposerTest, collectInParallel) {
+  Exposer exposer{"127.0.0.1:0", 1, 3};
+  auto registry = std::make_shared<Registry>();
+  std::vector<std::string> names;
+  for (auto i = 0; i < 50; ++i) {
+    names.push_back("family_" + std::to_string(i) + "_total");
+    auto& family = BuildCounter().Name(names.back()).Register(*registry);
+    for (auto j = 0; j < i; ++j) {
+      family.Add({{"index", std::to_string(j)}});
+    }
+  }
+  exposer.RegisterCollectable(registry);
+  auto port = exposer.GetListeningPorts().front();
+  int status = 0;
+
+  const auto body = Scrape(port, "/metrics", &status);
+  EXPECT_EQ(200, status);
+  // the families are in the order they were registered in
+  std::size_t previous = 0;
+  for (const auto& name : names) {
+    auto position = body.find("# TYPE " + name + " ");
+    ASSERT_NE(position, std::string::npos) << name;
+    EXPECT_GT(position, previous) << name;
+    previous = position;
+  }
+  EXPECT_THAT(body, HasSubstr("family_49_total{index=\"48\"} "));
+}
+
+TEST(ExposerTest, recordScrapePhases) {
+  Exposer exposer{"127.0.0.1:0"};
+  auto registry = std::make_shared<Registry>();
+  auto& family = BuildCounter().Name("scraped_total").Register(*registry);
+  family.Add({{"index", "1"}});
+  family.Add({{"index", "2"}});
+  exposer.RegisterCollectable(registry);
+  auto port = exposer.GetListeningPorts().front();
+  int status = 0;
+
+  Scrape(port, "/metrics", &status);
+  const auto body = Scrape(port, "/metrics", &status);
+  EXPECT_EQ(200, status);
+  for (const auto& phase : {"collect", "serialize"}) {
+    EXPECT_THAT(body, HasSubstr("exposer_scrape_phase_duration_seconds_count"
+                                "{phase=\"" +
+                                std::string{phase} + "\"} 1\n"));
+  }
+  // the write is recorded after the response was sent, so the client may
+  // see the response before it
+  const std::string no_write =
+      "exposer_scrape_phase_duration_seconds_count{phase=\"write\"} 0\n";
+  auto later_body = body;
+  for (int i = 0; i < 100 && later_body.find(no_write) != std::string::npos;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    later_body = Scrape(port, "/metrics", &status);
+  }
+  EXPECT_THAT(later_body, Not(HasSubstr(no_write)));
+  EXPECT_THAT(body, HasSubstr("exposer_response_body_bytes_count{encoding=\""
+                              "identity\"} 1\n"));
+  // the first scrape saw the series of the registry and of the endpoint
+  EXPECT_THAT(body, HasSubstr("exposer_scraped_series_count 1\n"));
+  EXPECT_THAT(body, Not(HasSubstr("exposer_scraped_series_sum 0")));
+}
+
+TEST(ExposerTest, negotiateFormat) {
+  Exposer exposer{"127.0.0.1:0"};
+  auto registry = std::make_shared<Registry>();
+  BuildCounter().Name("scraped_total").Help("").Register(*registry).Add({});
+  exposer.RegisterCollectable(registry);
+  auto port = exposer.GetListeningPorts().front();
+
+  EXPECT_THAT(ScrapeContentType(port, ""), StartsWith("text/plain"));
+  EXPECT_THAT(
+      ScrapeContentType(port,
+                        "Accept: application/vnd.google.protobuf;"
+                        "proto=io.prometheus.client.MetricFamily;"
+                        "encoding=delimited;q=0.7,text/plain;version=0.0.4;"
+                        "q=0.3,*/*;q=0.1\r\n"),
+      StartsWith("application/vnd.google.protobuf"));
+  EXPECT_THAT(
+      ScrapeContentType(port,
+                        "Accept: application/vnd.google.protobuf;"
+                        "proto=io.prometheus.client.MetricFamily;"
+                        "encoding=delimited;q=0.3,text/plain;q=0.7\r\n"),
+      StartsWith("text/plain"));
+  EXPECT_THAT(ScrapeContentType(port,
+                                "Accept: application/vnd.google.protobuf;"
+                                "proto=other.Message;encoding=delimited\r\n"),
+              StartsWith("text/plain"));
+  EXPECT_THAT(
+      ScrapeContentType(port,
+                        "Accept: application/openmetrics-text;version=1.0.0,"
+                        "application/openmetrics-text;version=0.0.1;q=0.75,"
+                        "text/plain;version=0.0.4;q=0.5,*/*;q=0.1\r\n"),
+      StartsWith("application/openmetrics-text"));
+  EXPECT_THAT(ScrapeContentType(port,
+                                "Accept: application/openmetrics-text;"
+                                "version=2.0.0\r\n"),
+              StartsWith("text/plain"));
+}
+
 }  // namespace
 }  // namespace prometheus
@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include <prometheus/counter.h>
+#include <prometheus/gateway.h>
+#include <prometheus/registry.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stub_gateway.h"
+
+static void BM_Gateway_Push(benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::Gateway;
+  using prometheus::Registry;
+  using prometheus::StubGateway;
+  StubGateway stub;
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "benchmark_job"};
+
+  // all collectables share the grouping key and go out in one request
+  std::vector<std::shared_ptr<Registry>> registries;
+  for (auto i = 0; i < state.range(0); ++i) {
+    auto registry = std::make_shared<Registry>();
+    auto& family = BuildCounter()
+                       .Name("benchmark_counter_" + std::to_string(i))
+                       .Help("")
+                       .Register(*registry);
+    for (auto j = 0; j < 10; ++j) {
+      family.Add({{"index", std::to_string(j)}});
+    }
+    gateway.RegisterCollectable(registry);
+    registries.push_back(registry);
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(gateway.Push());
+  }
+  state.counters["pushes"] =
+      benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Gateway_Push)->Arg(1)->Arg(16)->UseRealTime();
+
+static void BM_Gateway_AsyncPush(benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::Gateway;
+  using prometheus::Registry;
+  using prometheus::StubGateway;
+  StubGateway stub;
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "benchmark_job"};
+
+  // one grouping key and thereby one request per collectable
+  std::vector<std::shared_ptr<Registry>> registries;
+  for (auto i = 0; i < state.range(0); ++i) {
+    auto registry = std::make_shared<Registry>();
+    BuildCounter().Name("benchmark_counter").Help("").Register(*registry).Add(
+        {});
+    const auto labels = Gateway::Labels{{"shard", std::to_string(i)}};
+    gateway.RegisterCollectable(registry, &labels);
+    registries.push_back(registry);
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(gateway.AsyncPush().get());
+  }
+  state.counters["pushes"] =
+      benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Gateway_AsyncPush)->Arg(1)->Arg(16)->UseRealTime();
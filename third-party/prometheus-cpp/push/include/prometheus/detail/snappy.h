@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "prometheus/detail/push_export.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Compress the input in the snappy block format.
+///
+/// This is the format required by the Prometheus remote write protocol, not
+/// the framed snappy stream format.
+PROMETHEUS_CPP_PUSH_EXPORT std::string SnappyCompress(const std::string& input);
+
+/// \brief Uncompress a block in the snappy block format.
+///
+/// \return false if the input is not a valid block.
+PROMETHEUS_CPP_PUSH_EXPORT bool SnappyUncompress(const std::string& input,
+                                                 std::string* output);
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -4,6 +4,7 @@
 #include <iosfwd>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -12,6 +13,18 @@
 
 namespace prometheus {
 
+namespace detail {
+class CurlWrapper;
+enum class HttpMethod;
+struct HttpRequest;
+}  // namespace detail
+
+/// \brief Pushes the metrics of the registered collectables to a
+/// pushgateway.
+///
+/// The metrics of all collectables registered with the same labels, i.e.
+/// the same grouping key, are sent in one request. Connections to the
+/// pushgateway are kept alive and reused by later requests.
 class PROMETHEUS_CPP_PUSH_EXPORT Gateway {
  public:
   using Labels = std::map<std::string, std::string>;
@@ -43,27 +56,29 @@ class PROMETHEUS_CPP_PUSH_EXPORT Gateway {
   std::future<int> AsyncDelete();
 
  private:
+  friend class PeriodicPusher;
+
   std::string jobUri_;
   std::string labels_;
-  std::string auth_;
+  std::unique_ptr<detail::CurlWrapper> curlWrapper_;
 
   using CollectableEntry = std::pair<std::weak_ptr<Collectable>, std::string>;
   std::vector<CollectableEntry> collectables_;
+  // collectables may be registered while a PeriodicPusher collects
+  mutable std::mutex mutex_;
 
-  std::string getUri(const CollectableEntry& collectable) const;
+  std::string getUri(const std::string& groupingLabels) const;
 
-  enum class HttpMethod {
-    Post,
-    Put,
-    Delete,
-  };
+  // one request per grouping key with the metrics of all its collectables
+  std::vector<detail::HttpRequest> collectRequests(
+      detail::HttpMethod method) const;
 
-  int performHttpRequest(HttpMethod method, const std::string& uri,
-                         const std::string& body) const;
+  int performHttpRequests(
+      const std::vector<detail::HttpRequest>& requests) const;
 
-  int push(HttpMethod method);
+  int push(detail::HttpMethod method);
 
-  std::future<int> async_push(HttpMethod method);
+  std::future<int> async_push(detail::HttpMethod method);
 };
 
 }  // namespace prometheus
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "prometheus/counter.h"
+#include "prometheus/detail/push_export.h"
+#include "prometheus/gateway.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+
+namespace prometheus {
+
+/// \brief Pushes the metrics of a Gateway from a background thread.
+///
+/// Every interval the collectables of the gateway are collected and
+/// serialized once. The payload is queued and sent by the same thread, so a
+/// slow or unavailable gateway never blocks the caller.
+///
+/// While the gateway fails, up to max_buffered payloads are kept, the oldest
+/// is dropped when another one is queued. Failed pushes are retried after an
+/// exponential backoff between min_backoff and max_backoff, randomized to
+/// half to full length. Buffered payloads are sent oldest first, so the
+/// gateway ends up with the latest values. A request the gateway does not
+/// answer within timeout fails, so it cannot stop the pusher.
+///
+/// The pusher reports on itself in the registry returned by GetRegistry().
+/// It is not registered anywhere, e.g. pass it to
+/// Gateway::RegisterCollectable() before constructing the pusher.
+class PROMETHEUS_CPP_PUSH_EXPORT PeriodicPusher {
+ public:
+  struct Options {
+    std::chrono::milliseconds interval{std::chrono::seconds(15)};
+    std::size_t max_buffered = 10;
+    std::chrono::milliseconds min_backoff{std::chrono::seconds(1)};
+    std::chrono::milliseconds max_backoff{std::chrono::minutes(1)};
+    /// \brief Limit of connecting and of each request, zero to wait forever.
+    std::chrono::milliseconds timeout{std::chrono::seconds(10)};
+  };
+
+  /// \brief Start pushing the metrics of the given gateway.
+  ///
+  /// The gateway must outlive the pusher.
+  ///
+  /// \param registry Receives the self-metrics, a new registry is created if
+  /// none is given.
+  PeriodicPusher(Gateway& gateway, const Options& options,
+                 std::shared_ptr<Registry> registry = nullptr);
+  explicit PeriodicPusher(Gateway& gateway);
+
+  /// \brief Stop the thread, buffered payloads are discarded.
+  ~PeriodicPusher();
+
+  PeriodicPusher(const PeriodicPusher&) = delete;
+  PeriodicPusher& operator=(const PeriodicPusher&) = delete;
+
+  /// \brief Returns the registry of the self-metrics of the pusher.
+  std::shared_ptr<Registry> GetRegistry() const { return registry_; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  void Run();
+  void Enqueue();
+  // sends the buffer oldest first, returns false on the first failure
+  bool SendBuffered();
+  Clock::duration NextBackoff();
+
+  Gateway& gateway_;
+  const Options options_;
+  std::shared_ptr<Registry> registry_;
+
+  Counter& pushes_succeeded_;
+  Counter& pushes_failed_;
+  Counter& payloads_dropped_;
+  Gauge& payloads_buffered_;
+  Gauge& last_success_;
+
+  // only accessed by the thread
+  struct Payload;
+  std::deque<std::unique_ptr<Payload>> buffer_;
+  unsigned failures_ = 0;
+  std::minstd_rand random_;
+
+  // guards stop_
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+};
+
+}  // namespace prometheus
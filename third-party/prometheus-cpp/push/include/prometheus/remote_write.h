@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/counter.h"
+#include "prometheus/detail/push_export.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+
+namespace prometheus {
+
+namespace detail {
+struct RemoteWriteSample;
+}  // namespace detail
+
+/// \brief Sends the metrics of the registered collectables to a Prometheus
+/// remote write endpoint, e.g., http://127.0.0.1:9090/api/v1/write.
+///
+/// Send() only queues series whose value changed since they were sent last,
+/// or that were not sent for resend_unchanged, so that they do not become
+/// stale. Families that track their changes, like Family<ColumnarGauge>,
+/// only report their changed series, see Collectable::CollectChanged(). All
+/// other series are compared against the value sent last. Each sample
+/// carries the timestamp of its metric if set, otherwise the time of
+/// collection.
+///
+/// Series are spread over a number of shards by their labels. Every shard
+/// has its own thread and connection that encodes the WriteRequest protobuf
+/// message, compresses it with snappy and posts it. The samples of a series
+/// are therefore sent in order. A shard queues up to max_queued_batches
+/// batches in memory and drops the oldest one on overflow. Failed requests,
+/// including those not answered within timeout, are retried with an
+/// exponential backoff unless the endpoint rejected the batch with a client
+/// error. After a batch was dropped, the next Send() queues all series
+/// again.
+///
+/// The sink reports on itself in the registry returned by GetRegistry().
+class PROMETHEUS_CPP_PUSH_EXPORT RemoteWrite {
+ public:
+  struct Options {
+    /// \brief Period of Send() by a background thread, zero to call Send()
+    /// only explicitly.
+    std::chrono::milliseconds interval{std::chrono::seconds(15)};
+    std::size_t shards = 4;
+    std::size_t max_samples_per_send = 2000;
+    std::size_t max_queued_batches = 100;
+    /// \brief Zero to send unchanged series never again.
+    std::chrono::milliseconds resend_unchanged{std::chrono::minutes(1)};
+    std::chrono::milliseconds min_backoff{std::chrono::milliseconds(100)};
+    std::chrono::milliseconds max_backoff{std::chrono::seconds(5)};
+    /// \brief Limit of connecting and of each request, zero to wait forever.
+    std::chrono::milliseconds timeout{std::chrono::seconds(10)};
+  };
+
+  RemoteWrite(const std::string& url, const Options& options,
+              const std::string& username = {},
+              const std::string& password = {});
+  explicit RemoteWrite(const std::string& url);
+
+  /// \brief Stop all threads, queued batches are discarded.
+  ~RemoteWrite();
+
+  RemoteWrite(const RemoteWrite&) = delete;
+  RemoteWrite& operator=(const RemoteWrite&) = delete;
+
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  /// \brief Collect and queue the changed series.
+  ///
+  /// \return The number of queued samples.
+  std::size_t Send();
+
+  /// \brief Returns the registry of the self-metrics of the sink.
+  std::shared_ptr<Registry> GetRegistry() const { return registry_; }
+
+ private:
+  class Shard;
+  using Clock = std::chrono::steady_clock;
+
+  struct SeriesState {
+    double value;
+    Clock::time_point sent;
+    std::uint64_t generation;
+  };
+
+  struct Source {
+    std::weak_ptr<Collectable> collectable;
+    ChangeCursor cursor;
+  };
+
+  void Run();
+  // returns whether the sample has to be sent
+  bool Changed(const std::string& key, double value, Clock::time_point now);
+  void Queue(std::vector<detail::RemoteWriteSample>& batch, Shard& shard);
+
+  const Options options_;
+  std::shared_ptr<Registry> registry_;
+
+  Counter& samples_sent_;
+  Counter& samples_dropped_;
+  Counter& requests_succeeded_;
+  Counter& requests_failed_;
+  Gauge& batches_queued_;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // guards the members below
+  std::mutex mutex_;
+  std::vector<Source> sources_;
+  std::unordered_map<std::string, SeriesState> series_;
+  std::uint64_t generation_ = 0;
+  // last time all series of families that track their changes were queued
+  Clock::time_point refreshed_;
+  // set by the shards when they drop a batch
+  std::atomic<bool> resend_all_{false};
+
+  bool stop_ = false;
+  std::condition_variable wake_;
+  std::thread thread_;
+};
+
+}  // namespace prometheus
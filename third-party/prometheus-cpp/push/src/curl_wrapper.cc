@@ -0,0 +1,137 @@
+#include "curl_wrapper.h"
+
+namespace prometheus {
+namespace detail {
+
+static const char CONTENT_TYPE[] =
+    "Content-Type: text/plain; version=0.0.4; charset=utf-8";
+
+CurlWrapper::CurlWrapper(const std::string& auth)
+    : CurlWrapper(auth, {CONTENT_TYPE}) {}
+
+CurlWrapper::CurlWrapper(const std::string& auth,
+                         const std::vector<std::string>& headers)
+    : auth_(auth) {
+  /* In windows, this will init the winsock stuff */
+  curl_global_init(CURL_GLOBAL_ALL);
+  for (auto& header : headers) {
+    header_chunk_ = curl_slist_append(header_chunk_, header.c_str());
+  }
+  multi_ = curl_multi_init();
+}
+
+CurlWrapper::~CurlWrapper() {
+  for (auto curl : handles_) {
+    curl_easy_cleanup(curl);
+  }
+  if (multi_) {
+    curl_multi_cleanup(multi_);
+  }
+  curl_slist_free_all(header_chunk_);
+  curl_global_cleanup();
+}
+
+void CurlWrapper::Prepare(CURL* curl, const HttpRequest& request,
+                          std::size_t index) {
+  // keeps the connection cache of the multi handle
+  curl_easy_reset(curl);
+
+  curl_easy_setopt(curl, CURLOPT_URL, request.uri.c_str());
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, reinterpret_cast<void*>(index));
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+  if (request.timeout.count() > 0) {
+    auto timeout_ms = static_cast<long>(request.timeout.count());
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+  }
+
+  if (!request.body.empty()) {
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_chunk_);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, request.body.size());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.data());
+  }
+
+  if (!auth_.empty()) {
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+    curl_easy_setopt(curl, CURLOPT_USERPWD, auth_.c_str());
+  }
+
+  switch (request.method) {
+    case HttpMethod::Post:
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      break;
+
+    case HttpMethod::Put:
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+      break;
+
+    case HttpMethod::Delete:
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+      break;
+  }
+}
+
+std::vector<int> CurlWrapper::Perform(const std::vector<HttpRequest>& requests) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::vector<int> status_codes(requests.size(), -CURLE_FAILED_INIT);
+  if (!multi_) {
+    return status_codes;
+  }
+
+  while (handles_.size() < requests.size()) {
+    auto curl = curl_easy_init();
+    if (!curl) {
+      break;
+    }
+    handles_.push_back(curl);
+  }
+
+  auto added = std::vector<CURL*>{};
+  for (std::size_t i = 0; i < requests.size() && i < handles_.size(); ++i) {
+    Prepare(handles_[i], requests[i], i);
+    if (curl_multi_add_handle(multi_, handles_[i]) == CURLM_OK) {
+      added.push_back(handles_[i]);
+    }
+  }
+
+  int running = 0;
+  do {
+    if (curl_multi_perform(multi_, &running) != CURLM_OK) {
+      break;
+    }
+    if (running) {
+      curl_multi_wait(multi_, nullptr, 0, 1000, nullptr);
+    }
+  } while (running);
+
+  int left = 0;
+  while (auto message = curl_multi_info_read(multi_, &left)) {
+    if (message->msg != CURLMSG_DONE) {
+      continue;
+    }
+    void* index = nullptr;
+    curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &index);
+    auto& status_code = status_codes[reinterpret_cast<std::size_t>(index)];
+    if (message->data.result != CURLE_OK) {
+      status_code = -message->data.result;
+      continue;
+    }
+    long response_code = 0;
+    curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE,
+                      &response_code);
+    status_code = response_code;
+  }
+
+  for (auto curl : added) {
+    curl_multi_remove_handle(multi_, curl);
+  }
+  return status_codes;
+}
+
+}  // namespace detail
+}  // namespace prometheus
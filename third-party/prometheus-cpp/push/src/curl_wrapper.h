@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+namespace prometheus {
+namespace detail {
+
+enum class HttpMethod {
+  Post,
+  Put,
+  Delete,
+};
+
+struct HttpRequest {
+  HttpMethod method;
+  std::string uri;
+  std::string body;
+  // of connecting and of the whole request, zero to wait forever
+  std::chrono::milliseconds timeout;
+};
+
+/// \brief Performs HTTP requests on connections that are kept alive between
+/// calls.
+///
+/// The easy handles and the multi handle, which owns the connection cache,
+/// live as long as the wrapper. Requests given to one call of Perform() are
+/// transferred concurrently by a single thread.
+///
+/// The class is thread-safe, concurrent calls of Perform() are serialized.
+class CurlWrapper {
+ public:
+  /// \brief Send bodies as text exposition format.
+  explicit CurlWrapper(const std::string& auth);
+  /// \brief Send bodies with the given headers, e.g., the content type.
+  CurlWrapper(const std::string& auth, const std::vector<std::string>& headers);
+  ~CurlWrapper();
+
+  CurlWrapper(const CurlWrapper&) = delete;
+  CurlWrapper& operator=(const CurlWrapper&) = delete;
+
+  /// \return The HTTP status code of each request or the negated curl error
+  /// code if the request failed.
+  std::vector<int> Perform(const std::vector<HttpRequest>& requests);
+
+ private:
+  void Prepare(CURL* curl, const HttpRequest& request, std::size_t index);
+
+  const std::string auth_;
+  curl_slist* header_chunk_ = nullptr;
+  CURLM* multi_ = nullptr;
+  std::vector<CURL*> handles_;
+  std::mutex mutex_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -1,33 +1,50 @@
-
 #include "prometheus/gateway.h"
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 #include <sstream>
 
+#include "curl_wrapper.h"
 #include "prometheus/client_metric.h"
 #include "prometheus/serializer.h"
 #include "prometheus/text_serializer.h"
 
-#include <curl/curl.h>
-
 namespace prometheus {
 
-static const char CONTENT_TYPE[] =
-    "Content-Type: text/plain; version=0.0.4; charset=utf-8";
+namespace {
+// The text format allows a family only once, metrics of collectables that
+// share a family are merged into it.
+void MergeFamilies(std::vector<MetricFamily>& families,
+                   std::vector<MetricFamily>&& metrics) {
+  for (auto& family : metrics) {
+    auto same_name = [&family](const MetricFamily& in) {
+      return in.name == family.name;
+    };
+    auto it = std::find_if(families.begin(), families.end(), same_name);
+    if (it == families.end()) {
+      families.push_back(std::move(family));
+      continue;
+    }
+    it->metric.insert(it->metric.end(),
+                      std::make_move_iterator(family.metric.begin()),
+                      std::make_move_iterator(family.metric.end()));
+  }
+}
+}  // namespace
 
 Gateway::Gateway(const std::string host, const std::string port,
                  const std::string jobname, const Labels& labels,
                  const std::string username, const std::string password) {
-  /* In windows, this will init the winsock stuff */
-  curl_global_init(CURL_GLOBAL_ALL);
-
   std::stringstream jobUriStream;
   jobUriStream << host << ':' << port << "/metrics/job/" << jobname;
   jobUri_ = jobUriStream.str();
 
+  auto auth = std::string{};
   if (!username.empty()) {
-    auth_ = username + ":" + password;
+    auth = username + ":" + password;
   }
+  curlWrapper_.reset(new detail::CurlWrapper(auth));
 
   std::stringstream labelStream;
   for (auto& label : labels) {
@@ -36,7 +53,7 @@ Gateway::Gateway(const std::string host, const std::string port,
   labels_ = labelStream.str();
 }
 
-Gateway::~Gateway() { curl_global_cleanup(); }
+Gateway::~Gateway() = default;
 
 const Gateway::Labels Gateway::GetInstanceLabel(std::string hostname) {
   if (hostname.empty()) {
@@ -55,141 +72,91 @@ void Gateway::RegisterCollectable(const std::weak_ptr<Collectable>& collectable,
     }
   }
 
+  std::lock_guard<std::mutex> lock{mutex_};
   collectables_.push_back(std::make_pair(collectable, ss.str()));
 }
 
-int Gateway::performHttpRequest(HttpMethod method, const std::string& uri,
-                                const std::string& body) const {
-  auto curl = curl_easy_init();
-  if (!curl) {
-    return -CURLE_FAILED_INIT;
-  }
-
-  curl_easy_setopt(curl, CURLOPT_URL, uri.c_str());
-
-  curl_slist* header_chunk = nullptr;
-
-  if (!body.empty()) {
-    header_chunk = curl_slist_append(nullptr, CONTENT_TYPE);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_chunk);
-
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body.size());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
-  }
-
-  if (!auth_.empty()) {
-    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
-    curl_easy_setopt(curl, CURLOPT_USERPWD, auth_.c_str());
-  }
-
-  switch (method) {
-    case HttpMethod::Post:
-      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      break;
-
-    case HttpMethod::Put:
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-      break;
-
-    case HttpMethod::Delete:
-      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-      break;
-  }
-
-  auto curl_error = curl_easy_perform(curl);
-
-  long response_code;
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
-  curl_easy_cleanup(curl);
-  curl_slist_free_all(header_chunk);
-
-  if (curl_error != CURLE_OK) {
-    return -curl_error;
+int Gateway::performHttpRequests(
+    const std::vector<detail::HttpRequest>& requests) const {
+  auto status_codes = curlWrapper_->Perform(requests);
+  for (auto status_code : status_codes) {
+    if (status_code < 100 || status_code >= 400) {
+      return status_code;
+    }
   }
-
-  return response_code;
+  return 200;
 }
 
-std::string Gateway::getUri(const CollectableEntry& collectable) const {
+std::string Gateway::getUri(const std::string& groupingLabels) const {
   std::stringstream uri;
-  uri << jobUri_ << labels_ << collectable.second;
+  uri << jobUri_ << labels_ << groupingLabels;
 
   return uri.str();
 }
 
-int Gateway::Push() { return push(HttpMethod::Post); }
-
-int Gateway::PushAdd() { return push(HttpMethod::Put); }
-
-int Gateway::push(HttpMethod method) {
-  const auto serializer = TextSerializer{};
+std::vector<detail::HttpRequest> Gateway::collectRequests(
+    detail::HttpMethod method) const {
+  // grouping keys in the order of registration
+  using Group = std::pair<std::string, std::vector<MetricFamily>>;
+  std::vector<Group> groups;
 
+  std::lock_guard<std::mutex> lock{mutex_};
   for (auto& wcollectable : collectables_) {
     auto collectable = wcollectable.first.lock();
     if (!collectable) {
       continue;
     }
 
-    auto metrics = collectable->Collect();
-    auto body = serializer.Serialize(metrics);
-    auto uri = getUri(wcollectable);
-    auto status_code = performHttpRequest(method, uri, body);
-
-    if (status_code < 100 || status_code >= 400) {
-      return status_code;
+    auto same_key = [&wcollectable](const Group& group) {
+      return group.first == wcollectable.second;
+    };
+    auto group = std::find_if(groups.begin(), groups.end(), same_key);
+    if (group == groups.end()) {
+      groups.emplace_back(wcollectable.second, std::vector<MetricFamily>{});
+      group = std::prev(groups.end());
     }
+    MergeFamilies(group->second, collectable->Collect());
   }
 
-  return 200;
-}
-
-std::future<int> Gateway::AsyncPush() { return async_push(HttpMethod::Post); }
-
-std::future<int> Gateway::AsyncPushAdd() { return async_push(HttpMethod::Put); }
-
-std::future<int> Gateway::async_push(HttpMethod method) {
   const auto serializer = TextSerializer{};
-  std::vector<std::future<int>> futures;
-
-  for (auto& wcollectable : collectables_) {
-    auto collectable = wcollectable.first.lock();
-    if (!collectable) {
-      continue;
-    }
+  auto requests = std::vector<detail::HttpRequest>{};
+  requests.reserve(groups.size());
+  for (auto& group : groups) {
+    requests.push_back({method, getUri(group.first),
+                        serializer.Serialize(group.second), {}});
+  }
+  return requests;
+}
 
-    auto metrics = collectable->Collect();
-    auto body = std::make_shared<std::string>(serializer.Serialize(metrics));
-    auto uri = getUri(wcollectable);
+int Gateway::Push() { return push(detail::HttpMethod::Post); }
 
-    futures.push_back(std::async(std::launch::async, [method, uri, body, this] {
-      return performHttpRequest(method, uri, *body);
-    }));
-  }
+int Gateway::PushAdd() { return push(detail::HttpMethod::Put); }
 
-  const auto reduceFutures = [](std::vector<std::future<int>> lfutures) {
-    auto final_status_code = 200;
+int Gateway::push(detail::HttpMethod method) {
+  return performHttpRequests(collectRequests(method));
+}
 
-    for (auto& future : lfutures) {
-      auto status_code = future.get();
+std::future<int> Gateway::AsyncPush() {
+  return async_push(detail::HttpMethod::Post);
+}
 
-      if (status_code < 100 || status_code >= 400) {
-        final_status_code = status_code;
-      }
-    }
+std::future<int> Gateway::AsyncPushAdd() {
+  return async_push(detail::HttpMethod::Put);
+}
 
-    return final_status_code;
-  };
+std::future<int> Gateway::async_push(detail::HttpMethod method) {
+  // the metrics are collected now, all requests are then transferred by a
+  // single thread
+  auto requests = std::make_shared<std::vector<detail::HttpRequest>>(
+      collectRequests(method));
 
-  return std::async(std::launch::async, reduceFutures, std::move(futures));
+  return std::async(std::launch::async, [requests, this] {
+    return performHttpRequests(*requests);
+  });
 }
 
 int Gateway::Delete() {
-  return performHttpRequest(HttpMethod::Delete, jobUri_, {});
+  return performHttpRequests({{detail::HttpMethod::Delete, jobUri_, {}, {}}});
 }
 
 std::future<int> Gateway::AsyncDelete() {
@@ -0,0 +1,139 @@
+#include "prometheus/periodic_pusher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "curl_wrapper.h"
+
+namespace prometheus {
+
+struct PeriodicPusher::Payload {
+  std::vector<detail::HttpRequest> requests;
+};
+
+PeriodicPusher::PeriodicPusher(Gateway& gateway, const Options& options,
+                               std::shared_ptr<Registry> registry)
+    : gateway_(gateway),
+      options_(options),
+      registry_(registry ? std::move(registry) : std::make_shared<Registry>()),
+      pushes_succeeded_(BuildCounter()
+                            .Name("pusher_pushes_total")
+                            .Help("Number of payloads sent to the gateway")
+                            .Register(*registry_)
+                            .Add({{"result", "success"}})),
+      pushes_failed_(BuildCounter()
+                         .Name("pusher_pushes_total")
+                         .Help("Number of payloads sent to the gateway")
+                         .Register(*registry_)
+                         .Add({{"result", "failure"}})),
+      payloads_dropped_(
+          BuildCounter()
+              .Name("pusher_dropped_payloads_total")
+              .Help("Number of payloads dropped because the buffer was full")
+              .Register(*registry_)
+              .Add({})),
+      payloads_buffered_(BuildGauge()
+                             .Name("pusher_buffered_payloads")
+                             .Help("Number of payloads waiting to be sent")
+                             .Register(*registry_)
+                             .Add({})),
+      last_success_(
+          BuildGauge()
+              .Name("pusher_last_success_timestamp_seconds")
+              .Help("Time of the last payload accepted by the gateway")
+              .Register(*registry_)
+              .Add({})),
+      random_(std::random_device{}()) {
+  thread_ = std::thread{&PeriodicPusher::Run, this};
+}
+
+PeriodicPusher::PeriodicPusher(Gateway& gateway)
+    : PeriodicPusher(gateway, Options{}) {}
+
+PeriodicPusher::~PeriodicPusher() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+void PeriodicPusher::Run() {
+  auto next_tick = Clock::now();
+  auto retry_at = Clock::time_point{};
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (!stop_) {
+    lock.unlock();
+    auto now = Clock::now();
+    if (now >= next_tick) {
+      Enqueue();
+      next_tick += options_.interval;
+      if (next_tick <= now) {
+        next_tick = now + options_.interval;
+      }
+    }
+    if (!buffer_.empty() && now >= retry_at) {
+      if (!SendBuffered()) {
+        retry_at = Clock::now() + NextBackoff();
+      }
+    }
+    lock.lock();
+
+    auto wake_at = buffer_.empty() ? next_tick : std::min(next_tick, retry_at);
+    wake_.wait_until(lock, wake_at, [this] { return stop_; });
+  }
+}
+
+void PeriodicPusher::Enqueue() {
+  auto payload = std::unique_ptr<Payload>{new Payload{}};
+  payload->requests = gateway_.collectRequests(detail::HttpMethod::Post);
+  if (payload->requests.empty()) {
+    return;
+  }
+  for (auto& request : payload->requests) {
+    request.timeout = options_.timeout;
+  }
+
+  while (!buffer_.empty() &&
+         buffer_.size() >= std::max<std::size_t>(options_.max_buffered, 1)) {
+    buffer_.pop_front();
+    payloads_dropped_.Increment();
+  }
+  buffer_.push_back(std::move(payload));
+  payloads_buffered_.Set(static_cast<double>(buffer_.size()));
+}
+
+bool PeriodicPusher::SendBuffered() {
+  while (!buffer_.empty()) {
+    auto status_code = gateway_.performHttpRequests(buffer_.front()->requests);
+    if (status_code < 100 || status_code >= 400) {
+      ++failures_;
+      pushes_failed_.Increment();
+      return false;
+    }
+
+    failures_ = 0;
+    pushes_succeeded_.Increment();
+    last_success_.SetToCurrentTime();
+    buffer_.pop_front();
+    payloads_buffered_.Set(static_cast<double>(buffer_.size()));
+  }
+  return true;
+}
+
+PeriodicPusher::Clock::duration PeriodicPusher::NextBackoff() {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  auto exponent = std::min(failures_ - 1, 62u);
+  auto backoff = std::min(
+      Milliseconds{options_.min_backoff} * std::pow(2.0, exponent),
+      Milliseconds{options_.max_backoff});
+  // spreads the retries of many pushers after a gateway outage
+  auto jitter = std::uniform_real_distribution<double>{0.5, 1.0}(random_);
+  return std::chrono::duration_cast<Clock::duration>(backoff * jitter);
+}
+
+}  // namespace prometheus
@@ -0,0 +1,397 @@
+#include "prometheus/remote_write.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <utility>
+
+#include "curl_wrapper.h"
+#include "prometheus/client_metric.h"
+#include "prometheus/detail/snappy.h"
+#include "prometheus/metric_family.h"
+#include "write_request.h"
+
+namespace prometheus {
+
+namespace {
+
+// formats bucket bounds and quantiles like the text serializer, so that
+// the series are the same as scraped ones
+std::string FormatValue(double value) {
+  if (std::isinf(value)) {
+    return value < 0 ? "-Inf" : "+Inf";
+  }
+  std::ostringstream out;
+  out.imbue(std::locale::classic());
+  out.setf(std::ios::fixed, std::ios::floatfield);
+  out << value;
+  return out.str();
+}
+
+std::string SeriesKey(const std::vector<ClientMetric::Label>& labels) {
+  auto key = std::string{};
+  for (auto& label : labels) {
+    key.append(label.name).push_back('\xff');
+    key.append(label.value).push_back('\xfe');
+  }
+  return key;
+}
+
+// Calls add for every sample of the metric like the text format would
+// expose it. Labels are sorted by name as remote write requires.
+template <typename Add>
+void ExpandMetric(const MetricFamily& family, const ClientMetric& metric,
+                  std::int64_t timestamp_ms, Add&& add) {
+  auto sample = [&](const std::string& suffix, double value,
+                    const std::string& extra_name,
+                    const std::string& extra_value) {
+    auto labels = metric.label;
+    labels.push_back({"__name__", family.name + suffix});
+    if (!extra_name.empty()) {
+      labels.push_back({extra_name, extra_value});
+    }
+    std::sort(labels.begin(), labels.end());
+    add(detail::RemoteWriteSample{std::move(labels), value,
+                                  metric.timestamp_ms ? metric.timestamp_ms
+                                                      : timestamp_ms});
+  };
+
+  switch (family.type) {
+    case MetricType::Counter:
+      sample("", metric.counter.value, {}, {});
+      break;
+    case MetricType::Gauge:
+      sample("", metric.gauge.value, {}, {});
+      break;
+    case MetricType::Untyped:
+      sample("", metric.untyped.value, {}, {});
+      break;
+    case MetricType::Summary:
+      for (auto& q : metric.summary.quantile) {
+        sample("", q.value, "quantile", FormatValue(q.quantile));
+      }
+      sample("_sum", metric.summary.sample_sum, {}, {});
+      sample("_count", static_cast<double>(metric.summary.sample_count), {},
+             {});
+      break;
+    case MetricType::Histogram:
+      for (auto& b : metric.histogram.bucket) {
+        sample("_bucket", static_cast<double>(b.cumulative_count), "le",
+               FormatValue(b.upper_bound));
+      }
+      sample("_sum", metric.histogram.sample_sum, {}, {});
+      sample("_count", static_cast<double>(metric.histogram.sample_count), {},
+             {});
+      break;
+  }
+}
+
+bool SameValue(double a, double b) {
+  return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+}  // namespace
+
+class RemoteWrite::Shard {
+ public:
+  Shard(RemoteWrite& owner, const std::string& url, const std::string& auth)
+      : owner_(owner),
+        url_(url),
+        curl_(auth,
+              {"Content-Type: application/x-protobuf",
+               "Content-Encoding: snappy", "User-Agent: prometheus-cpp",
+               "X-Prometheus-Remote-Write-Version: 0.1.0"}),
+        random_(std::random_device{}()),
+        thread_(&Shard::Run, this) {}
+
+  ~Shard() {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+    owner_.batches_queued_.Decrement(static_cast<double>(queue_.size()));
+  }
+
+  void Enqueue(std::vector<detail::RemoteWriteSample>&& batch) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (queue_.size() >= std::max<std::size_t>(
+                               owner_.options_.max_queued_batches, 1)) {
+        owner_.samples_dropped_.Increment(
+            static_cast<double>(queue_.front().size()));
+        owner_.resend_all_ = true;
+        queue_.pop_front();
+        owner_.batches_queued_.Decrement();
+      }
+      queue_.push_back(std::move(batch));
+      owner_.batches_queued_.Increment();
+    }
+    wake_.notify_one();
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (true) {
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      auto batch = std::move(queue_.front());
+      queue_.pop_front();
+      owner_.batches_queued_.Decrement();
+      lock.unlock();
+      Send(batch);
+      lock.lock();
+    }
+  }
+
+  void Send(const std::vector<detail::RemoteWriteSample>& batch) {
+    const auto request = detail::HttpRequest{
+        detail::HttpMethod::Post, url_,
+        detail::SnappyCompress(detail::EncodeWriteRequest(batch)),
+        owner_.options_.timeout};
+    const auto samples = static_cast<double>(batch.size());
+
+    for (unsigned failures = 0;; ++failures) {
+      auto status_code = curl_.Perform({request}).front();
+      if (status_code >= 200 && status_code < 300) {
+        owner_.requests_succeeded_.Increment();
+        owner_.samples_sent_.Increment(samples);
+        return;
+      }
+      owner_.requests_failed_.Increment();
+      // the endpoint will not accept the batch on retry either
+      if (status_code >= 400 && status_code < 500 && status_code != 429) {
+        owner_.samples_dropped_.Increment(samples);
+        owner_.resend_all_ = true;
+        return;
+      }
+
+      std::unique_lock<std::mutex> lock{mutex_};
+      if (wake_.wait_for(lock, Backoff(failures), [this] { return stop_; })) {
+        return;
+      }
+    }
+  }
+
+  Clock::duration Backoff(unsigned failures) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    auto backoff = std::min(Milliseconds{owner_.options_.min_backoff} *
+                                std::pow(2.0, std::min(failures, 62u)),
+                            Milliseconds{owner_.options_.max_backoff});
+    auto jitter = std::uniform_real_distribution<double>{0.5, 1.0}(random_);
+    return std::chrono::duration_cast<Clock::duration>(backoff * jitter);
+  }
+
+  RemoteWrite& owner_;
+  const std::string url_;
+  detail::CurlWrapper curl_;
+  std::minstd_rand random_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::vector<detail::RemoteWriteSample>> queue_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+RemoteWrite::RemoteWrite(const std::string& url, const Options& options,
+                         const std::string& username,
+                         const std::string& password)
+    : options_(options),
+      registry_(std::make_shared<Registry>()),
+      samples_sent_(BuildCounter()
+                        .Name("remote_write_samples_total")
+                        .Help("Number of samples by outcome")
+                        .Register(*registry_)
+                        .Add({{"result", "sent"}})),
+      samples_dropped_(BuildCounter()
+                           .Name("remote_write_samples_total")
+                           .Help("Number of samples by outcome")
+                           .Register(*registry_)
+                           .Add({{"result", "dropped"}})),
+      requests_succeeded_(BuildCounter()
+                              .Name("remote_write_requests_total")
+                              .Help("Number of requests by outcome")
+                              .Register(*registry_)
+                              .Add({{"result", "success"}})),
+      requests_failed_(BuildCounter()
+                           .Name("remote_write_requests_total")
+                           .Help("Number of requests by outcome")
+                           .Register(*registry_)
+                           .Add({{"result", "failure"}})),
+      batches_queued_(BuildGauge()
+                          .Name("remote_write_queued_batches")
+                          .Help("Number of batches waiting to be sent")
+                          .Register(*registry_)
+                          .Add({})) {
+  auto auth = std::string{};
+  if (!username.empty()) {
+    auth = username + ":" + password;
+  }
+  for (std::size_t i = 0; i < std::max<std::size_t>(options_.shards, 1); ++i) {
+    shards_.emplace_back(new Shard{*this, url, auth});
+  }
+  if (options_.interval.count() > 0) {
+    thread_ = std::thread{&RemoteWrite::Run, this};
+  }
+}
+
+RemoteWrite::RemoteWrite(const std::string& url) : RemoteWrite(url, {}) {}
+
+RemoteWrite::~RemoteWrite() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  shards_.clear();
+}
+
+void RemoteWrite::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  sources_.push_back({collectable, {}});
+}
+
+void RemoteWrite::Run() {
+  auto next_send = Clock::now() + options_.interval;
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (!wake_.wait_until(lock, next_send, [this] { return stop_; })) {
+    lock.unlock();
+    Send();
+    lock.lock();
+    next_send += options_.interval;
+    if (next_send <= Clock::now()) {
+      next_send = Clock::now() + options_.interval;
+    }
+  }
+}
+
+bool RemoteWrite::Changed(const std::string& key, double value,
+                          Clock::time_point now) {
+  auto inserted = series_.emplace(key, SeriesState{value, now, generation_});
+  if (inserted.second) {
+    return true;
+  }
+  auto& state = inserted.first->second;
+  state.generation = generation_;
+  if (SameValue(state.value, value) &&
+      (options_.resend_unchanged.count() == 0 ||
+       now - state.sent < options_.resend_unchanged)) {
+    return false;
+  }
+  state.value = value;
+  state.sent = now;
+  return true;
+}
+
+void RemoteWrite::Queue(std::vector<detail::RemoteWriteSample>& batch,
+                        Shard& shard) {
+  if (batch.empty()) {
+    return;
+  }
+  shard.Enqueue(std::move(batch));
+  batch = {};
+}
+
+std::size_t RemoteWrite::Send() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  ++generation_;
+  const auto now = Clock::now();
+  // the endpoint misses the samples of dropped batches
+  const auto resend_all = resend_all_.exchange(false);
+  if (resend_all) {
+    series_.clear();
+  }
+  const auto refresh =
+      resend_all || (options_.resend_unchanged.count() != 0 &&
+                     now - refreshed_ >= options_.resend_unchanged);
+  if (refresh) {
+    refreshed_ = now;
+  }
+  const auto timestamp_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  const auto hash = std::hash<std::string>{};
+
+  auto batches = std::vector<std::vector<detail::RemoteWriteSample>>(
+      shards_.size());
+  std::size_t queued = 0;
+  auto queue = [&](detail::RemoteWriteSample&& sample,
+                   const std::string& key) {
+    auto shard = hash(key) % shards_.size();
+    batches[shard].push_back(std::move(sample));
+    ++queued;
+    if (batches[shard].size() >= options_.max_samples_per_send) {
+      Queue(batches[shard], *shards_[shard]);
+    }
+  };
+  auto add_changed = [&](detail::RemoteWriteSample&& sample) {
+    auto key = SeriesKey(sample.labels);
+    queue(std::move(sample), key);
+  };
+  auto add = [&](detail::RemoteWriteSample&& sample) {
+    auto key = SeriesKey(sample.labels);
+    if (Changed(key, sample.value, now)) {
+      queue(std::move(sample), key);
+    }
+  };
+
+  for (auto& source : sources_) {
+    auto collectable = source.collectable.lock();
+    if (!collectable) {
+      continue;
+    }
+    auto changed = std::vector<MetricFamily>{};
+    auto all = std::vector<MetricFamily>{};
+    auto& cursor = source.cursor;
+    cursor.all = refresh;
+    ++cursor.pass;
+    collectable->CollectChanged(cursor, changed, all);
+    for (auto it = cursor.positions.begin(); it != cursor.positions.end();) {
+      if (it->second.pass != cursor.pass) {
+        it = cursor.positions.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for (auto& family : changed) {
+      for (auto& metric : family.metric) {
+        ExpandMetric(family, metric, timestamp_ms, add_changed);
+      }
+    }
+    for (auto& family : all) {
+      for (auto& metric : family.metric) {
+        ExpandMetric(family, metric, timestamp_ms, add);
+      }
+    }
+  }
+  for (std::size_t i = 0; i < shards_.size(); ++i) {
+    Queue(batches[i], *shards_[i]);
+  }
+
+  // forget series that disappeared, they are sent again if they come back
+  for (auto it = series_.begin(); it != series_.end();) {
+    if (it->second.generation != generation_) {
+      it = series_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return queued;
+}
+
+}  // namespace prometheus
@@ -0,0 +1,207 @@
+#include "prometheus/detail/snappy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace prometheus {
+
+namespace detail {
+
+namespace {
+
+// offsets of copies stay below the 2 byte limit of a copy with 2 byte offset
+constexpr std::size_t kBlockSize = 1 << 16;
+constexpr int kHashBits = 14;
+constexpr std::size_t kMinMatch = 4;
+
+std::uint32_t Load32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t Hash(std::uint32_t bytes) {
+  return (bytes * 0x1e35a7bd) >> (32 - kHashBits);
+}
+
+void AppendVarint(std::string& output, std::uint64_t value) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+void EmitLiteral(std::string& output, const char* literal, std::size_t size) {
+  auto n = size - 1;
+  if (n < 60) {
+    output.push_back(static_cast<char>(n << 2));
+  } else {
+    // 60 to 63 tell the number of little endian length bytes that follow
+    auto bytes = 0;
+    for (auto rest = n; rest > 0; rest >>= 8) {
+      ++bytes;
+    }
+    output.push_back(static_cast<char>((59 + bytes) << 2));
+    for (auto i = 0; i < bytes; ++i) {
+      output.push_back(static_cast<char>(n >> (8 * i)));
+    }
+  }
+  output.append(literal, size);
+}
+
+void EmitCopyUpTo64(std::string& output, std::size_t offset,
+                    std::size_t length) {
+  if (length < 12 && offset < 2048) {
+    output.push_back(static_cast<char>(1 | ((length - 4) << 2) |
+                                       ((offset >> 8) << 5)));
+    output.push_back(static_cast<char>(offset));
+  } else {
+    output.push_back(static_cast<char>(2 | ((length - 1) << 2)));
+    output.push_back(static_cast<char>(offset));
+    output.push_back(static_cast<char>(offset >> 8));
+  }
+}
+
+void EmitCopy(std::string& output, std::size_t offset, std::size_t length) {
+  // keeps at least 4 bytes for the last copy
+  while (length >= 68) {
+    EmitCopyUpTo64(output, offset, 64);
+    length -= 64;
+  }
+  if (length > 64) {
+    EmitCopyUpTo64(output, offset, 60);
+    length -= 60;
+  }
+  EmitCopyUpTo64(output, offset, length);
+}
+
+void CompressBlock(std::string& output, const char* block, std::size_t size,
+                   std::vector<std::uint16_t>& table) {
+  std::fill(table.begin(), table.end(), 0);
+  std::size_t literal_start = 0;
+  std::size_t i = 0;
+  while (i + kMinMatch <= size) {
+    auto bytes = Load32(block + i);
+    auto& entry = table[Hash(bytes)];
+    std::size_t candidate = entry;
+    entry = static_cast<std::uint16_t>(i);
+    if (candidate >= i || Load32(block + candidate) != bytes) {
+      ++i;
+      continue;
+    }
+
+    auto length = kMinMatch;
+    while (i + length < size && block[candidate + length] == block[i + length]) {
+      ++length;
+    }
+    if (literal_start < i) {
+      EmitLiteral(output, block + literal_start, i - literal_start);
+    }
+    EmitCopy(output, i - candidate, length);
+    i += length;
+    literal_start = i;
+  }
+  if (literal_start < size) {
+    EmitLiteral(output, block + literal_start, size - literal_start);
+  }
+}
+
+}  // namespace
+
+std::string SnappyCompress(const std::string& input) {
+  auto output = std::string{};
+  output.reserve(32 + input.size() + input.size() / 6);
+  AppendVarint(output, input.size());
+
+  auto table = std::vector<std::uint16_t>(1 << kHashBits);
+  for (std::size_t start = 0; start < input.size(); start += kBlockSize) {
+    auto size = std::min(kBlockSize, input.size() - start);
+    CompressBlock(output, input.data() + start, size, table);
+  }
+  return output;
+}
+
+bool SnappyUncompress(const std::string& input, std::string* output) {
+  std::size_t pos = 0;
+  std::uint64_t length = 0;
+  for (auto shift = 0;; shift += 7) {
+    if (pos >= input.size() || shift > 35) {
+      return false;
+    }
+    auto byte = static_cast<unsigned char>(input[pos++]);
+    length |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      break;
+    }
+  }
+
+  output->clear();
+  output->reserve(length);
+  while (pos < input.size()) {
+    auto tag = static_cast<unsigned char>(input[pos++]);
+    std::size_t size = 0;
+    std::size_t offset = 0;
+    switch (tag & 3) {
+      case 0: {
+        size = tag >> 2;
+        if (size >= 60) {
+          auto bytes = size - 59;
+          if (pos + bytes > input.size()) {
+            return false;
+          }
+          size = 0;
+          for (std::size_t i = 0; i < bytes; ++i) {
+            size |= static_cast<std::size_t>(
+                        static_cast<unsigned char>(input[pos++]))
+                    << (8 * i);
+          }
+        }
+        ++size;
+        if (pos + size > input.size()) {
+          return false;
+        }
+        output->append(input, pos, size);
+        pos += size;
+        continue;
+      }
+      case 1:
+        if (pos + 1 > input.size()) {
+          return false;
+        }
+        size = 4 + ((tag >> 2) & 7);
+        offset = ((tag >> 5) << 8) | static_cast<unsigned char>(input[pos]);
+        pos += 1;
+        break;
+      case 2:
+      case 3: {
+        auto bytes = (tag & 3) == 2 ? 2 : 4;
+        if (pos + bytes > input.size()) {
+          return false;
+        }
+        size = 1 + (tag >> 2);
+        for (auto i = 0; i < bytes; ++i) {
+          offset |= static_cast<std::size_t>(
+                        static_cast<unsigned char>(input[pos++]))
+                    << (8 * i);
+        }
+        break;
+      }
+    }
+    if (offset == 0 || offset > output->size()) {
+      return false;
+    }
+    // the copy may overlap with the bytes it produces
+    auto from = output->size() - offset;
+    for (std::size_t i = 0; i < size; ++i) {
+      output->push_back((*output)[from + i]);
+    }
+  }
+  return output->size() == length;
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
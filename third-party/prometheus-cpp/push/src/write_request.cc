@@ -0,0 +1,54 @@
+#include "write_request.h"
+
+#include "prometheus/detail/protobuf_writer.h"
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+using namespace protobuf;
+
+std::size_t LabelSize(const ClientMetric::Label& label) {
+  return StringSize(label.name) + StringSize(label.value);
+}
+
+std::size_t SampleSize(const RemoteWriteSample& sample) {
+  return kDoubleSize + UintSize(static_cast<std::uint64_t>(sample.timestamp_ms));
+}
+
+std::size_t TimeSeriesSize(const RemoteWriteSample& sample) {
+  std::size_t size = 0;
+  for (auto& label : sample.labels) {
+    size += LengthDelimitedSize(LabelSize(label));
+  }
+  return size + LengthDelimitedSize(SampleSize(sample));
+}
+
+}  // namespace
+
+std::string EncodeWriteRequest(const std::vector<RemoteWriteSample>& samples) {
+  std::size_t total = 0;
+  for (auto& sample : samples) {
+    total += LengthDelimitedSize(TimeSeriesSize(sample));
+  }
+
+  auto output = std::string{};
+  output.reserve(total);
+  for (auto& sample : samples) {
+    AppendLengthDelimited(output, 1, TimeSeriesSize(sample));
+    for (auto& label : sample.labels) {
+      AppendLengthDelimited(output, 1, LabelSize(label));
+      AppendString(output, 1, label.name);
+      AppendString(output, 2, label.value);
+    }
+
+    AppendLengthDelimited(output, 2, SampleSize(sample));
+    AppendDouble(output, 1, sample.value);
+    AppendUint(output, 2, static_cast<std::uint64_t>(sample.timestamp_ms));
+  }
+  return output;
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "prometheus/client_metric.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief A sample of a series as sent by remote write.
+struct RemoteWriteSample {
+  /// \brief Labels including __name__, sorted by name.
+  std::vector<ClientMetric::Label> labels;
+  double value;
+  std::int64_t timestamp_ms;
+};
+
+/// \brief Encode a prometheus.WriteRequest protobuf message with one time
+/// series per sample.
+///
+/// The encoding is written by hand, the message is
+///
+///     message WriteRequest { repeated TimeSeries timeseries = 1; }
+///     message TimeSeries { repeated Label labels = 1;
+///                          repeated Sample samples = 2; }
+///     message Label { string name = 1; string value = 2; }
+///     message Sample { double value = 1; int64 timestamp = 2; }
+std::string EncodeWriteRequest(const std::vector<RemoteWriteSample>& samples);
+
+}  // namespace detail
+}  // namespace prometheus
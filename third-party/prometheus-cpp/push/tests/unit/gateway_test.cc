@@ -0,0 +1,114 @@
+#include "prometheus/gateway.h"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "prometheus/counter.h"
+#include "prometheus/registry.h"
+#include "stub_gateway.h"
+
+namespace prometheus {
+namespace {
+
+using namespace testing;
+
+class GatewayTest : public testing::Test {
+ protected:
+  StubGateway stub;
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "test_job"};
+};
+
+std::shared_ptr<Registry> RegistryWithCounter(const std::string& name) {
+  auto registry = std::make_shared<Registry>();
+  BuildCounter().Name(name).Help("").Register(*registry).Add({}).Increment();
+  return registry;
+}
+
+TEST_F(GatewayTest, push_one_request_per_grouping_key) {
+  auto first = RegistryWithCounter("first_total");
+  auto second = RegistryWithCounter("second_total");
+  auto third = RegistryWithCounter("third_total");
+  const auto labels = Gateway::Labels{{"shard", "1"}};
+  gateway.RegisterCollectable(first);
+  gateway.RegisterCollectable(second);
+  gateway.RegisterCollectable(third, &labels);
+
+  EXPECT_EQ(200, gateway.Push());
+
+  auto requests = stub.GetRequests();
+  ASSERT_EQ(2u, requests.size());
+  std::sort(requests.begin(), requests.end(),
+            [](const StubGateway::Request& a, const StubGateway::Request& b) {
+              return a.uri < b.uri;
+            });
+  EXPECT_EQ("POST", requests[0].method);
+  EXPECT_EQ("/metrics/job/test_job", requests[0].uri);
+  EXPECT_THAT(requests[0].body, HasSubstr("first_total"));
+  EXPECT_THAT(requests[0].body, HasSubstr("second_total"));
+  EXPECT_EQ("/metrics/job/test_job/shard/1", requests[1].uri);
+  EXPECT_THAT(requests[1].body, HasSubstr("third_total"));
+}
+
+TEST_F(GatewayTest, merge_family_of_same_grouping_key) {
+  auto first = RegistryWithCounter("shared_total");
+  auto second = std::make_shared<Registry>();
+  BuildCounter()
+      .Name("shared_total")
+      .Help("")
+      .Register(*second)
+      .Add({{"source", "second"}});
+  gateway.RegisterCollectable(first);
+  gateway.RegisterCollectable(second);
+
+  EXPECT_EQ(200, gateway.PushAdd());
+
+  auto requests = stub.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ("PUT", requests[0].method);
+  const auto& body = requests[0].body;
+  EXPECT_EQ(body.find("# TYPE shared_total"),
+            body.rfind("# TYPE shared_total"));
+  EXPECT_THAT(body, HasSubstr("source=\"second\""));
+}
+
+TEST_F(GatewayTest, reuse_connection) {
+  auto registry = RegistryWithCounter("reused_total");
+  gateway.RegisterCollectable(registry);
+
+  EXPECT_EQ(200, gateway.Push());
+  EXPECT_EQ(200, gateway.AsyncPush().get());
+  EXPECT_EQ(200, gateway.Delete());
+
+  auto requests = stub.GetRequests();
+  ASSERT_EQ(3u, requests.size());
+  EXPECT_EQ("DELETE", requests[2].method);
+  EXPECT_EQ(requests[0].remote_port, requests[1].remote_port);
+  EXPECT_EQ(requests[0].remote_port, requests[2].remote_port);
+}
+
+TEST_F(GatewayTest, skip_expired_collectable) {
+  auto registry = RegistryWithCounter("expired_total");
+  gateway.RegisterCollectable(registry);
+  registry.reset();
+
+  EXPECT_EQ(200, gateway.Push());
+  EXPECT_TRUE(stub.GetRequests().empty());
+}
+
+TEST(GatewayErrorTest, report_connection_error) {
+  auto port = std::string{};
+  {
+    StubGateway stub;
+    port = stub.GetPort();
+  }
+  Gateway gateway{"http://127.0.0.1", port, "test_job"};
+  auto registry = RegistryWithCounter("unsent_total");
+  gateway.RegisterCollectable(registry);
+
+  EXPECT_LT(gateway.Push(), 0);
+}
+
+}  // namespace
+}  // namespace prometheus
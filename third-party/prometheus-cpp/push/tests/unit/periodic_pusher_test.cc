@@ -0,0 +1,144 @@
+#include "prometheus/periodic_pusher.h"
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "prometheus/counter.h"
+#include "prometheus/registry.h"
+#include "stub_gateway.h"
+
+namespace prometheus {
+namespace {
+
+using namespace testing;
+using namespace std::chrono;
+
+// value of the first series of the family in the self-metrics of the pusher
+double Value(const PeriodicPusher& pusher, const std::string& name,
+             const std::string& result = {}) {
+  for (auto& family : pusher.GetRegistry()->Collect()) {
+    if (family.name != name) {
+      continue;
+    }
+    for (auto& metric : family.metric) {
+      if (!result.empty() && metric.label.front().value != result) {
+        continue;
+      }
+      return family.type == MetricType::Counter ? metric.counter.value
+                                                : metric.gauge.value;
+    }
+  }
+  return -1;
+}
+
+bool Eventually(const std::function<bool()>& condition) {
+  const auto deadline = steady_clock::now() + seconds(10);
+  while (steady_clock::now() < deadline) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+  return false;
+}
+
+class PeriodicPusherTest : public testing::Test {
+ protected:
+  PeriodicPusherTest() {
+    BuildCounter().Name("pushed_total").Help("").Register(*registry).Add({});
+  }
+
+  std::shared_ptr<Registry> registry = std::make_shared<Registry>();
+};
+
+TEST_F(PeriodicPusherTest, push_every_interval) {
+  StubGateway stub;
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "test_job"};
+  gateway.RegisterCollectable(registry);
+  auto options = PeriodicPusher::Options{};
+  options.interval = milliseconds(10);
+  PeriodicPusher pusher{gateway, options};
+
+  EXPECT_TRUE(Eventually([&] { return stub.GetRequests().size() >= 3; }));
+  EXPECT_GE(Value(pusher, "pusher_pushes_total", "success"), 3);
+  EXPECT_EQ(0, Value(pusher, "pusher_pushes_total", "failure"));
+  EXPECT_GT(Value(pusher, "pusher_last_success_timestamp_seconds"), 0);
+  EXPECT_THAT(stub.GetRequests().front().body, HasSubstr("pushed_total"));
+}
+
+TEST_F(PeriodicPusherTest, drop_oldest_when_buffer_full) {
+  auto port = StubGateway{}.GetPort();
+  Gateway gateway{"http://127.0.0.1", port, "test_job"};
+  gateway.RegisterCollectable(registry);
+  auto options = PeriodicPusher::Options{};
+  options.interval = milliseconds(5);
+  options.max_buffered = 3;
+  options.min_backoff = hours(1);
+  options.max_backoff = hours(1);
+  PeriodicPusher pusher{gateway, options};
+
+  EXPECT_TRUE(Eventually(
+      [&] { return Value(pusher, "pusher_dropped_payloads_total") >= 2; }));
+  EXPECT_EQ(3, Value(pusher, "pusher_buffered_payloads"));
+  // the first failure waits for the backoff
+  EXPECT_EQ(1, Value(pusher, "pusher_pushes_total", "failure"));
+  EXPECT_EQ(0, Value(pusher, "pusher_pushes_total", "success"));
+}
+
+TEST_F(PeriodicPusherTest, send_buffered_after_outage) {
+  auto port = StubGateway{}.GetPort();
+  Gateway gateway{"http://127.0.0.1", port, "test_job"};
+  gateway.RegisterCollectable(registry);
+  auto options = PeriodicPusher::Options{};
+  options.interval = milliseconds(5);
+  options.max_buffered = 2;
+  options.min_backoff = milliseconds(10);
+  options.max_backoff = milliseconds(20);
+  PeriodicPusher pusher{gateway, options};
+
+  EXPECT_TRUE(Eventually(
+      [&] { return Value(pusher, "pusher_pushes_total", "failure") >= 2; }));
+  StubGateway stub{port};
+
+  EXPECT_TRUE(Eventually([&] { return !stub.GetRequests().empty(); }));
+  EXPECT_TRUE(Eventually(
+      [&] { return Value(pusher, "pusher_pushes_total", "success") >= 2; }));
+}
+
+TEST_F(PeriodicPusherTest, fail_requests_without_response_in_time) {
+  StubGateway stub;
+  stub.SetResponseDelay(seconds(2));
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "test_job"};
+  gateway.RegisterCollectable(registry);
+  auto options = PeriodicPusher::Options{};
+  options.interval = milliseconds(5);
+  options.min_backoff = milliseconds(10);
+  options.max_backoff = milliseconds(20);
+  options.timeout = milliseconds(50);
+  const auto start = steady_clock::now();
+  {
+    PeriodicPusher pusher{gateway, options};
+
+    EXPECT_TRUE(Eventually(
+        [&] { return Value(pusher, "pusher_pushes_total", "failure") >= 2; }));
+    EXPECT_EQ(0, Value(pusher, "pusher_pushes_total", "success"));
+  }
+  // neither the retries nor the destructor waited for a response
+  EXPECT_LT(steady_clock::now() - start, seconds(2));
+}
+
+TEST_F(PeriodicPusherTest, report_to_given_registry) {
+  StubGateway stub;
+  Gateway gateway{stub.GetHost(), stub.GetPort(), "test_job"};
+  PeriodicPusher pusher{gateway, PeriodicPusher::Options{}, registry};
+
+  EXPECT_EQ(registry, pusher.GetRegistry());
+  EXPECT_EQ(0, Value(pusher, "pusher_dropped_payloads_total"));
+}
+
+}  // namespace
+}  // namespace prometheus
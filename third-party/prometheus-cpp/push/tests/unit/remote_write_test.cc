@@ -0,0 +1,355 @@
+#include "prometheus/remote_write.h"
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "prometheus/columnar_gauge.h"
+#include "prometheus/counter.h"
+#include "prometheus/detail/snappy.h"
+#include "prometheus/histogram.h"
+#include "prometheus/registry.h"
+#include "stub_gateway.h"
+
+namespace prometheus {
+namespace {
+
+using namespace testing;
+using namespace std::chrono;
+
+struct DecodedSeries {
+  std::map<std::string, std::string> labels;
+  double value;
+  std::int64_t timestamp_ms;
+};
+
+// minimal protobuf reader for the fields of a WriteRequest
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data) {}
+
+  bool Done() const { return pos_ >= data_.size(); }
+
+  std::uint64_t Varint() {
+    std::uint64_t value = 0;
+    for (auto shift = 0;; shift += 7) {
+      auto byte = static_cast<unsigned char>(data_.at(pos_++));
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+  }
+
+  std::string Bytes() {
+    auto size = Varint();
+    auto bytes = data_.substr(pos_, size);
+    pos_ += size;
+    return bytes;
+  }
+
+  double Double() {
+    std::uint64_t bits = 0;
+    for (auto i = 0; i < 8; ++i) {
+      bits |= static_cast<std::uint64_t>(
+                  static_cast<unsigned char>(data_.at(pos_++)))
+              << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+ private:
+  std::string data_;
+  std::size_t pos_ = 0;
+};
+
+std::vector<DecodedSeries> Decode(const std::string& body) {
+  auto message = std::string{};
+  EXPECT_TRUE(detail::SnappyUncompress(body, &message));
+  auto result = std::vector<DecodedSeries>{};
+  Reader request{message};
+  while (!request.Done()) {
+    EXPECT_EQ((1u << 3) | 2, request.Varint());
+    Reader series{request.Bytes()};
+    auto decoded = DecodedSeries{};
+    while (!series.Done()) {
+      auto tag = series.Varint();
+      Reader nested{series.Bytes()};
+      if (tag == ((1u << 3) | 2)) {
+        nested.Varint();
+        auto name = nested.Bytes();
+        nested.Varint();
+        decoded.labels[name] = nested.Bytes();
+      } else {
+        EXPECT_EQ((2u << 3) | 2, tag);
+        EXPECT_EQ((1u << 3) | 1, nested.Varint());
+        decoded.value = nested.Double();
+        EXPECT_EQ(2u << 3, nested.Varint());
+        decoded.timestamp_ms = static_cast<std::int64_t>(nested.Varint());
+      }
+    }
+    result.push_back(decoded);
+  }
+  return result;
+}
+
+bool Eventually(const std::function<bool()>& condition) {
+  const auto deadline = steady_clock::now() + seconds(10);
+  while (steady_clock::now() < deadline) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+  return false;
+}
+
+double Value(const RemoteWrite& sink, const std::string& name,
+             const std::string& result) {
+  for (auto& family : sink.GetRegistry()->Collect()) {
+    for (auto& metric : family.metric) {
+      if (family.name == name && metric.label.front().value == result) {
+        return metric.counter.value;
+      }
+    }
+  }
+  return -1;
+}
+
+TEST(SnappyTest, round_trip) {
+  std::minstd_rand random;
+  auto random_bytes = std::string(100000, '\0');
+  for (auto& c : random_bytes) {
+    c = static_cast<char>(random());
+  }
+  auto repeated = std::string{};
+  while (repeated.size() < 200000) {
+    repeated += "metric_name{label=\"value\"} 1\n";
+  }
+
+  for (const auto& input :
+       {std::string{}, std::string{"a"}, random_bytes, repeated}) {
+    auto compressed = detail::SnappyCompress(input);
+    auto output = std::string{};
+    ASSERT_TRUE(detail::SnappyUncompress(compressed, &output));
+    EXPECT_EQ(input, output);
+  }
+  EXPECT_LT(detail::SnappyCompress(repeated).size(), repeated.size() / 10);
+}
+
+TEST(SnappyTest, reject_invalid_input) {
+  auto output = std::string{};
+  // claims 10 bytes, but copies from before the start
+  EXPECT_FALSE(detail::SnappyUncompress(std::string{"\x0a\x05\x01", 3},
+                                        &output));
+  EXPECT_FALSE(detail::SnappyUncompress(std::string{"\x0a\x00", 2}, &output));
+}
+
+class RemoteWriteTest : public testing::Test {
+ protected:
+  RemoteWriteTest() {
+    options.interval = milliseconds(0);
+    options.shards = 2;
+  }
+
+  std::string Url() const {
+    return stub.GetHost() + ":" + stub.GetPort() + "/api/v1/write";
+  }
+
+  std::vector<DecodedSeries> Received() const {
+    auto received = std::vector<DecodedSeries>{};
+    for (auto& request : stub.GetRequests()) {
+      auto series = Decode(request.body);
+      received.insert(received.end(), series.begin(), series.end());
+    }
+    return received;
+  }
+
+  StubGateway stub;
+  RemoteWrite::Options options;
+  std::shared_ptr<Registry> registry = std::make_shared<Registry>();
+};
+
+TEST_F(RemoteWriteTest, send_snappy_compressed_write_request) {
+  auto& counter = BuildCounter()
+                      .Name("written_total")
+                      .Help("")
+                      .Register(*registry)
+                      .Add({{"shard", "a"}});
+  counter.Increment(3);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  EXPECT_EQ(1u, sink.Send());
+
+  ASSERT_TRUE(Eventually([&] { return !stub.GetRequests().empty(); }));
+  auto request = stub.GetRequests().front();
+  EXPECT_EQ("POST", request.method);
+  EXPECT_EQ("/api/v1/write", request.uri);
+  EXPECT_EQ("snappy", request.content_encoding);
+  auto series = Decode(request.body);
+  ASSERT_EQ(1u, series.size());
+  EXPECT_EQ("written_total", series[0].labels["__name__"]);
+  EXPECT_EQ("a", series[0].labels["shard"]);
+  EXPECT_EQ(3, series[0].value);
+  EXPECT_GT(series[0].timestamp_ms, 0);
+}
+
+TEST_F(RemoteWriteTest, send_changed_series_only) {
+  auto& family = BuildCounter().Name("changed_total").Help("").Register(
+      *registry);
+  auto& changing = family.Add({{"series", "changing"}});
+  family.Add({{"series", "constant"}});
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  EXPECT_EQ(2u, sink.Send());
+  EXPECT_EQ(0u, sink.Send());
+  changing.Increment();
+  EXPECT_EQ(1u, sink.Send());
+
+  ASSERT_TRUE(Eventually([&] { return Received().size() == 3; }));
+  EXPECT_TRUE(
+      Eventually([&] { return Value(sink, "remote_write_samples_total",
+                                    "sent") == 3; }));
+}
+
+TEST_F(RemoteWriteTest, send_changed_columnar_gauges_only) {
+  auto& family = BuildColumnarGauge().Name("changed").Help("").Register(
+      *registry);
+  auto changing = family.Add({{"series", "changing"}});
+  family.Add({{"series", "constant"}});
+  options.resend_unchanged = milliseconds(0);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  EXPECT_EQ(2u, sink.Send());
+  EXPECT_EQ(0u, sink.Send());
+  family.Set(changing, 1.0);
+  EXPECT_EQ(1u, sink.Send());
+
+  ASSERT_TRUE(Eventually([&] { return Received().size() == 3; }));
+  auto values = std::multimap<std::string, double>{};
+  for (auto& series : Received()) {
+    values.emplace(series.labels["series"], series.value);
+  }
+  EXPECT_THAT(values, UnorderedElementsAre(Pair("changing", 0.0),
+                                           Pair("changing", 1.0),
+                                           Pair("constant", 0.0)));
+}
+
+TEST_F(RemoteWriteTest, resend_series_of_dropped_batch) {
+  BuildCounter().Name("dropped_total").Help("").Register(*registry).Add({});
+  auto& family = BuildColumnarGauge().Name("dropped").Help("").Register(
+      *registry);
+  family.Add({});
+  options.resend_unchanged = milliseconds(0);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  stub.SetStatusCode(400);
+  EXPECT_EQ(2u, sink.Send());
+  ASSERT_TRUE(Eventually(
+      [&] { return Value(sink, "remote_write_samples_total", "dropped") == 2; }));
+
+  stub.SetStatusCode(200);
+  EXPECT_EQ(2u, sink.Send());
+  EXPECT_TRUE(
+      Eventually([&] { return Value(sink, "remote_write_samples_total",
+                                    "sent") == 2; }));
+  EXPECT_EQ(0u, sink.Send());
+}
+
+TEST_F(RemoteWriteTest, resend_unchanged_series) {
+  BuildCounter().Name("unchanged_total").Help("").Register(*registry).Add({});
+  options.resend_unchanged = milliseconds(1);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  EXPECT_EQ(1u, sink.Send());
+  std::this_thread::sleep_for(milliseconds(5));
+  EXPECT_EQ(1u, sink.Send());
+}
+
+TEST_F(RemoteWriteTest, expand_histogram) {
+  BuildHistogram()
+      .Name("latency_seconds")
+      .Help("")
+      .Register(*registry)
+      .Add({}, Histogram::BucketBoundaries{0.5})
+      .Observe(0.1);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  EXPECT_EQ(4u, sink.Send());
+
+  ASSERT_TRUE(Eventually([&] { return Received().size() == 4; }));
+  auto names = std::multimap<std::string, std::string>{};
+  for (auto& series : Received()) {
+    names.emplace(series.labels["__name__"], series.labels["le"]);
+  }
+  EXPECT_THAT(names, UnorderedElementsAre(
+                         Pair("latency_seconds_bucket", "0.500000"),
+                         Pair("latency_seconds_bucket", "+Inf"),
+                         Pair("latency_seconds_sum", ""),
+                         Pair("latency_seconds_count", "")));
+}
+
+TEST_F(RemoteWriteTest, keep_samples_of_series_on_one_shard) {
+  auto& counter =
+      BuildCounter().Name("ordered_total").Help("").Register(*registry).Add(
+          {});
+  options.shards = 8;
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  for (auto i = 0; i < 20; ++i) {
+    counter.Increment();
+    sink.Send();
+  }
+
+  ASSERT_TRUE(Eventually([&] { return Received().size() == 20; }));
+  auto received = Received();
+  for (std::size_t i = 0; i < received.size(); ++i) {
+    EXPECT_EQ(i + 1, received[i].value);
+  }
+}
+
+TEST_F(RemoteWriteTest, retry_server_error_and_drop_client_error) {
+  auto& counter =
+      BuildCounter().Name("retried_total").Help("").Register(*registry).Add(
+          {});
+  options.min_backoff = milliseconds(1);
+  options.max_backoff = milliseconds(5);
+  RemoteWrite sink{Url(), options};
+  sink.RegisterCollectable(registry);
+
+  stub.SetStatusCode(400);
+  sink.Send();
+  ASSERT_TRUE(Eventually(
+      [&] { return Value(sink, "remote_write_samples_total", "dropped") == 1; }));
+
+  stub.SetStatusCode(503);
+  counter.Increment();
+  sink.Send();
+  ASSERT_TRUE(Eventually([&] {
+    return Value(sink, "remote_write_requests_total", "failure") >= 3;
+  }));
+  stub.SetStatusCode(200);
+  EXPECT_TRUE(Eventually(
+      [&] { return Value(sink, "remote_write_samples_total", "sent") == 1; }));
+}
+
+}  // namespace
+}  // namespace prometheus
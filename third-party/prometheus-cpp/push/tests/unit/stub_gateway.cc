@@ -0,0 +1,88 @@
+#include "stub_gateway.h"
+
+#include <atomic>
+#include <thread>
+
+#include "CivetServer.h"
+
+namespace prometheus {
+
+class StubGateway::Handler : public CivetHandler {
+ public:
+  bool handlePost(CivetServer*, struct mg_connection* conn) override {
+    return Record(conn);
+  }
+
+  bool handlePut(CivetServer*, struct mg_connection* conn) override {
+    return Record(conn);
+  }
+
+  bool handleDelete(CivetServer*, struct mg_connection* conn) override {
+    return Record(conn);
+  }
+
+  std::vector<Request> GetRequests() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return requests_;
+  }
+
+  void SetStatusCode(int status_code) { status_code_ = status_code; }
+
+  void SetResponseDelay(std::chrono::milliseconds delay) {
+    delay_ms_ = delay.count();
+  }
+
+ private:
+  bool Record(struct mg_connection* conn) {
+    auto request_info = mg_get_request_info(conn);
+    auto content_encoding = mg_get_header(conn, "Content-Encoding");
+    auto request = Request{request_info->request_method,
+                           request_info->local_uri,
+                           CivetServer::getPostData(conn),
+                           content_encoding ? content_encoding : "",
+                           request_info->remote_port};
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      requests_.push_back(std::move(request));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{delay_ms_});
+    const int status_code = status_code_;
+    mg_printf(conn, "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n",
+              status_code, mg_get_response_code_text(conn, status_code));
+    return true;
+  }
+
+  std::vector<Request> requests_;
+  std::atomic<int> status_code_{200};
+  std::atomic<long long> delay_ms_{0};
+  mutable std::mutex mutex_;
+};
+
+// a kept alive connection occupies a thread of civetweb
+StubGateway::StubGateway(const std::string& port)
+    : handler_(new Handler{}),
+      server_(new CivetServer{std::vector<std::string>{
+          "listening_ports", "127.0.0.1:" + port, "enable_keep_alive", "yes",
+          "keep_alive_timeout_ms", "10000", "num_threads", "64"}}) {
+  server_->addHandler("/", handler_.get());
+}
+
+StubGateway::~StubGateway() { server_->close(); }
+
+std::string StubGateway::GetPort() const {
+  return std::to_string(server_->getListeningPorts().front());
+}
+
+std::vector<StubGateway::Request> StubGateway::GetRequests() const {
+  return handler_->GetRequests();
+}
+
+void StubGateway::SetStatusCode(int status_code) {
+  handler_->SetStatusCode(status_code);
+}
+
+void StubGateway::SetResponseDelay(std::chrono::milliseconds delay) {
+  handler_->SetResponseDelay(delay);
+}
+
+}  // namespace prometheus
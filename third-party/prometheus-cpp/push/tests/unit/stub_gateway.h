@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CivetServer;
+
+namespace prometheus {
+
+// Stand-in for a pushgateway or a remote write receiver on a local port
+// that records the requests it receives and keeps connections alive.
+class StubGateway {
+ public:
+  struct Request {
+    std::string method;
+    std::string uri;
+    std::string body;
+    std::string content_encoding;
+    // differs for every connection of the client
+    int remote_port;
+  };
+
+  explicit StubGateway(const std::string& port = "0");
+  ~StubGateway();
+
+  std::string GetHost() const { return "http://127.0.0.1"; }
+  std::string GetPort() const;
+
+  std::vector<Request> GetRequests() const;
+
+  // status code of the following responses, 200 by default
+  void SetStatusCode(int status_code);
+
+  // time the following requests wait for their response, none by default
+  void SetResponseDelay(std::chrono::milliseconds delay);
+
+ private:
+  class Handler;
+
+  std::unique_ptr<Handler> handler_;
+  std::unique_ptr<CivetServer> server_;
+};
+
+}  // namespace prometheus